@@ -19,6 +19,9 @@ limitations under the License.
 #include "rprApi.h"
 
 #include "pxr/usd/usdUtils/pipeline.h"
+#include "pxr/base/work/loops.h"
+
+#include <algorithm>
 
 PXR_NAMESPACE_OPEN_SCOPE
 
@@ -61,49 +64,67 @@ void HdRprBasisCurves::Sync(HdSceneDelegate* sceneDelegate,
     SdfPath const& id = GetId();
     std::map<HdInterpolation, HdPrimvarDescriptorVector> primvarDescsPerInterpolation;
 
+    // Dirty bits are only a hint: the curve is recreated only when data it is built from has really changed.
+    // Transform, material and visibility are applied to the existing curve
     bool newCurve = false;
 
     if (*dirtyBits & HdChangeTracker::DirtyPoints) {
+        VtVec3fArray points;
         HdRprFillPrimvarDescsPerInterpolation(sceneDelegate, id, &primvarDescsPerInterpolation);
         if (HdRprIsPrimvarExists(HdTokens->points, primvarDescsPerInterpolation)) {
-            m_points = sceneDelegate->Get(id, HdTokens->points).Get<VtVec3fArray>();
-        } else {
-            m_points = VtVec3fArray();
+            points = sceneDelegate->Get(id, HdTokens->points).Get<VtVec3fArray>();
+        }
+        if (!m_rprCurve || points != m_points) {
+            m_points = points;
+            newCurve = true;
         }
-        newCurve = true;
     }
 
     if (*dirtyBits & HdChangeTracker::DirtyTopology) {
-        m_topology = sceneDelegate->GetBasisCurvesTopology(id);
-        m_indices = VtIntArray();
-        if (m_topology.HasIndices()) {
-            m_indices = m_topology.GetCurveIndices();
+        auto topology = sceneDelegate->GetBasisCurvesTopology(id);
+        if (!m_rprCurve || topology != m_topology) {
+            m_topology = topology;
+            m_indices = VtIntArray();
+            if (m_topology.HasIndices()) {
+                m_indices = m_topology.GetCurveIndices();
+            }
+            newCurve = true;
         }
-        newCurve = true;
     }
 
     if (*dirtyBits & HdChangeTracker::DirtyWidths) {
+        VtFloatArray widths;
+        HdInterpolation widthsInterpolation;
         HdRprFillPrimvarDescsPerInterpolation(sceneDelegate, id, &primvarDescsPerInterpolation);
-        if (HdRprIsPrimvarExists(HdTokens->widths, primvarDescsPerInterpolation, &m_widthsInterpolation)) {
-            m_widths = sceneDelegate->Get(id, HdTokens->widths).Get<VtFloatArray>();
+        if (HdRprIsPrimvarExists(HdTokens->widths, primvarDescsPerInterpolation, &widthsInterpolation)) {
+            widths = sceneDelegate->Get(id, HdTokens->widths).Get<VtFloatArray>();
         } else {
-            m_widths = VtFloatArray(1, 1.0f);
-            m_widthsInterpolation = HdInterpolationConstant;
+            widths = VtFloatArray(1, 1.0f);
+            widthsInterpolation = HdInterpolationConstant;
             TF_WARN("[%s] Curve do not have widths. Fallback value is 1.0f with a constant interpolation", id.GetText());
         }
-        newCurve = true;
+        if (!m_rprCurve || widthsInterpolation != m_widthsInterpolation || widths != m_widths) {
+            m_widths = widths;
+            m_widthsInterpolation = widthsInterpolation;
+            newCurve = true;
+        }
     }
 
     bool isVisibilityMaskDirty = false;
+    bool isDisplayColorDirty = false;
     if (*dirtyBits & HdChangeTracker::DirtyPrimvar) {
         HdRprFillPrimvarDescsPerInterpolation(sceneDelegate, id, &primvarDescsPerInterpolation);
         auto stToken = UsdUtilsGetPrimaryUVSetName();
-        if (HdRprIsPrimvarExists(stToken, primvarDescsPerInterpolation, &m_uvsInterpolation)) {
-            m_uvs = sceneDelegate->Get(id, stToken).Get<VtVec2fArray>();
-        } else {
-            m_uvs = VtVec2fArray();
+        VtVec2fArray uvs;
+        HdInterpolation uvsInterpolation = m_uvsInterpolation;
+        if (HdRprIsPrimvarExists(stToken, primvarDescsPerInterpolation, &uvsInterpolation)) {
+            uvs = sceneDelegate->Get(id, stToken).Get<VtVec2fArray>();
+        }
+        if (!m_rprCurve || uvsInterpolation != m_uvsInterpolation || uvs != m_uvs) {
+            m_uvs = uvs;
+            m_uvsInterpolation = uvsInterpolation;
+            newCurve = true;
         }
-        newCurve = true;
 
         HdRprGeometrySettings geomSettings = {};
         geomSettings.visibilityMask = kVisibleAll;
@@ -113,11 +134,25 @@ void HdRprBasisCurves::Sync(HdSceneDelegate* sceneDelegate,
             m_visibilityMask = geomSettings.visibilityMask;
             isVisibilityMaskDirty = true;
         }
+
+        GfVec3f displayColor(0.18f);
+        if (HdRprIsPrimvarExists(HdTokens->displayColor, primvarDescsPerInterpolation)) {
+            VtValue val = sceneDelegate->Get(id, HdTokens->displayColor);
+            if (!val.IsEmpty() && val.IsHolding<VtVec3fArray>()) {
+                auto colors = val.UncheckedGet<VtVec3fArray>();
+                if (!colors.empty()) {
+                    displayColor = colors[0];
+                }
+            }
+        }
+        if (m_displayColor != displayColor) {
+            m_displayColor = displayColor;
+            isDisplayColorDirty = true;
+        }
     }
 
     if (*dirtyBits & HdChangeTracker::DirtyTransform) {
         m_transform = GfMatrix4f(sceneDelegate->GetTransform(id));
-        newCurve = true;
     }
 
     if (*dirtyBits & HdChangeTracker::DirtyMaterialId) {
@@ -129,6 +164,7 @@ void HdRprBasisCurves::Sync(HdSceneDelegate* sceneDelegate,
     }
 
     if (newCurve) {
+        rprApi->Release(m_rprCurve);
         m_rprCurve = nullptr;
 
         if (m_points.empty()) {
@@ -156,45 +192,31 @@ void HdRprBasisCurves::Sync(HdSceneDelegate* sceneDelegate,
                 TF_WARN("[%s] Unsupported uv interpolation type", id.GetText());
             }
 
-            bool isLinear = m_topology.GetCurveType() == HdTokens->linear;
-
-            if (m_topology.GetCurveType() == HdTokens->cubic &&
-                (m_topology.GetCurveBasis() == HdTokens->catmullRom||
-                 m_topology.GetCurveBasis() == HdTokens->bSpline)) {
-                // XXX: There is no way to natively support catmullrom and bspline bases in RPR, try to render them as linear ones
-                isLinear = true;
-            }
-
-            if (isLinear) {
-                m_rprCurve = CreateLinearRprCurve(rprApi);
-            } else if (m_topology.GetCurveType() == HdTokens->cubic &&
-                       m_topology.GetCurveBasis() == HdTokens->bezier) {
-                m_rprCurve = CreateBezierRprCurve(rprApi);
+            auto basis = m_topology.GetCurveType() == HdTokens->linear ? HdTokens->linear : m_topology.GetCurveBasis();
+            if (basis == HdTokens->linear ||
+                basis == HdTokens->bezier ||
+                basis == HdTokens->bSpline ||
+                basis == HdTokens->catmullRom) {
+                m_rprCurve = CreateRprCurve(rprApi, basis);
+            } else {
+                TF_RUNTIME_ERROR("[%s] Curve could not be created: unsupported basis - %s", id.GetText(), basis.GetText());
             }
         }
     }
 
     if (m_rprCurve) {
-        if (newCurve || (*dirtyBits & HdChangeTracker::DirtyMaterialId)) {
+        if (newCurve || (*dirtyBits & HdChangeTracker::DirtyMaterialId) || isDisplayColorDirty) {
             if (m_cachedMaterial && m_cachedMaterial->GetRprMaterialObject()) {
                 rprApi->SetCurveMaterial(m_rprCurve, m_cachedMaterial->GetRprMaterialObject());
             } else {
-                GfVec3f color(0.18f);
-
-                if (HdRprIsPrimvarExists(HdTokens->displayColor, primvarDescsPerInterpolation)) {
-                    VtValue val = sceneDelegate->Get(id, HdTokens->displayColor);
-                    if (!val.IsEmpty() && val.IsHolding<VtVec3fArray>()) {
-                        auto colors = val.UncheckedGet<VtVec3fArray>();
-                        if (!colors.empty()) {
-                            color = colors[0];
-                        }
-                    }
-                }
+                // Previous fallback material might still be attached to the curve, release it after the new one is set
+                auto prevFallbackMaterial = m_fallbackMaterial;
 
-                MaterialAdapter matAdapter(EMaterialType::COLOR, MaterialParams{{HdRprMaterialTokens->color, VtValue(color)}});
+                MaterialAdapter matAdapter(EMaterialType::COLOR, MaterialParams{{HdRprMaterialTokens->color, VtValue(m_displayColor)}});
                 m_fallbackMaterial = rprApi->CreateMaterial(matAdapter);
 
                 rprApi->SetCurveMaterial(m_rprCurve, m_fallbackMaterial);
+                rprApi->Release(prevFallbackMaterial);
             }
         }
 
@@ -215,256 +237,340 @@ void HdRprBasisCurves::Sync(HdSceneDelegate* sceneDelegate,
     *dirtyBits = HdChangeTracker::Clean;
 }
 
-static const int kRprNumPointsPerSegment = 4;
-
-rpr::Curve* HdRprBasisCurves::CreateLinearRprCurve(HdRprApi* rprApi) {
-    // Each segment of USD linear curves defined by two vertices
-    // For tapered curve we need to convert it to RPR representation:
-    //   4 vertices and 2 radiuses per segment
-    // For cylindrical curve we can leave indices data in the same format as in USD,
-    //   but we have to ensure that number of indices in each curve multiple of kRprNumPointsPerSegment
-
-    const bool periodic = m_topology.GetCurveWrap() == HdTokens->periodic;
-    const bool strip = periodic || m_topology.GetCurveWrap() == HdTokens->nonperiodic;
-    const bool isCurveTapered = m_widthsInterpolation != HdInterpolationConstant && m_widthsInterpolation != HdInterpolationUniform;
-
-    const int kNumPointsPerSegment = 2;
-    const int kVstep = strip ? 1 : 2;
-
-    VtIntArray rprIndices;
-    VtIntArray rprSegmentPerCurve;
-    VtFloatArray rprRadiuses;
-    VtVec2fArray rprUvs;
-
-    std::function<float(int, bool)> sampleTaperRadius;
-    if (isCurveTapered) {
-        if (m_widthsInterpolation == HdInterpolationVarying) {
-            sampleTaperRadius = [this](int iSegment, bool front) {
-                return 0.5f * m_widths[iSegment + (front ? 0 : 1)];
-            };
-        } else if (m_widthsInterpolation == HdInterpolationVertex) {
-            sampleTaperRadius = [=](int iSegment, bool front) {
-                return 0.5f * m_widths[iSegment * kVstep + (front ? 0 : (kNumPointsPerSegment - 1))];
-            };
-        }
+namespace {
+
+const int kRprNumPointsPerSegment = 4;
+
+/// Maps control points of a cubic segment to Bezier control points: bezier[i] = sum(m[i][j] * points[j])
+struct BezierConversionMatrix {
+    float m[4][4];
+};
+
+// There is no way to natively support catmullRom and bSpline bases in RPR,
+// but uniform cubic segments of these bases can be exactly represented as Bezier segments
+BezierConversionMatrix const* GetBezierConversionMatrix(TfToken const& basis) {
+    static const BezierConversionMatrix kBSplineToBezier = {{
+        {1.0f / 6.0f, 4.0f / 6.0f, 1.0f / 6.0f, 0.0f},
+        {0.0f, 4.0f / 6.0f, 2.0f / 6.0f, 0.0f},
+        {0.0f, 2.0f / 6.0f, 4.0f / 6.0f, 0.0f},
+        {0.0f, 1.0f / 6.0f, 4.0f / 6.0f, 1.0f / 6.0f},
+    }};
+    static const BezierConversionMatrix kCatmullRomToBezier = {{
+        {0.0f, 1.0f, 0.0f, 0.0f},
+        {-1.0f / 6.0f, 1.0f, 1.0f / 6.0f, 0.0f},
+        {0.0f, 1.0f / 6.0f, 1.0f, -1.0f / 6.0f},
+        {0.0f, 0.0f, 1.0f, 0.0f},
+    }};
+
+    if (basis == HdTokens->bSpline) {
+        return &kBSplineToBezier;
+    } else if (basis == HdTokens->catmullRom) {
+        return &kCatmullRomToBezier;
     }
+    return nullptr;
+}
 
-    std::function<int(int)> indexSampler;
-    if (m_indices.empty()) {
-        indexSampler = [](int idx) { return idx; };
-    } else {
-        indexSampler = [this](int idx) { return m_indices.cdata()[idx]; };
+template <typename T>
+T ConvertToBezier(BezierConversionMatrix const& matrix, int row, T const* values, int const* controlPointIndices) {
+    T ret = values[controlPointIndices[0]] * matrix.m[row][0];
+    for (int i = 1; i < kRprNumPointsPerSegment; ++i) {
+        ret += values[controlPointIndices[i]] * matrix.m[row][i];
     }
+    return ret;
+}
 
-    auto& curveCounts = m_topology.GetCurveVertexCounts();
-    rprSegmentPerCurve.reserve(curveCounts.size());
+struct IdentityIndexSampler {
+    int operator()(int idx) const { return idx; }
+};
+
+struct CurveIndexSampler {
+    int const* indices;
+    int operator()(int idx) const { return indices[idx]; }
+};
+
+template <typename IndexSampler>
+void FillRprCurveIndices(IndexSampler const& indexSampler, int vstep, HdRprConvertedCurveTopology* topology) {
+    auto indicesData = topology->controlPointIndices.data();
+    auto& curves = topology->curves;
+    const bool isLinear = topology->isLinear;
+    const bool isTapered = topology->isTapered;
+
+    WorkParallelForN(curves.size(), [&](size_t begin, size_t end) {
+        for (size_t iCurve = begin; iCurve < end; ++iCurve) {
+            auto& curve = curves[iCurve];
+            auto dst = indicesData + curve.rprIndexOffset;
+
+            for (int iSegment = 0; iSegment < curve.numSegments; ++iSegment) {
+                const int segmentIndicesOffset = iSegment * vstep;
+
+                if (isLinear) {
+                    const int i0 = indexSampler(curve.vertexOffset + segmentIndicesOffset);
+                    const int i1 = indexSampler(curve.vertexOffset + (segmentIndicesOffset + 1) % curve.numVertices);
+
+                    if (isTapered) {
+                        // Each 2 vertices of USD curve corresponds to 1 tapered RPR curve segment
+                        *dst++ = i0;
+                        *dst++ = i0;
+                        *dst++ = i1;
+                        *dst++ = i1;
+                    } else {
+                        *dst++ = i0;
+                        *dst++ = i1;
+                    }
+                } else {
+                    for (int i = 0; i < kRprNumPointsPerSegment; ++i) {
+                        *dst++ = indexSampler(curve.vertexOffset + (segmentIndicesOffset + i) % curve.numVertices);
+                    }
+                }
+            }
 
-    int curveSegmentOffset = 0;
-    int curveIndicesOffset = 0;
-    for (size_t iCurve = 0; iCurve < curveCounts.size(); ++iCurve) {
-        auto numVertices = curveCounts[iCurve];
-        if (numVertices < 2) {
-            continue;
+            // RPR requires curves to consist only of segments of kRprNumPointsPerSegment length
+            auto curveEnd = indicesData + curve.rprIndexOffset + curve.numRprSegments * kRprNumPointsPerSegment;
+            if (dst != curveEnd) {
+                std::fill(dst, curveEnd, indexSampler(curve.vertexOffset + curve.numVertices - 1));
+            }
         }
+    });
+}
 
-        if (!strip && numVertices % 2 != 0) {
-            TF_RUNTIME_ERROR("[%s] corrupted curve data: segmented linear curve should contain even number of vertices", GetId().GetText());
-            return nullptr;
-        }
+} // namespace anonymous
 
-        int numSegments = (numVertices - (kNumPointsPerSegment - kVstep)) / kVstep;
-        if (periodic) numSegments++;
+bool HdRprBasisCurves::UpdateRprCurveTopology(TfToken const& basis, bool isTapered) {
+    auto topologyId = m_topology.ComputeHash();
 
-        if ((m_widthsInterpolation == HdInterpolationVarying && m_widths.size() < (curveSegmentOffset + numSegments)) ||
-            (m_widthsInterpolation == HdInterpolationVertex && m_widths.size() < (curveIndicesOffset + numVertices))) {
-            TF_RUNTIME_ERROR("[%s] corrupted curve data: insufficient amount of widths", GetId().GetText());
-            return nullptr;
-        }
+    auto& topology = m_rprCurveTopology;
+    if (topology.isValid &&
+        topology.topologyId == topologyId &&
+        topology.basis == basis &&
+        topology.isTapered == isTapered) {
+        return true;
+    }
 
-        int numNewRprIndices = numSegments * kNumPointsPerSegment;
-        if (isCurveTapered) {
-            rprRadiuses.reserve(rprRadiuses.size() + numNewRprIndices);
-            numNewRprIndices *= 2;
-        }
-        rprIndices.reserve(rprIndices.size() + numNewRprIndices);
+    const bool isLinear = basis == HdTokens->linear;
 
-        if (isCurveTapered) {
-            rprSegmentPerCurve.push_back(numVertices - 1);
-            for (int iSegment = 0; iSegment < numSegments; ++iSegment) {
-                const int segmentIndicesOffset = iSegment * kVstep;
+    topology = HdRprConvertedCurveTopology();
+    topology.topologyId = topologyId;
+    topology.basis = basis;
+    topology.isLinear = isLinear;
+    topology.isTapered = isTapered;
 
-                const int i0 = indexSampler(curveIndicesOffset + segmentIndicesOffset);
-                const int i1 = indexSampler(curveIndicesOffset + (segmentIndicesOffset + 1) % numVertices);
+    const bool periodic = m_topology.GetCurveWrap() == HdTokens->periodic;
+    const bool strip = periodic || m_topology.GetCurveWrap() == HdTokens->nonperiodic;
 
-                // Each 2 vertices of USD curve corresponds to 1 tapered RPR curve segment
-                rprIndices.push_back(i0);
-                rprIndices.push_back(i0);
-                rprIndices.push_back(i1);
-                rprIndices.push_back(i1);
+    if (!isLinear && m_topology.GetCurveWrap() == HdTokens->segmented) {
+        TF_RUNTIME_ERROR("[%s] corrupted curve data: cubic curve can not be of segmented wrap type", GetId().GetText());
+        return false;
+    }
 
-                // Each segment of tapered curve have 2 radiuses
-                rprRadiuses.push_back(sampleTaperRadius(iSegment, true));
-                rprRadiuses.push_back(sampleTaperRadius(iSegment, false));
-            }
-        } else {
-            for (int iSegment = 0; iSegment < numSegments; ++iSegment) {
-                const int segmentIndicesOffset = iSegment * kVstep;
+    // Linear: each segment of USD curve defined by two vertices.
+    //   For tapered curve we need to convert it to RPR representation: 4 vertices and 2 radiuses per segment.
+    //   For cylindrical curve we can leave indices data in the same format as in USD,
+    //   but we have to ensure that number of indices in each curve multiple of kRprNumPointsPerSegment
+    // Bezier: segments are mapped one to one
+    // BSpline and CatmullRom: each 4 consecutive vertices form a segment that is converted to Bezier one
+    const int kNumPointsPerSegment = isLinear ? 2 : 4;
+    const int kVstep = isLinear ? (strip ? 1 : 2) : (basis == HdTokens->bezier ? 3 : 1);
 
-                rprIndices.push_back(indexSampler(curveIndicesOffset + segmentIndicesOffset));
-                rprIndices.push_back(indexSampler(curveIndicesOffset + (segmentIndicesOffset + 1) % numVertices));
-            }
+    // Count segments of each curve to find out where its data is located in the output
+    auto& curveCounts = m_topology.GetCurveVertexCounts();
+    topology.curves.reserve(curveCounts.size());
 
-            // RPR requires curves to consist only of segments of kRprNumPointsPerSegment length
-            auto numPointsInCurve = (numVertices - 1) * 2;
-            auto extraPoints = numPointsInCurve % kRprNumPointsPerSegment;
-            if (extraPoints) {
-                extraPoints = kRprNumPointsPerSegment - extraPoints;
-
-                auto lastPointIndex = indexSampler(curveIndicesOffset + numVertices - 1);
-                for (int i = 0; i < extraPoints; ++i) {
-                    rprIndices.push_back(lastPointIndex);
+    int vertexOffset = 0;
+    int rprIndexOffset = 0;
+    for (size_t iCurve = 0; iCurve < curveCounts.size(); ++iCurve) {
+        const int numVertices = std::max(curveCounts[iCurve], 0);
+
+        int numSegments = 0;
+        if (numVertices >= kNumPointsPerSegment) {
+            if (isLinear) {
+                if (!strip && numVertices % 2 != 0) {
+                    TF_RUNTIME_ERROR("[%s] corrupted curve data: segmented linear curve should contain even number of vertices", GetId().GetText());
+                    return false;
                 }
+            } else if (basis == HdTokens->bezier &&
+                       ((periodic && numVertices % kVstep != 0) ||
+                        (!periodic && (numVertices - 4) % kVstep != 0))) {
+                // Validity check from the USD docs
+                TF_RUNTIME_ERROR("[%s] corrupted curve data: invalid topology", GetId().GetText());
+                return false;
             }
 
-            // Each cylindrical curve must have 1 radius
-            if (m_widthsInterpolation == HdInterpolationUniform) {
-                rprRadiuses.push_back(m_widths[iCurve] * 0.5f);
-            } else if (m_widthsInterpolation == HdInterpolationConstant) {
-                rprRadiuses.push_back(m_widths[0] * 0.5f);
+            if (periodic) {
+                numSegments = numVertices / kVstep;
+            } else {
+                numSegments = (numVertices - (kNumPointsPerSegment - kVstep)) / kVstep;
             }
 
-            rprSegmentPerCurve.push_back((numPointsInCurve + extraPoints) / kRprNumPointsPerSegment);
-        }
+            HdRprConvertedCurveTopology::Curve curve;
+            curve.usdCurveIndex = int(iCurve);
+            curve.numVertices = numVertices;
+            curve.numSegments = numSegments;
+            curve.vertexOffset = vertexOffset;
+            curve.varyingOffset = topology.numVaryingValues;
+            curve.numVaryingValues = numSegments + (periodic ? 0 : 1);
+            curve.rprIndexOffset = rprIndexOffset;
+            if (isLinear && !isTapered) {
+                curve.numRprSegments = (numSegments * 2 + kRprNumPointsPerSegment - 1) / kRprNumPointsPerSegment;
+            } else {
+                curve.numRprSegments = numSegments;
+            }
+            topology.curves.push_back(curve);
 
-        curveSegmentOffset += numSegments;
-        curveIndicesOffset += numVertices;
-    }
+            rprIndexOffset += curve.numRprSegments * kRprNumPointsPerSegment;
+        }
 
-    if (!m_uvs.empty()) {
-        if (m_uvsInterpolation == HdInterpolationUniform) {
-            rprUvs = m_uvs;
-        } else if (m_uvsInterpolation == HdInterpolationConstant) {
-            rprUvs = VtVec2fArray(rprSegmentPerCurve.size(), m_uvs[0]);
+        if (numVertices > 0) {
+            topology.numVaryingValues += numSegments + (periodic ? 0 : 1);
         }
+        vertexOffset += numVertices;
     }
 
-    return rprApi->CreateCurve(m_points, rprIndices, rprRadiuses, rprUvs, rprSegmentPerCurve);
-}
-
-rpr::Curve* HdRprBasisCurves::CreateBezierRprCurve(HdRprApi* rprApi) {
-    if (m_topology.GetCurveWrap() == HdTokens->segmented) {
-        TF_RUNTIME_ERROR("[%s] corrupted curve data: bezier curve can not be of segmented wrap type", GetId().GetText());
-        return nullptr;
+    if (!m_indices.empty() && size_t(vertexOffset) > m_indices.size()) {
+        TF_RUNTIME_ERROR("[%s] corrupted curve data: insufficient amount of indices", GetId().GetText());
+        return false;
     }
 
-    VtIntArray rprIndices;
-    VtIntArray rprSegmentPerCurve;
-    VtFloatArray rprRadiuses;
-    VtVec2fArray rprUvs;
-
-    auto& curveCounts = m_topology.GetCurveVertexCounts();
-    rprSegmentPerCurve.reserve(curveCounts.size());
-
-    const int kNumPointsPerSegment = 4;
-    const int kVstep = 3;
-
-    const bool periodic = m_topology.GetCurveWrap() == HdTokens->periodic;
-    const bool isCurveTapered = m_widthsInterpolation != HdInterpolationConstant && m_widthsInterpolation != HdInterpolationUniform;
-
-    std::function<float(int, bool)> sampleTaperRadius;
-    if (isCurveTapered) {
-        if (m_widthsInterpolation == HdInterpolationVarying) {
-            sampleTaperRadius = [this](int iSegment, bool front) {
-                return 0.5f * m_widths[iSegment + (front ? 0 : 1)];
-            };
-        } else if (m_widthsInterpolation == HdInterpolationVertex) {
-            sampleTaperRadius = [=](int iSegment, bool front) {
-                return 0.5f * m_widths[iSegment * kVstep + (front ? 0 : (kNumPointsPerSegment - 1))];
-            };
-        }
+    topology.segmentPerCurve = VtIntArray(topology.curves.size());
+    auto segmentPerCurveData = topology.segmentPerCurve.data();
+    for (size_t i = 0; i < topology.curves.size(); ++i) {
+        segmentPerCurveData[i] = topology.curves[i].numRprSegments;
     }
 
-    std::function<int(int)> indexSampler;
+    topology.controlPointIndices = VtIntArray(rprIndexOffset);
     if (m_indices.empty()) {
-        indexSampler = [](int idx) { return idx; };
+        FillRprCurveIndices(IdentityIndexSampler(), kVstep, &topology);
     } else {
-        indexSampler = [this](int idx) { return m_indices.cdata()[idx]; };
+        FillRprCurveIndices(CurveIndexSampler{m_indices.cdata()}, kVstep, &topology);
     }
 
-    int curveSegmentOffset = 0;
-    int curveIndicesOffset = 0;
-    for (size_t iCurve = 0; iCurve < curveCounts.size(); ++iCurve) {
-        auto numVertices = curveCounts[iCurve];
-        if (numVertices < kNumPointsPerSegment) {
-            continue;
-        }
-
-        // Validity check from the USD docs
-        if ((periodic && numVertices % kVstep != 0) ||
-            (!periodic && (numVertices - 4) % kVstep != 0)) {
-            TF_RUNTIME_ERROR("[%s] corrupted curve data: invalid topology", GetId().GetText());
-            return nullptr;
-        }
-
-
-        int numSegments = (numVertices - (kNumPointsPerSegment - kVstep)) / kVstep;
-        if (periodic) numSegments++;
+    if (GetBezierConversionMatrix(basis)) {
+        // Each segment gets its own Bezier control points
+        topology.indices = VtIntArray(rprIndexOffset);
+        auto indicesData = topology.indices.data();
+        WorkParallelForN(rprIndexOffset, [indicesData](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                indicesData[i] = int(i);
+            }
+        });
+    } else {
+        topology.indices = topology.controlPointIndices;
+    }
 
-        if ((m_widthsInterpolation == HdInterpolationVarying && m_widths.size() < (curveSegmentOffset + numSegments)) ||
-            (m_widthsInterpolation == HdInterpolationVertex && m_widths.size() < (curveIndicesOffset + numVertices))) {
-            TF_RUNTIME_ERROR("[%s] corrupted curve data: insufficient amount of widths", GetId().GetText());
-            return nullptr;
-        }
+    auto& controlPointIndices = topology.controlPointIndices;
+    topology.maxIndex = controlPointIndices.empty() ? -1 : *std::max_element(controlPointIndices.cbegin(), controlPointIndices.cend());
+    topology.isValid = true;
+    return true;
+}
 
-        rprIndices.reserve(rprIndices.size() + numSegments * kNumPointsPerSegment);
-        if (isCurveTapered) {
-            rprRadiuses.reserve(rprRadiuses.size() + numSegments * 2);
+bool HdRprBasisCurves::ComputeRprCurveRadiuses(VtFloatArray* radiuses) {
+    auto& topology = m_rprCurveTopology;
+    auto& curves = topology.curves;
+    auto widthsData = m_widths.cdata();
+
+    if (!topology.isTapered) {
+        // Each cylindrical curve must have 1 radius
+        *radiuses = VtFloatArray(curves.size());
+        auto radiusesData = radiuses->data();
+        for (size_t i = 0; i < curves.size(); ++i) {
+            auto width = m_widthsInterpolation == HdInterpolationUniform ? widthsData[curves[i].usdCurveIndex] : widthsData[0];
+            radiusesData[i] = width * 0.5f;
         }
+        return true;
+    }
 
-        rprSegmentPerCurve.push_back(numSegments);
-
-        for (int iSegment = 0; iSegment < numSegments; ++iSegment) {
-            const int segmentIndicesOffset = iSegment * kVstep;
-
-            const int i0 = indexSampler(curveIndicesOffset + segmentIndicesOffset + 0);
-            const int i1 = indexSampler(curveIndicesOffset + segmentIndicesOffset + 1);
-            const int i2 = indexSampler(curveIndicesOffset + segmentIndicesOffset + 2);
-            const int i3 = indexSampler(curveIndicesOffset + (segmentIndicesOffset + 3) % numVertices);
+    if ((m_widthsInterpolation == HdInterpolationVertex && m_widths.size() <= size_t(topology.maxIndex)) ||
+        (m_widthsInterpolation == HdInterpolationVarying && m_widths.size() < size_t(topology.numVaryingValues))) {
+        TF_RUNTIME_ERROR("[%s] corrupted curve data: insufficient amount of widths", GetId().GetText());
+        return false;
+    }
 
-            rprIndices.push_back(i0);
-            rprIndices.push_back(i1);
-            rprIndices.push_back(i2);
-            rprIndices.push_back(i3);
+    // Each segment of tapered curve have 2 radiuses
+    // XXX: We consciously losing data here for bezier curves because RPR supports only two radius samples per segment
+    *radiuses = VtFloatArray(2 * topology.indices.size() / kRprNumPointsPerSegment);
+    auto radiusesData = radiuses->data();
+    auto controlPointIndicesData = topology.controlPointIndices.cdata();
+    const bool isVertex = m_widthsInterpolation == HdInterpolationVertex;
+    auto bezierConversionMatrix = GetBezierConversionMatrix(topology.basis);
+
+    WorkParallelForN(curves.size(), [&](size_t begin, size_t end) {
+        for (size_t iCurve = begin; iCurve < end; ++iCurve) {
+            auto& curve = curves[iCurve];
+            const int firstSegment = curve.rprIndexOffset / kRprNumPointsPerSegment;
+
+            for (int iSegment = 0; iSegment < curve.numSegments; ++iSegment) {
+                const int rprSegment = firstSegment + iSegment;
+
+                float front, back;
+                if (isVertex) {
+                    // End points of tapered segment are its first and last Bezier control points
+                    auto segmentControlPoints = controlPointIndicesData + rprSegment * kRprNumPointsPerSegment;
+                    if (bezierConversionMatrix) {
+                        front = ConvertToBezier(*bezierConversionMatrix, 0, widthsData, segmentControlPoints);
+                        back = ConvertToBezier(*bezierConversionMatrix, kRprNumPointsPerSegment - 1, widthsData, segmentControlPoints);
+                    } else {
+                        front = widthsData[segmentControlPoints[0]];
+                        back = widthsData[segmentControlPoints[kRprNumPointsPerSegment - 1]];
+                    }
+                } else {
+                    front = widthsData[curve.varyingOffset + iSegment];
+                    back = widthsData[curve.varyingOffset + (iSegment + 1) % curve.numVaryingValues];
+                }
 
-            if (isCurveTapered) {
-                // XXX: We consciously losing data here because RPR supports only two radius samples per segment
-                rprRadiuses.push_back(sampleTaperRadius(iSegment, true));
-                rprRadiuses.push_back(sampleTaperRadius(iSegment, false));
+                radiusesData[2 * rprSegment] = 0.5f * front;
+                radiusesData[2 * rprSegment + 1] = 0.5f * back;
             }
         }
+    });
 
-        if (!isCurveTapered) {
-            // Each cylindrical curve must have 1 radius
-            if (m_widthsInterpolation == HdInterpolationUniform) {
-                rprRadiuses.push_back(m_widths[iCurve] * 0.5f);
-            } else if (m_widthsInterpolation == HdInterpolationConstant) {
-                rprRadiuses.push_back(m_widths[0] * 0.5f);
-            }
-        }
+    return true;
+}
 
-        curveSegmentOffset += numSegments;
-        curveIndicesOffset += numVertices;
+rpr::Curve* HdRprBasisCurves::CreateRprCurve(HdRprApi* rprApi, TfToken const& basis) {
+    const bool isCurveTapered = m_widthsInterpolation != HdInterpolationConstant && m_widthsInterpolation != HdInterpolationUniform;
+    if (!UpdateRprCurveTopology(basis, isCurveTapered)) {
+        return nullptr;
+    }
+
+    auto& topology = m_rprCurveTopology;
+    if (topology.maxIndex >= 0 && size_t(topology.maxIndex) >= m_points.size()) {
+        TF_RUNTIME_ERROR("[%s] corrupted curve data: curve indices are out of range", GetId().GetText());
+        return nullptr;
+    }
+
+    VtFloatArray rprRadiuses;
+    if (!ComputeRprCurveRadiuses(&rprRadiuses)) {
+        return nullptr;
     }
 
+    VtVec2fArray rprUvs;
     if (!m_uvs.empty()) {
         if (m_uvsInterpolation == HdInterpolationUniform) {
-            rprUvs = m_uvs;
+            rprUvs = VtVec2fArray(topology.curves.size());
+            for (size_t i = 0; i < topology.curves.size(); ++i) {
+                rprUvs[i] = m_uvs.cdata()[topology.curves[i].usdCurveIndex];
+            }
         } else if (m_uvsInterpolation == HdInterpolationConstant) {
-            rprUvs = VtVec2fArray(rprSegmentPerCurve.size(), m_uvs[0]);
+            rprUvs = VtVec2fArray(topology.curves.size(), m_uvs.cdata()[0]);
         }
     }
 
-    return rprApi->CreateCurve(m_points, rprIndices, rprRadiuses, rprUvs, rprSegmentPerCurve);
+    VtVec3fArray rprPoints = m_points;
+    if (auto bezierConversionMatrix = GetBezierConversionMatrix(topology.basis)) {
+        rprPoints = VtVec3fArray(topology.controlPointIndices.size());
+        auto rprPointsData = rprPoints.data();
+        auto pointsData = m_points.cdata();
+        auto controlPointIndicesData = topology.controlPointIndices.cdata();
+        WorkParallelForN(rprPoints.size() / kRprNumPointsPerSegment, [&](size_t begin, size_t end) {
+            for (size_t iSegment = begin; iSegment < end; ++iSegment) {
+                auto segmentControlPoints = controlPointIndicesData + iSegment * kRprNumPointsPerSegment;
+                for (int i = 0; i < kRprNumPointsPerSegment; ++i) {
+                    rprPointsData[iSegment * kRprNumPointsPerSegment + i] = ConvertToBezier(*bezierConversionMatrix, i, pointsData, segmentControlPoints);
+                }
+            }
+        });
+    }
+
+    return rprApi->CreateCurve(rprPoints, topology.indices, rprRadiuses, rprUvs, topology.segmentPerCurve);
 }
 
 void HdRprBasisCurves::Finalize(HdRenderParam* renderParam) {
@@ -17,6 +17,9 @@ limitations under the License.
 #include "pxr/imaging/hd/basisCurves.h"
 #include "pxr/base/gf/matrix4f.h"
 #include "pxr/base/gf/vec2f.h"
+#include "pxr/base/gf/vec3f.h"
+
+#include <vector>
 
 namespace rpr { class Curve; }
 
@@ -25,6 +28,37 @@ PXR_NAMESPACE_OPEN_SCOPE
 class HdRprApi;
 struct HdRprApiMaterial;
 
+/// USD curves converted to RPR representation (curves that consist of segments of 4 control points).
+/// The conversion depends only on the topology, so it's reused when points, widths or uvs change.
+struct HdRprConvertedCurveTopology {
+    struct Curve {
+        int usdCurveIndex;
+        int numVertices;
+        int numSegments;
+        int vertexOffset;
+        int varyingOffset;
+        int numVaryingValues;
+        int rprIndexOffset;
+        int numRprSegments;
+    };
+
+    HdTopology::ID topologyId = 0;
+    TfToken basis;
+    bool isLinear = false;
+    bool isTapered = false;
+    bool isValid = false;
+
+    std::vector<Curve> curves;
+    int numVaryingValues = 0;
+    int maxIndex = -1;
+
+    // Indices of USD points that define each RPR segment (4 per segment)
+    VtIntArray controlPointIndices;
+    // Indices that are passed to RPR. Equal to controlPointIndices unless control points are converted to Bezier basis
+    VtIntArray indices;
+    VtIntArray segmentPerCurve;
+};
+
 class HdRprMaterial;
 
 class HdRprBasisCurves : public HdBasisCurves {
@@ -51,22 +85,26 @@ protected:
                    HdDirtyBits* dirtyBits) override;
 
 private:
-    rpr::Curve* CreateLinearRprCurve(HdRprApi* rprApi);
-    rpr::Curve* CreateBezierRprCurve(HdRprApi* rprApi);
+    rpr::Curve* CreateRprCurve(HdRprApi* rprApi, TfToken const& basis);
+    bool UpdateRprCurveTopology(TfToken const& basis, bool isTapered);
+    bool ComputeRprCurveRadiuses(VtFloatArray* radiuses);
 
 private:
     rpr::Curve* m_rprCurve = nullptr;
     HdRprApiMaterial* m_fallbackMaterial = nullptr;
 
-    HdRprMaterial const* m_cachedMaterial;
+    HdRprMaterial const* m_cachedMaterial = nullptr;
 
     HdBasisCurvesTopology m_topology;
+    HdRprConvertedCurveTopology m_rprCurveTopology;
     VtIntArray m_indices;
     VtFloatArray m_widths;
-    HdInterpolation m_widthsInterpolation;
+    HdInterpolation m_widthsInterpolation = HdInterpolationConstant;
     VtVec2fArray m_uvs;
-    HdInterpolation m_uvsInterpolation;
+    HdInterpolation m_uvsInterpolation = HdInterpolationConstant;
     VtVec3fArray m_points;
+    // Color of the fallback material
+    GfVec3f m_displayColor = GfVec3f(0.18f);
     GfMatrix4f m_transform;
 
     uint32_t m_visibilityMask;
@@ -74,7 +74,7 @@ void HdRprCamera::Sync(HdSceneDelegate* sceneDelegate,
                        HdRenderParam* renderParam,
                        HdDirtyBits* dirtyBits) {
     // HdRprApi uses HdRprCamera directly, so we need to stop the render thread before changing the camera.
-    static_cast<HdRprRenderParam*>(renderParam)->AcquireRprApiForEdit();
+    static_cast<HdRprRenderParam*>(renderParam)->GetRenderThread()->StopRender();
 
     m_rprDirtyBits |= *dirtyBits;
 
@@ -106,7 +106,7 @@ void HdRprCamera::Sync(HdSceneDelegate* sceneDelegate,
 
 void HdRprCamera::Finalize(HdRenderParam* renderParam) {
     // HdRprApi uses HdRprCamera directly, so we need to stop the render thread before releasing the camera.
-    static_cast<HdRprRenderParam*>(renderParam)->AcquireRprApiForEdit();
+    static_cast<HdRprRenderParam*>(renderParam)->GetRenderThread()->StopRender();
 }
 
 bool HdRprCamera::GetApertureSize(GfVec2f* v) const {
@@ -21,6 +21,11 @@ PXR_NAMESPACE_OPEN_SCOPE
 TF_REGISTRY_FUNCTION(TfDebug) {
     TF_DEBUG_ENVIRONMENT_SYMBOL(HD_RPR_DEBUG_CONTEXT_CREATION, "hdRpr context creation");
     TF_DEBUG_ENVIRONMENT_SYMBOL(HD_RPR_DEBUG_CORE_UNSUPPORTED_ERROR, "hdRpr signal about unsupported errors");
+    TF_DEBUG_ENVIRONMENT_SYMBOL(HD_RPR_DEBUG_VDB_CACHE, "hdRpr vdb grid cache statistics");
+    TF_DEBUG_ENVIRONMENT_SYMBOL(HD_RPR_DEBUG_VOLUME_LOD, "hdRpr memory used by each volume level of detail");
+    TF_DEBUG_ENVIRONMENT_SYMBOL(HD_RPR_DEBUG_TEXTURE_LOADING, "hdRpr asynchronous texture loading");
+    TF_DEBUG_ENVIRONMENT_SYMBOL(HD_RPR_DEBUG_IMAGE_CACHE, "hdRpr image cache statistics per frame");
+    TF_DEBUG_ENVIRONMENT_SYMBOL(HD_RPR_DEBUG_TEXTURE_RESOLUTION, "hdRpr memory saved by loading textures at reduced resolution");
 }
 
 PXR_NAMESPACE_CLOSE_SCOPE
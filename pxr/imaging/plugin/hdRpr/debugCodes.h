@@ -21,7 +21,12 @@ PXR_NAMESPACE_OPEN_SCOPE
 
 TF_DEBUG_CODES(
     HD_RPR_DEBUG_CONTEXT_CREATION,
-    HD_RPR_DEBUG_CORE_UNSUPPORTED_ERROR
+    HD_RPR_DEBUG_CORE_UNSUPPORTED_ERROR,
+    HD_RPR_DEBUG_VDB_CACHE,
+    HD_RPR_DEBUG_VOLUME_LOD,
+    HD_RPR_DEBUG_TEXTURE_LOADING,
+    HD_RPR_DEBUG_IMAGE_CACHE,
+    HD_RPR_DEBUG_TEXTURE_RESOLUTION
 );
 
 PXR_NAMESPACE_CLOSE_SCOPE
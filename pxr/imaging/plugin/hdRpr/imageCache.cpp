@@ -13,73 +13,552 @@ limitations under the License.
 
 #include "imageCache.h"
 #include "rpr/helpers.h"
-#include "rpr/imageHelpers.h"
+#include "rpr/error.h"
+
+#include "debugCodes.h"
 
 #include "pxr/base/arch/fileSystem.h"
+#include "pxr/base/arch/hash.h"
+#include "pxr/base/tf/envSetting.h"
+#include "pxr/base/tf/diagnostic.h"
+#include "pxr/base/tf/fileUtils.h"
+#include "pxr/base/tf/stringUtils.h"
+
+#include <algorithm>
+#include <cstring>
 
 PXR_NAMESPACE_OPEN_SCOPE
 
-ImageCache::ImageCache(rpr::Context* context)
-    : m_context(context) {
+TF_DEFINE_ENV_SETTING(HDRPR_TEXTURE_LOADING_THREADS, 4,
+    "Number of threads that decode textures in the background in interactive mode, 0 disables asynchronous texture loading");
+
+namespace {
+
+const char* kForceLinearSpaceCacheKeySuffix = "?l";
+const char* kMaxResolutionCacheKeySuffix = "?r";
+
+const char* kUdimTag = "<UDIM>";
+const uint32_t kUdimFirstTile = 1001;
+// 10 tiles in U direction by 100 tiles in V direction
+const uint32_t kUdimMaxTiles = 1000;
+
+} // namespace anonymous
 
+ImageCache::ImageCache(rpr::Context* context, std::string const& cacheDir, bool asyncLoading)
+    : m_context(context)
+    , m_diskCache(cacheDir) {
+    if (asyncLoading) {
+        int numThreads = std::min(TfGetEnvSetting(HDRPR_TEXTURE_LOADING_THREADS), int(std::max(std::thread::hardware_concurrency(), 1u)));
+        for (int i = 0; i < numThreads; ++i) {
+            m_loadingThreads.emplace_back(&ImageCache::LoadingThreadMain, this);
+        }
+    }
 }
 
-std::shared_ptr<rpr::Image> ImageCache::GetImage(std::string const& path, bool forceLinearSpace) {
-    ImageMetadata md(path);
+ImageCache::~ImageCache() {
+    {
+        std::lock_guard<std::mutex> lock(m_loadMutex);
+        m_stopLoading = true;
+    }
+    m_loadCV.notify_all();
+    for (auto& thread : m_loadingThreads) {
+        thread.join();
+    }
+}
 
+std::string ImageCache::GetCacheKey(std::string const& path, bool forceLinearSpace, uint32_t maxResolution) {
     auto cacheKey = path;
-
-    static const char* kForceLinearSpaceCacheKeySuffix = "?l";
     if (forceLinearSpace) {
         cacheKey += kForceLinearSpaceCacheKeySuffix;
     }
+    if (maxResolution) {
+        cacheKey += kMaxResolutionCacheKeySuffix + std::to_string(maxResolution);
+    }
+    return cacheKey;
+}
+
+std::shared_ptr<rpr::Image> ImageCache::FindCachedImage(std::string const& cacheKey, ImageMetadata const& md) {
+    std::lock_guard<std::mutex> lock(m_cacheMutex);
+
+    auto it = FindLocked(cacheKey);
+    if (it != m_cache.end()) {
+        if (it->second.metadata.IsMetadataEqual(md)) {
+            m_lru.splice(m_lru.begin(), m_lru, it->second.lruIt);
+            m_stats.numHits++;
+            return it->second.image;
+        }
+
+        // The file was modified since we loaded it
+        EraseLocked(it);
+    }
 
+    m_stats.numMisses++;
+    return nullptr;
+}
+
+std::shared_ptr<rpr::Image> ImageCache::CacheImage(std::string const& path, bool forceLinearSpace, uint32_t maxResolution, ImageMetadata const& md,
+                                                   std::shared_ptr<rpr::Image> const& image, size_t fullResolutionSize) {
+    auto desc = rpr::GetImageDesc(image.get());
+    auto gammaFromFile = rpr::GetInfo<float>(image.get(), RPR_IMAGE_GAMMA_FROM_FILE);
+    auto cacheKey = GetCacheKey(path, forceLinearSpace, maxResolution);
+
+    std::lock_guard<std::mutex> lock(m_cacheMutex);
+
+    auto it = FindLocked(cacheKey);
+    if (it != m_cache.end()) {
+        if (it->second.metadata.IsMetadataEqual(md)) {
+            // Another thread has loaded the same image in the meantime
+            return it->second.image;
+        }
+        EraseLocked(it);
+    }
+
+    auto& entry = m_cache[cacheKey];
+    entry.metadata = md;
+    entry.image = image;
+    entry.memoryUsage = size_t(desc.image_slice_pitch) * std::max(desc.image_depth, 1u);
+    entry.memorySaved = fullResolutionSize > entry.memoryUsage ? fullResolutionSize - entry.memoryUsage : 0;
+    entry.lruIt = m_lru.insert(m_lru.begin(), cacheKey);
+    m_stats.memoryUsage += entry.memoryUsage;
+    m_stats.memorySaved += entry.memorySaved;
+    m_stats.numImages++;
+
+    if (std::abs(gammaFromFile - 1.0f) < 0.01f) {
+        // Image is in linear space, we can cache the same image for both variants of forceLinearSpace
+        auto aliasKey = GetCacheKey(path, !forceLinearSpace, maxResolution);
+        if (m_cache.count(aliasKey) == 0) {
+            m_cacheAliases[aliasKey] = cacheKey;
+            entry.aliasKey = aliasKey;
+        }
+    }
+
+    EvictLocked(cacheKey);
+
+    return image;
+}
+
+ImageCache::CacheIterator ImageCache::FindLocked(std::string const& cacheKey) {
     auto it = m_cache.find(cacheKey);
-    if (it != m_cache.end() && it->second.IsMetadataEqual(md)) {
-        if (auto image = it->second.handle.lock()) {
-            return image;
+    if (it == m_cache.end()) {
+        auto aliasIt = m_cacheAliases.find(cacheKey);
+        if (aliasIt != m_cacheAliases.end()) {
+            it = m_cache.find(aliasIt->second);
+        }
+    }
+    return it;
+}
+
+void ImageCache::EraseLocked(CacheIterator it) {
+    auto& entry = it->second;
+    if (!entry.aliasKey.empty()) {
+        m_cacheAliases.erase(entry.aliasKey);
+    }
+    m_stats.memoryUsage -= entry.memoryUsage;
+    m_stats.memorySaved -= entry.memorySaved;
+    m_stats.numImages--;
+    m_lru.erase(entry.lruIt);
+    m_cache.erase(it);
+}
+
+void ImageCache::EvictLocked(std::string const& keepKey) {
+    auto lruIt = m_lru.end();
+    while (m_stats.memoryUsage > m_stats.memoryBudget && lruIt != m_lru.begin()) {
+        --lruIt;
+
+        auto it = m_cache.find(*lruIt);
+        // Images referenced by materials would stay alive anyway
+        if (*lruIt == keepKey || it->second.image.use_count() > 1) {
+            continue;
+        }
+
+        // EraseLocked invalidates lruIt, continue from its less recently used neighbour
+        auto nextLruIt = std::next(lruIt);
+        EraseLocked(it);
+        lruIt = nextLruIt;
+        m_stats.numEvictions++;
+    }
+}
+
+std::shared_ptr<rpr::Image> ImageCache::GetImage(std::string const& path, bool forceLinearSpace) {
+    ImageMetadata md(path);
+
+    uint32_t maxResolution = m_maxResolution;
+    if (auto image = FindCachedImage(GetCacheKey(path, forceLinearSpace, maxResolution), md)) {
+        return image;
+    }
+
+    rpr::ImageData data;
+    LoadImageData(path, forceLinearSpace, maxResolution, md, &data);
+    auto image = CreateImage(path, data);
+    if (!image) {
+        return nullptr;
+    }
+    return CacheImage(path, forceLinearSpace, maxResolution, md, image, data.fullResolutionSize);
+}
+
+void ImageCache::SetMaxResolution(uint32_t maxResolution) {
+    m_maxResolution = maxResolution;
+}
+
+uint64_t ImageCache::GetImagesStateHash(std::vector<std::string> const& paths) const {
+    uint32_t maxResolution = m_maxResolution;
+    uint64_t hash = ArchHash64(reinterpret_cast<const char*>(&maxResolution), sizeof(maxResolution));
+    for (auto& path : paths) {
+        ImageMetadata md(path);
+        size_t size = md.GetSize();
+        double modificationTime = md.GetModificationTime();
+        hash = ArchHash64(path.c_str(), path.size(), hash);
+        hash = ArchHash64(reinterpret_cast<const char*>(&size), sizeof(size), hash);
+        hash = ArchHash64(reinterpret_cast<const char*>(&modificationTime), sizeof(modificationTime), hash);
+    }
+    return hash;
+}
+
+bool ImageCache::LoadImageData(std::string const& path, bool forceLinearSpace, uint32_t maxResolution, ImageMetadata const& md, rpr::ImageData* data) {
+    auto diskCacheKey = TfStringPrintf("%s?%d?%u?%zu?%.17g", path.c_str(), int(forceLinearSpace), maxResolution, md.GetSize(), md.GetModificationTime());
+    if (m_diskCache.Read(diskCacheKey, data)) {
+        return true;
+    }
+
+    if (!rpr::LoadImageData(path.c_str(), forceLinearSpace, maxResolution, data)) {
+        return false;
+    }
+
+    auto size = size_t(data->desc.image_slice_pitch);
+    if (size < data->fullResolutionSize) {
+        TF_DEBUG(HD_RPR_DEBUG_TEXTURE_RESOLUTION).Msg("%s: loaded at %ux%u, saved %zu of %zu bytes\n",
+            path.c_str(), data->desc.image_width, data->desc.image_height, data->fullResolutionSize - size, data->fullResolutionSize);
+    }
+
+    m_diskCache.Write(diskCacheKey, *data);
+
+    return true;
+}
+
+std::shared_ptr<rpr::Image> ImageCache::CreateImage(std::string const& path, rpr::ImageData const& data) {
+    if (data.pixels) {
+        return std::shared_ptr<rpr::Image>(rpr::CreateImage(m_context, data));
+    }
+    return std::shared_ptr<rpr::Image>(m_context->CreateImageFromFile(path.c_str()));
+}
+
+std::shared_ptr<ImageCache::ImageBinding> ImageCache::BindImage(rpr::MaterialNode* textureNode, std::string const& path, bool forceLinearSpace,
+                                                                rpr::ImageWrapType const* wrapType, GfVec3f const& placeholderColor) {
+    auto binding = std::make_shared<ImageBinding>();
+    binding->textureNode = textureNode;
+    if (wrapType) {
+        binding->hasWrapType = true;
+        binding->wrapType = *wrapType;
+    }
+
+    if (!LoadImage(binding, path, forceLinearSpace)) {
+        return nullptr;
+    }
+
+    if (!binding->image) {
+        binding->image = GetPlaceholderImage(placeholderColor);
+        binding->isPlaceholder = true;
+        RPR_ERROR_CHECK(textureNode->SetInput(RPR_MATERIAL_INPUT_DATA, binding->image.get()), "Failed to set material node image data input");
+    }
+
+    return binding;
+}
+
+bool ImageCache::LoadImage(std::shared_ptr<ImageBinding> const& binding, std::string const& path, bool forceLinearSpace) {
+    if (m_loadingThreads.empty()) {
+        auto image = GetImage(path, forceLinearSpace);
+        if (!image) {
+            return false;
+        }
+
+        BindLoadedImage(binding.get(), image);
+        return true;
+    }
+
+    ImageMetadata md(path);
+    uint32_t maxResolution = m_maxResolution;
+    auto cacheKey = GetCacheKey(path, forceLinearSpace, maxResolution);
+    if (auto image = FindCachedImage(cacheKey, md)) {
+        BindLoadedImage(binding.get(), image);
+        return true;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_loadMutex);
+
+        auto status = m_loadRequests.emplace(cacheKey, nullptr);
+        auto& request = status.first->second;
+        if (status.second) {
+            request = std::make_shared<LoadRequest>();
+            request->path = path;
+            request->cacheKey = cacheKey;
+            request->forceLinearSpace = forceLinearSpace;
+            request->maxResolution = maxResolution;
+            request->metadata = md;
+            request->order = m_numLoadRequests++;
+            m_loadQueue.push_back(request);
         }
+        request->bindings.push_back(binding);
     }
+    m_loadCV.notify_one();
+
+    return true;
+}
+
+bool ImageCache::IsUdimPath(std::string const& path) {
+    return path.find(kUdimTag) != std::string::npos;
+}
 
-    auto image = std::shared_ptr<rpr::Image>(rpr::CreateImage(m_context, path.c_str(), forceLinearSpace));
-    if (image) {
-        md.handle = image;
-        m_cache.emplace(cacheKey, md);
+std::shared_ptr<ImageCache::UdimImage> ImageCache::GetUdimImage(std::string const& path, bool forceLinearSpace) {
+    auto key = GetCacheKey(path, forceLinearSpace, 0);
 
-        auto gammaFromFile = rpr::GetInfo<float>(image.get(), RPR_IMAGE_GAMMA_FROM_FILE);
-        if (std::abs(gammaFromFile - 1.0f) < 0.01f) {
-            // Image is in linear space, we can cache the same image for both variants of forceLinearSpace
-            if (forceLinearSpace) {
-                m_cache.emplace(path, md);
-            } else {
-                m_cache.emplace(path + kForceLinearSpaceCacheKeySuffix, md);
+    std::lock_guard<std::mutex> lock(m_cacheMutex);
+
+    auto& weakUdimImage = m_udimImages[key];
+    if (auto udimImage = weakUdimImage.lock()) {
+        return udimImage;
+    }
+
+    // Tiles are attached to the empty image with rprImageSetUDIM
+    rpr::Status status;
+    auto image = std::shared_ptr<rpr::Image>(m_context->CreateImage(rpr::ImageFormat{}, rpr::ImageDesc{}, nullptr, &status));
+    if (!image) {
+        RPR_ERROR_CHECK(status, "Failed to create UDIM image");
+        return nullptr;
+    }
+
+    auto udimImage = std::make_shared<UdimImage>();
+    udimImage->path = path;
+    udimImage->forceLinearSpace = forceLinearSpace;
+    udimImage->image = std::move(image);
+
+    // Find tiles with one directory listing instead of checking each of 1000 possible tiles
+    auto tagPos = path.find(kUdimTag);
+    auto prefix = path.substr(0, tagPos);
+    auto suffix = path.substr(tagPos + std::strlen(kUdimTag));
+    auto dirPos = prefix.find_last_of("/\\");
+    auto dir = dirPos == std::string::npos ? std::string(".") : prefix.substr(0, dirPos);
+    auto filenamePrefix = dirPos == std::string::npos ? prefix : prefix.substr(dirPos + 1);
+
+    std::vector<std::string> dirnames, filenames, symlinknames;
+    TfReadDir(dir, &dirnames, &filenames, &symlinknames);
+    for (auto& filename : filenames) {
+        if (filename.size() == filenamePrefix.size() + 4 + suffix.size() &&
+            TfStringStartsWith(filename, filenamePrefix) &&
+            TfStringEndsWith(filename, suffix)) {
+            auto tileStr = filename.substr(filenamePrefix.size(), 4);
+            if (std::all_of(tileStr.begin(), tileStr.end(), [](char c) { return c >= '0' && c <= '9'; })) {
+                auto tile = uint32_t(std::stoi(tileStr));
+                if (tile >= kUdimFirstTile && tile < kUdimFirstTile + kUdimMaxTiles) {
+                    udimImage->availableTiles.push_back(tile);
+                }
             }
         }
     }
+    std::sort(udimImage->availableTiles.begin(), udimImage->availableTiles.end());
+    if (udimImage->availableTiles.empty()) {
+        TF_RUNTIME_ERROR("No UDIM tiles found for %s", path.c_str());
+    }
+
+    weakUdimImage = udimImage;
+    return udimImage;
+}
+
+bool ImageCache::RequireUdimTiles(UdimImage* udimImage, std::vector<uint32_t> const& tiles) {
+    bool isChanged = false;
+    for (auto tile : tiles) {
+        if (!std::binary_search(udimImage->availableTiles.begin(), udimImage->availableTiles.end(), tile)) {
+            continue;
+        }
+
+        auto status = udimImage->tiles.emplace(tile, nullptr);
+        if (!status.second) {
+            continue;
+        }
+
+        auto tilePath = udimImage->path;
+        tilePath.replace(tilePath.find(kUdimTag), std::strlen(kUdimTag), std::to_string(tile));
+
+        auto binding = std::make_shared<ImageBinding>();
+        binding->udimImage = udimImage->image.get();
+        binding->udimTile = tile;
+        if (LoadImage(binding, tilePath, udimImage->forceLinearSpace)) {
+            isChanged |= binding->image != nullptr;
+            status.first->second = std::move(binding);
+        }
+    }
+    return isChanged;
+}
+
+bool ImageCache::HasMissingUdimTiles(UdimImage const* udimImage, std::vector<uint32_t> const& tiles) const {
+    for (auto tile : tiles) {
+        if (std::binary_search(udimImage->availableTiles.begin(), udimImage->availableTiles.end(), tile) &&
+            udimImage->tiles.count(tile) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void ImageCache::BindLoadedImage(ImageBinding* binding, std::shared_ptr<rpr::Image> const& image) {
+    if (binding->udimImage) {
+        RPR_ERROR_CHECK(rprImageSetUDIM(rpr::GetRprObject(binding->udimImage), binding->udimTile, rpr::GetRprObject(image.get())), "Failed to set UDIM tile");
+    } else {
+        if (binding->hasWrapType) {
+            RPR_ERROR_CHECK(image->SetWrap(binding->wrapType), "Failed to set image wrap mode");
+        }
+        RPR_ERROR_CHECK(binding->textureNode->SetInput(RPR_MATERIAL_INPUT_DATA, image.get()), "Failed to set material node image data input");
+    }
+    binding->image = image;
+    binding->isPlaceholder = false;
+}
+
+std::shared_ptr<rpr::Image> ImageCache::GetPlaceholderImage(GfVec3f const& color) {
+    for (auto& entry : m_placeholderImages) {
+        if (entry.first == color) {
+            return entry.second;
+        }
+    }
+
+    rpr::ImageFormat format = {};
+    format.num_components = 4;
+    format.type = RPR_COMPONENT_TYPE_FLOAT32;
+    float pixel[4] = {color[0], color[1], color[2], 1.0f};
+
+    rpr::Status status;
+    auto image = std::shared_ptr<rpr::Image>(rpr::CreateImage(m_context, 1, 1, format, pixel, &status));
+    if (!image) {
+        RPR_ERROR_CHECK(status, "Failed to create placeholder image");
+        return nullptr;
+    }
+
+    m_placeholderImages.emplace_back(color, image);
     return image;
 }
 
+void ImageCache::LoadingThreadMain() {
+    while (true) {
+        std::shared_ptr<LoadRequest> request;
+        {
+            std::unique_lock<std::mutex> lock(m_loadMutex);
+            m_loadCV.wait(lock, [this]() { return m_stopLoading || !m_loadQueue.empty(); });
+            if (m_stopLoading) {
+                return;
+            }
+
+            // Pick the image that most texture nodes are waiting for
+            auto requestIt = m_loadQueue.begin();
+            size_t maxNumBindings = 0;
+            for (auto it = m_loadQueue.begin(); it != m_loadQueue.end(); ++it) {
+                auto numBindings = std::count_if((*it)->bindings.begin(), (*it)->bindings.end(),
+                    [](std::weak_ptr<ImageBinding> const& binding) { return !binding.expired(); });
+                if (size_t(numBindings) > maxNumBindings ||
+                    (size_t(numBindings) == maxNumBindings && (*it)->order < (*requestIt)->order)) {
+                    requestIt = it;
+                    maxNumBindings = numBindings;
+                }
+            }
+            request = *requestIt;
+            m_loadQueue.erase(requestIt);
+
+            if (maxNumBindings == 0) {
+                // Nobody waits for this image anymore
+                m_loadRequests.erase(request->cacheKey);
+                continue;
+            }
+        }
+
+        rpr::ImageData data;
+        if (!LoadImageData(request->path, request->forceLinearSpace, request->maxResolution, request->metadata, &data)) {
+            // Leave it to CreateImageFromFile
+            data = rpr::ImageData();
+        }
+
+        std::lock_guard<std::mutex> lock(m_loadMutex);
+        request->data = std::move(data);
+        m_loadedRequests.push_back(std::move(request));
+    }
+}
+
+bool ImageCache::CommitLoadedImages() {
+    std::vector<std::shared_ptr<LoadRequest>> loadedRequests;
+    {
+        std::lock_guard<std::mutex> lock(m_loadMutex);
+        if (m_loadedRequests.empty()) {
+            return false;
+        }
+
+        std::swap(loadedRequests, m_loadedRequests);
+        for (auto& request : loadedRequests) {
+            m_loadRequests.erase(request->cacheKey);
+        }
+    }
+
+    bool anyBound = false;
+    for (auto& request : loadedRequests) {
+        auto image = CreateImage(request->path, request->data);
+        auto fullResolutionSize = request->data.fullResolutionSize;
+        request->data = rpr::ImageData();
+
+        if (!image) {
+            // Texture nodes keep sampling the placeholder
+            TF_RUNTIME_ERROR("Failed to load image %s", request->path.c_str());
+            continue;
+        }
+
+        image = CacheImage(request->path, request->forceLinearSpace, request->maxResolution, request->metadata, image, fullResolutionSize);
+
+        for (auto& weakBinding : request->bindings) {
+            if (auto binding = weakBinding.lock()) {
+                BindLoadedImage(binding.get(), image);
+                anyBound = true;
+            }
+        }
+    }
+
+    TF_DEBUG(HD_RPR_DEBUG_TEXTURE_LOADING).Msg("Committed %zu loaded images, %zu images pending\n", loadedRequests.size(), GetNumPendingLoads());
+
+    return anyBound;
+}
+
+bool ImageCache::HasLoadedImages() const {
+    std::lock_guard<std::mutex> lock(m_loadMutex);
+    return !m_loadedRequests.empty();
+}
+
+size_t ImageCache::GetNumPendingLoads() const {
+    std::lock_guard<std::mutex> lock(m_loadMutex);
+    return m_loadRequests.size();
+}
+
 void ImageCache::RequireGarbageCollection() {
+    std::lock_guard<std::mutex> lock(m_cacheMutex);
     m_garbageCollectionRequired = true;
 }
 
 void ImageCache::GarbageCollectIfNeeded() {
+    std::lock_guard<std::mutex> lock(m_cacheMutex);
     if (!m_garbageCollectionRequired) {
         return;
     }
 
-    auto it = m_cache.begin();
-    while (it != m_cache.end()) {
-        if (it->second.handle.expired()) {
-            it = m_cache.erase(it);
-        } else {
-            ++it;
-        }
-    }
+    // Some images could have become unreferenced since the last eviction
+    EvictLocked(std::string());
 
     m_garbageCollectionRequired = false;
 }
 
+void ImageCache::SetMemoryBudget(size_t bytes) {
+    std::lock_guard<std::mutex> lock(m_cacheMutex);
+    m_stats.memoryBudget = bytes;
+    EvictLocked(std::string());
+}
+
+ImageCache::Statistics ImageCache::GetStatistics() const {
+    std::lock_guard<std::mutex> lock(m_cacheMutex);
+    return m_stats;
+}
+
 ImageCache::ImageMetadata::ImageMetadata(std::string const& path) {
     double time;
     if (!ArchGetModificationTime(path.c_str(), &time)) {
@@ -95,7 +574,7 @@ ImageCache::ImageMetadata::ImageMetadata(std::string const& path) {
     m_size = static_cast<size_t>(size);
 }
 
-bool ImageCache::ImageMetadata::IsMetadataEqual(ImageMetadata const& md) {
+bool ImageCache::ImageMetadata::IsMetadataEqual(ImageMetadata const& md) const {
     return m_modificationTime == md.m_modificationTime &&
         m_size == md.m_size;
 }
@@ -15,29 +15,106 @@ limitations under the License.
 #define HDRPR_IMAGE_CACHE_H
 
 #include "pxr/pxr.h"
+#include "pxr/base/gf/vec3f.h"
 
+#include "textureDiskCache.h"
+#include "rpr/imageHelpers.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <list>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <unordered_map>
-
-namespace rpr {
-
-class Context;
-class Image;
-
-} // namespace rpr
+#include <vector>
 
 PXR_NAMESPACE_OPEN_SCOPE
 
+/// Images are kept in the cache until the total size of cached images exceeds the memory budget.
+/// Then least recently used images that are not referenced by any material are released.
+/// Lookups are thread-safe.
 class ImageCache {
 public:
-    ImageCache(rpr::Context* context);
+    /// When asyncLoading is set, BindImage decodes images on background threads.
+    /// Decoded images are stored in cacheDir, if it's not empty.
+    ImageCache(rpr::Context* context, std::string const& cacheDir, bool asyncLoading = false);
+    ~ImageCache();
 
     std::shared_ptr<rpr::Image> GetImage(std::string const& path, bool forceLinearSpace = false);
 
+    /// Image bound to the data input of the image texture node or to the tile of UDIM image.
+    /// While the image is being loaded, the node samples a single pixel placeholder image.
+    /// The loaded image is bound to the node by CommitLoadedImages as long as the binding is alive.
+    struct ImageBinding {
+        rpr::MaterialNode* textureNode = nullptr;
+        rpr::Image* udimImage = nullptr;
+        uint32_t udimTile = 0;
+        std::shared_ptr<rpr::Image> image;
+        bool isPlaceholder = false;
+        bool hasWrapType = false;
+        rpr::ImageWrapType wrapType;
+    };
+
+    /// Returns nullptr if the image is loaded synchronously and loading failed
+    std::shared_ptr<ImageBinding> BindImage(rpr::MaterialNode* textureNode, std::string const& path, bool forceLinearSpace,
+                                            rpr::ImageWrapType const* wrapType, GfVec3f const& placeholderColor = GfVec3f(0.5f));
+
+    /// Image that combines UDIM tiles of the texture which path contains <UDIM> tag.
+    /// The image is shared by all materials that reference the same path.
+    /// Tiles are loaded only when some mesh requires them (see RequireUdimTiles).
+    struct UdimImage {
+        std::string path;
+        bool forceLinearSpace;
+        std::shared_ptr<rpr::Image> image;
+        // Tiles that exist on disk
+        std::vector<uint32_t> availableTiles;
+        std::map<uint32_t, std::shared_ptr<ImageBinding>> tiles;
+    };
+
+    static bool IsUdimPath(std::string const& path);
+    std::shared_ptr<UdimImage> GetUdimImage(std::string const& path, bool forceLinearSpace);
+    /// Loads tiles that were not loaded yet. Tiles that do not exist are ignored.
+    /// Returns true if the image was changed.
+    bool RequireUdimTiles(UdimImage* udimImage, std::vector<uint32_t> const& tiles);
+    /// Returns true if some of the tiles exist on disk but were not requested yet
+    bool HasMissingUdimTiles(UdimImage const* udimImage, std::vector<uint32_t> const& tiles) const;
+
+    /// Uploads images decoded since the last call to RPR in one go and binds them to texture nodes.
+    /// Returns true if any texture node was changed.
+    bool CommitLoadedImages();
+    bool HasLoadedImages() const;
+    /// Number of images that are queued or being decoded or waiting to be committed
+    size_t GetNumPendingLoads() const;
+
     void RequireGarbageCollection();
     void GarbageCollectIfNeeded();
 
+    void SetMemoryBudget(size_t bytes);
+    /// Images are loaded at the first mip level that is not bigger than maxResolution, zero means full resolution.
+    /// Applies to images loaded after the call.
+    void SetMaxResolution(uint32_t maxResolution);
+
+    /// Hash of the current state of the files and of the settings the images would be loaded with.
+    /// Images bound while the hash was different might be stale (e.g. the file was modified or max resolution changed)
+    uint64_t GetImagesStateHash(std::vector<std::string> const& paths) const;
+
+    struct Statistics {
+        size_t numHits = 0;
+        size_t numMisses = 0;
+        size_t numEvictions = 0;
+        size_t numImages = 0;
+        size_t memoryUsage = 0;
+        size_t memoryBudget = 0;
+        // Memory that cached images would take at full resolution minus memoryUsage
+        size_t memorySaved = 0;
+    };
+    Statistics GetStatistics() const;
+
+    HdRprTextureDiskCache::Statistics GetDiskCacheStatistics() const { return m_diskCache.GetStatistics(); }
+
     rpr::Context* GetContext() { return m_context; }
 
 private:
@@ -46,20 +123,86 @@ private:
         ImageMetadata() = default;
         ImageMetadata(std::string const& path);
 
-        bool IsMetadataEqual(ImageMetadata const& md);
+        bool IsMetadataEqual(ImageMetadata const& md) const;
 
-    public:
-        std::weak_ptr<rpr::Image> handle;
+        size_t GetSize() const { return m_size; }
+        double GetModificationTime() const { return m_modificationTime; }
 
     private:
         size_t m_size = 0u;
         double m_modificationTime = 0.0;
     };
 
+    struct LoadRequest {
+        std::string path;
+        std::string cacheKey;
+        bool forceLinearSpace;
+        uint32_t maxResolution;
+        ImageMetadata metadata;
+        std::vector<std::weak_ptr<ImageBinding>> bindings;
+        // Requests referenced by more bindings are decoded first, in order of arrival otherwise
+        size_t order;
+
+        rpr::ImageData data;
+    };
+
+    struct CacheEntry {
+        ImageMetadata metadata;
+        std::shared_ptr<rpr::Image> image;
+        size_t memoryUsage;
+        size_t memorySaved;
+        // Key of the other forceLinearSpace variant that shares the image
+        std::string aliasKey;
+        std::list<std::string>::iterator lruIt;
+    };
+    using CacheIterator = std::unordered_map<std::string, CacheEntry>::iterator;
+
+    static std::string GetCacheKey(std::string const& path, bool forceLinearSpace, uint32_t maxResolution);
+    std::shared_ptr<rpr::Image> FindCachedImage(std::string const& cacheKey, ImageMetadata const& md);
+    // Returns the image that ended up in the cache, it might differ from the passed one if another thread cached the same image first
+    std::shared_ptr<rpr::Image> CacheImage(std::string const& path, bool forceLinearSpace, uint32_t maxResolution, ImageMetadata const& md,
+                                           std::shared_ptr<rpr::Image> const& image, size_t fullResolutionSize);
+
+    // Thread-safe
+    bool LoadImageData(std::string const& path, bool forceLinearSpace, uint32_t maxResolution, ImageMetadata const& md, rpr::ImageData* data);
+    // Falls back to CreateImageFromFile if data is empty
+    std::shared_ptr<rpr::Image> CreateImage(std::string const& path, rpr::ImageData const& data);
+    CacheIterator FindLocked(std::string const& cacheKey);
+    void EraseLocked(CacheIterator it);
+    void EvictLocked(std::string const& keepKey);
+    std::shared_ptr<rpr::Image> GetPlaceholderImage(GfVec3f const& color);
+    void BindLoadedImage(ImageBinding* binding, std::shared_ptr<rpr::Image> const& image);
+    // Binds the image right away if it's available, otherwise queues it for loading.
+    // Returns false if the image is loaded synchronously and loading failed.
+    bool LoadImage(std::shared_ptr<ImageBinding> const& binding, std::string const& path, bool forceLinearSpace);
+
+    void LoadingThreadMain();
+
 private:
     rpr::Context* m_context;
-    std::unordered_map<std::string, ImageMetadata> m_cache;
+    HdRprTextureDiskCache m_diskCache;
+    std::atomic<uint32_t> m_maxResolution{0};
+
+    mutable std::mutex m_cacheMutex;
+    std::unordered_map<std::string, CacheEntry> m_cache;
+    // Maps the key of forceLinearSpace variant to the key of the entry when both variants share the same image
+    std::unordered_map<std::string, std::string> m_cacheAliases;
+    // Front is the most recently used image
+    std::list<std::string> m_lru;
+    Statistics m_stats;
     bool m_garbageCollectionRequired = false;
+
+    std::vector<std::pair<GfVec3f, std::shared_ptr<rpr::Image>>> m_placeholderImages;
+    std::unordered_map<std::string, std::weak_ptr<UdimImage>> m_udimImages;
+
+    mutable std::mutex m_loadMutex;
+    std::condition_variable m_loadCV;
+    std::unordered_map<std::string, std::shared_ptr<LoadRequest>> m_loadRequests;
+    std::vector<std::shared_ptr<LoadRequest>> m_loadQueue;
+    std::vector<std::shared_ptr<LoadRequest>> m_loadedRequests;
+    size_t m_numLoadRequests = 0;
+    bool m_stopLoading = false;
+    std::vector<std::thread> m_loadingThreads;
 };
 
 PXR_NAMESPACE_CLOSE_SCOPE
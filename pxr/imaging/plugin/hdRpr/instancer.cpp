@@ -18,6 +18,9 @@ limitations under the License.
 #include "pxr/base/gf/rotation.h"
 #include "pxr/base/gf/matrix4f.h"
 #include "pxr/imaging/hd/sceneDelegate.h"
+#include "pxr/base/work/loops.h"
+
+#include <vector>
 
 PXR_NAMESPACE_OPEN_SCOPE
 
@@ -145,57 +148,22 @@ void AccumulateSampleTimes(HdTimeSampleArray<T1, C> const& in, HdTimeSampleArray
     }
 }
 
-// Apply transforms referenced by instanceIndices
-template <typename Op, typename T>
-void ApplyTransform(
-    VtValue const& allTransformsValue,
-    VtIntArray const& instanceIndices,
-    GfMatrix4d* transforms) {
-    auto& allTransforms = allTransformsValue.Get<VtArray<T>>();
-    if (allTransforms.empty()) {
-        TF_RUNTIME_ERROR("No transforms");
-        return;
-    }
-
-    for (size_t i = 0; i < instanceIndices.size(); ++i) {
-        transforms[i] = Op{}(allTransforms[instanceIndices[i]]) * transforms[i];
-    }
-}
-
-// Apply interpolated transforms referenced by instanceIndices
-template <typename Op, typename T>
-void ApplyTransform(
-    float alpha,
-    VtValue const& allTransformsValue0,
-    VtValue const& allTransformsValue1,
-    VtIntArray const& instanceIndices,
-    GfMatrix4d* transforms) {
-    auto& allTransforms0 = allTransformsValue0.Get<VtArray<T>>();
-    auto& allTransforms1 = allTransformsValue1.Get<VtArray<T>>();
-    if (allTransforms0.empty() ||
-        allTransforms1.empty()) {
-        TF_RUNTIME_ERROR("No transforms");
-        return;
-    }
-
-    for (size_t i = 0; i < instanceIndices.size(); ++i) {
-        auto transform = HdResampleNeighbors(alpha, allTransforms0[instanceIndices[i]], allTransforms1[instanceIndices[i]]);
-        transforms[i] = Op{}(transform) * transforms[i];
-    }
-}
+/// Instance primvar resampled at a given time and gathered for the instances of a prototype
+template <typename T>
+struct InstancePrimvarSample {
+    std::vector<T> values;
 
-template <typename Op, typename T>
-void ApplyTransform(
-    HdTimeSampleArray<VtValue, 2> const& samples,
-    VtIntArray const& instanceIndices,
-    float time,
-    GfMatrix4d* transforms) {
+    bool IsEmpty() const { return values.empty(); }
+};
 
+// Finds neighbouring samples of the given time. Returns true if the values should be blended with alpha
+bool FindNeighbourSamples(HdTimeSampleArray<VtValue, 2> const& samples, float time, size_t* i0, size_t* i1, float* alpha) {
     size_t i = 0;
     for (; i < samples.count; ++i) {
         if (samples.times[i] == time) {
             // Exact time match
-            return ApplyTransform<Op, T>(samples.values[i], instanceIndices, transforms);
+            *i0 = *i1 = i;
+            return false;
         }
         if (samples.times[i] > time) {
             break;
@@ -204,49 +172,153 @@ void ApplyTransform(
 
     if (i == 0) {
         // time is before the first sample.
-        return ApplyTransform<Op, T>(samples.values[0], instanceIndices, transforms);
+        *i0 = *i1 = 0;
+        return false;
     } else if (i == samples.count) {
         // time is after the last sample.
-        return ApplyTransform<Op, T>(samples.values[samples.count - 1], instanceIndices, transforms);
+        *i0 = *i1 = samples.count - 1;
+        return false;
     } else if (samples.times[i] == samples.times[i - 1]) {
         // Neighboring samples have identical parameter.
         // Arbitrarily choose a sample.
         TF_WARN("overlapping samples at %f; using first sample", samples.times[i]);
-        return ApplyTransform<Op, T>(samples.values[i - 1], instanceIndices, transforms);
+        *i0 = *i1 = i - 1;
+        return false;
     } else {
         // Linear blend of neighboring samples.
-        float alpha = (samples.times[i] - time) / (samples.times[i] - samples.times[i - 1]);
-        return ApplyTransform<Op, T>(alpha, samples.values[i - 1], samples.values[i], instanceIndices, transforms);
+        *i0 = i - 1;
+        *i1 = i;
+        *alpha = (samples.times[i] - time) / (samples.times[i] - samples.times[i - 1]);
+        return true;
     }
 }
 
+// Resamples values referenced by instanceIndices and converts them with Op
+template <typename Op, typename T, typename DstT>
+bool SampleInstancePrimvar(
+    HdTimeSampleArray<VtValue, 2> const& samples,
+    VtIntArray const& instanceIndices,
+    float time,
+    InstancePrimvarSample<DstT>* out) {
+    Op convert;
+    for (size_t i = 0; i < samples.count; ++i) {
+        if (!samples.values[i].IsHolding<VtArray<T>>()) {
+            TF_RUNTIME_ERROR("Inconsistent types of instance primvar samples");
+            return false;
+        }
+    }
+
+    size_t i0, i1;
+    float alpha = 0.0f;
+    bool blend = FindNeighbourSamples(samples, time, &i0, &i1, &alpha);
+
+    auto& values0 = samples.values[i0].UncheckedGet<VtArray<T>>();
+    auto& values1 = samples.values[i1].UncheckedGet<VtArray<T>>();
+    if (values0.empty() || values1.empty()) {
+        TF_RUNTIME_ERROR("No transforms");
+        return false;
+    }
+
+    for (int index : instanceIndices) {
+        if (index < 0 || size_t(index) >= values0.size() || size_t(index) >= values1.size()) {
+            TF_RUNTIME_ERROR("Instance index out of range");
+            return false;
+        }
+    }
+
+    out->values.resize(instanceIndices.size());
+    auto instanceIndicesData = instanceIndices.cdata();
+    auto values0Data = values0.cdata();
+    auto values1Data = values1.cdata();
+    WorkParallelForN(instanceIndices.size(), [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            int index = instanceIndicesData[i];
+            if (blend) {
+                out->values[i] = convert(HdResampleNeighbors(alpha, values0Data[index], values1Data[index]));
+            } else {
+                out->values[i] = convert(values0Data[index]);
+            }
+        }
+    });
+    return true;
+}
+
+/// Builds final instance transforms directly from translate, rotate and scale values
+/// instead of multiplying a separate 4x4 matrix for each operation.
+/// The result is equal to instanceTransform * scale * rotate * translate * instancerTransform.
+void ComposeInstanceTransforms(
+    GfMatrix4d const& instancerTransform,
+    InstancePrimvarSample<GfVec3d> const& translates,
+    InstancePrimvarSample<GfQuatd> const& rotates,
+    InstancePrimvarSample<GfVec3d> const& scales,
+    InstancePrimvarSample<GfMatrix4d> const& instanceTransforms,
+    VtMatrix4dArray* transforms) {
+    const bool applyInstancerTransform = instancerTransform != GfMatrix4d(1);
+    auto transformsData = transforms->data();
+
+    WorkParallelForN(transforms->size(), [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            GfMatrix4d transform(1);
+            if (!rotates.IsEmpty()) {
+                transform.SetRotate(rotates.values[i]);
+            }
+
+            if (!scales.IsEmpty()) {
+                auto& scale = scales.values[i];
+                for (int row = 0; row < 3; ++row) {
+                    for (int column = 0; column < 3; ++column) {
+                        transform[row][column] *= scale[row];
+                    }
+                }
+            }
+
+            if (!translates.IsEmpty()) {
+                auto& translate = translates.values[i];
+                transform[3][0] = translate[0];
+                transform[3][1] = translate[1];
+                transform[3][2] = translate[2];
+            }
+
+            if (!instanceTransforms.IsEmpty()) {
+                transform = instanceTransforms.values[i] * transform;
+            }
+
+            if (applyInstancerTransform) {
+                transform *= instancerTransform;
+            }
+
+            transformsData[i] = transform;
+        }
+    });
+}
+
 struct TranslateOp {
     template <typename T>
-    GfMatrix4d operator()(T const& translate) {
-        return GfMatrix4d(1).SetTranslate(GfVec3d(translate));
+    GfVec3d operator()(T const& translate) const {
+        return GfVec3d(translate);
     }
 };
 
 struct RotateOp {
     template <typename T>
-    GfMatrix4d operator()(T const& rotate) {
-        return GfMatrix4d(1).SetRotate(GfRotation(GfQuatd(rotate)));
+    GfQuatd operator()(T const& rotate) const {
+        return GfQuatd(rotate).GetNormalized();
     }
 };
 
 struct ScaleOp {
     template <typename T>
-    GfMatrix4d operator()(T const& scale) {
-        return GfMatrix4d(1).SetScale(GfVec3d(scale));
+    GfVec3d operator()(T const& scale) const {
+        return GfVec3d(scale);
     }
 };
 
 struct TransformOp {
-    GfMatrix4d const& operator()(GfMatrix4d const& transform) {
+    GfMatrix4d const& operator()(GfMatrix4d const& transform) const {
         return transform;
     }
 
-    GfMatrix4d operator()(GfMatrix4f const& transform) {
+    GfMatrix4d operator()(GfMatrix4f const& transform) const {
         return GfMatrix4d(transform);
     }
 };
@@ -304,50 +376,56 @@ HdTimeSampleArray<VtMatrix4dArray, 2> HdRprInstancer::SampleInstanceTransforms(S
             xf = instancerXform.Resample(t);
         }
 
-        auto& transforms = sa.values[i];
-        transforms = VtMatrix4dArray(instanceIndices.size(), xf);
-
+        // Resample all the primvars first, then compose final transforms in one pass
+        InstancePrimvarSample<GfVec3d> translateSample;
         if (translates.count > 0 && translates.values[0].IsArrayValued()) {
             auto& type = translates.values[0].GetElementTypeid();
             if (type == typeid(GfVec3f)) {
-                ApplyTransform<TranslateOp, GfVec3f>(translates, instanceIndices, t, transforms.data());
+                SampleInstancePrimvar<TranslateOp, GfVec3f>(translates, instanceIndices, t, &translateSample);
             } else if (type == typeid(GfVec3d)) {
-                ApplyTransform<TranslateOp, GfVec3d>(translates, instanceIndices, t, transforms.data());
+                SampleInstancePrimvar<TranslateOp, GfVec3d>(translates, instanceIndices, t, &translateSample);
             } else if (type == typeid(GfVec3h)) {
-                ApplyTransform<TranslateOp, GfVec3h>(translates, instanceIndices, t, transforms.data());
+                SampleInstancePrimvar<TranslateOp, GfVec3h>(translates, instanceIndices, t, &translateSample);
             }
         }
 
+        InstancePrimvarSample<GfQuatd> rotateSample;
         if (rotates.count > 0 && rotates.values[0].IsArrayValued()) {
             auto& type = rotates.values[0].GetElementTypeid();
             if (type == typeid(GfQuath)) {
-                ApplyTransform<RotateOp, GfQuath>(rotates, instanceIndices, t, transforms.data());
+                SampleInstancePrimvar<RotateOp, GfQuath>(rotates, instanceIndices, t, &rotateSample);
             } else if (type == typeid(GfQuatf)) {
-                ApplyTransform<RotateOp, GfQuatf>(rotates, instanceIndices, t, transforms.data());
+                SampleInstancePrimvar<RotateOp, GfQuatf>(rotates, instanceIndices, t, &rotateSample);
             } else if (type == typeid(GfQuatd)) {
-                ApplyTransform<RotateOp, GfQuatd>(rotates, instanceIndices, t, transforms.data());
+                SampleInstancePrimvar<RotateOp, GfQuatd>(rotates, instanceIndices, t, &rotateSample);
             }
         }
 
+        InstancePrimvarSample<GfVec3d> scaleSample;
         if (scales.count > 0 && scales.values[0].IsArrayValued()) {
             auto& type = scales.values[0].GetElementTypeid();
             if (type == typeid(GfVec3f)) {
-                ApplyTransform<ScaleOp, GfVec3f>(scales, instanceIndices, t, transforms.data());
+                SampleInstancePrimvar<ScaleOp, GfVec3f>(scales, instanceIndices, t, &scaleSample);
             } else if (type == typeid(GfVec3d)) {
-                ApplyTransform<ScaleOp, GfVec3d>(scales, instanceIndices, t, transforms.data());
+                SampleInstancePrimvar<ScaleOp, GfVec3d>(scales, instanceIndices, t, &scaleSample);
             } else if (type == typeid(GfVec3h)) {
-                ApplyTransform<ScaleOp, GfVec3h>(scales, instanceIndices, t, transforms.data());
+                SampleInstancePrimvar<ScaleOp, GfVec3h>(scales, instanceIndices, t, &scaleSample);
             }
         }
 
+        InstancePrimvarSample<GfMatrix4d> instanceXformSample;
         if (instanceXforms.count > 0 && instanceXforms.values[0].IsArrayValued()) {
             auto& type = instanceXforms.values[0].GetElementTypeid();
             if (type == typeid(GfMatrix4d)) {
-                ApplyTransform<TransformOp, GfMatrix4d>(instanceXforms, instanceIndices, t, transforms.data());
+                SampleInstancePrimvar<TransformOp, GfMatrix4d>(instanceXforms, instanceIndices, t, &instanceXformSample);
             } else if (type == typeid(GfMatrix4f)) {
-                ApplyTransform<TransformOp, GfMatrix4f>(instanceXforms, instanceIndices, t, transforms.data());
+                SampleInstancePrimvar<TransformOp, GfMatrix4f>(instanceXforms, instanceIndices, t, &instanceXformSample);
             }
         }
+
+        auto& transforms = sa.values[i];
+        transforms = VtMatrix4dArray(instanceIndices.size());
+        ComposeInstanceTransforms(xf, translateSample, rotateSample, scaleSample, instanceXformSample, &transforms);
     }
 
     // If there is a parent instancer, continue to unroll
@@ -380,13 +458,16 @@ HdTimeSampleArray<VtMatrix4dArray, 2> HdRprInstancer::SampleInstanceTransforms(S
         VtMatrix4dArray curChildXf = childXf.Resample(t);
         // Multiply out each combination.
         VtMatrix4dArray &result = sa.values[i];
-        result.resize(curParentXf.size() * curChildXf.size());
-        for (size_t j = 0; j < curParentXf.size(); ++j) {
-            for (size_t k = 0; k < curChildXf.size(); ++k) {
-                result[j * curChildXf.size() + k] =
-                    curChildXf[k] * curParentXf[j];
+        result = VtMatrix4dArray(curParentXf.size() * curChildXf.size());
+        auto resultData = result.data();
+        auto parentData = curParentXf.cdata();
+        auto childData = curChildXf.cdata();
+        const size_t numChildren = curChildXf.size();
+        WorkParallelForN(result.size(), [&](size_t begin, size_t end) {
+            for (size_t j = begin; j < end; ++j) {
+                resultData[j] = childData[j % numChildren] * parentData[j / numChildren];
             }
-        }
+        });
     }
 
     return sa;
@@ -387,19 +387,22 @@ void HdRprLight::Sync(HdSceneDelegate* sceneDelegate,
 
             bool operator()(LightVariantEmpty) const { return false; }
             bool operator()(AreaLight* light) const {
+                // Previous material might still be attached to the meshes, release it after the new one is set
+                HdRprApiMaterial* prevMaterial = nullptr;
                 if (emissionColorIsDirty || !light->material) {
                     MaterialAdapter matAdapter(EMaterialType::EMISSIVE, MaterialParams{{HdLightTokens->color, VtValue(emissionColor)}});
-                    light->material = std::move(rprApi->CreateMaterial(matAdapter));
+                    prevMaterial = light->material;
+                    light->material = rprApi->CreateMaterial(matAdapter);
                 }
 
                 if (light->material) {
                     for (auto& mesh : light->meshes) {
                         rprApi->SetMeshMaterial(mesh, light->material, false, false);
                     }
-                    return true;
                 }
+                rprApi->Release(prevMaterial);
 
-                return false;
+                return light->material != nullptr;
             }
 
             bool operator()(rpr::SpotLight* light) const {
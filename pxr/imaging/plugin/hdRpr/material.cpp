@@ -101,10 +101,13 @@ void HdRprMaterial::Sync(HdSceneDelegate* sceneDelegate,
                     }
                 }
 
+                // Parameter edits (e.g. look-dev tweaks) are applied to the nodes of the current material
                 MaterialAdapter matAdapter(surfaceType, *surface, displacement ? *displacement : HdMaterialNetwork{});
-                m_rprMaterial = rprApi->CreateMaterial(matAdapter);
+                m_rprMaterial = rprApi->UpdateMaterial(m_rprMaterial, matAdapter);
             } else {
                 TF_CODING_WARNING("Material type not supported");
+                rprApi->Release(m_rprMaterial);
+                m_rprMaterial = nullptr;
             }
         }
     }
@@ -16,6 +16,7 @@ limitations under the License.
 #include "pxr/imaging/hd/tokens.h"
 #include "pxr/imaging/hd/material.h"
 
+#include "pxr/base/arch/hash.h"
 #include "pxr/base/gf/vec3f.h"
 #include "pxr/base/gf/vec2f.h"
 #include "pxr/usd/sdf/assetPath.h"
@@ -253,6 +254,21 @@ void GetTextures(const  HdMaterialNetwork& materialNetwork, MaterialTextures& ou
     }
 }
 
+template <typename T>
+uint64_t HashValue(T const& value, uint64_t seed) {
+    return ArchHash64(reinterpret_cast<const char*>(&value), sizeof(T), seed);
+}
+
+uint64_t HashMaterialTexture(MaterialTexture const& texture, uint64_t seed) {
+    uint64_t hash = ArchHash64(texture.path.c_str(), texture.path.size(), seed);
+    hash = HashValue(texture.channel, hash);
+    hash = HashValue(texture.wrapMode, hash);
+    hash = HashValue(texture.scale, hash);
+    hash = HashValue(texture.bias, hash);
+    hash = HashValue(texture.uvTransform, hash);
+    return HashValue(texture.forceLinearSpace, hash);
+}
+
 MaterialAdapter::MaterialAdapter(EMaterialType type, const MaterialParams& params) : m_type(type) {
     switch (type) {
         case EMaterialType::COLOR: {
@@ -326,6 +342,41 @@ MaterialAdapter::MaterialAdapter(EMaterialType type, const HdMaterialNetwork& su
     }
 }
 
+bool MaterialAdapter::operator==(MaterialAdapter const& rhs) const {
+    return m_type == rhs.m_type &&
+        m_doublesided == rhs.m_doublesided &&
+        m_vec4fRprParams == rhs.m_vec4fRprParams &&
+        m_uRprParams == rhs.m_uRprParams &&
+        m_texRpr == rhs.m_texRpr &&
+        m_normalMapParams == rhs.m_normalMapParams &&
+        m_displacementTexture == rhs.m_displacementTexture;
+}
+
+uint64_t MaterialAdapter::GetHash() const {
+    uint64_t hash = HashValue(m_type, 0);
+    hash = HashValue(m_doublesided, hash);
+    for (auto& param : m_vec4fRprParams) {
+        hash = HashValue(param.first, hash);
+        hash = HashValue(param.second, hash);
+    }
+    for (auto& param : m_uRprParams) {
+        hash = HashValue(param.first, hash);
+        hash = HashValue(param.second, hash);
+    }
+    for (auto& param : m_texRpr) {
+        hash = HashValue(param.first, hash);
+        hash = HashMaterialTexture(param.second, hash);
+    }
+    for (auto& param : m_normalMapParams) {
+        for (auto input : param.first) {
+            hash = HashValue(input, hash);
+        }
+        hash = HashMaterialTexture(param.second.texture, hash);
+        hash = HashValue(param.second.effectScale, hash);
+    }
+    return HashMaterialTexture(m_displacementTexture, hash);
+}
+
 void MaterialAdapter::PopulateRprColor(const MaterialParams& params) {
     for (MaterialParams::const_iterator param = params.begin(); param != params.end(); ++param) {
         const TfToken& paramName = param->first;
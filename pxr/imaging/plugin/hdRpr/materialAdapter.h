@@ -90,6 +90,16 @@ struct MaterialTexture {
     GfMatrix3f uvTransform = GfMatrix3f(1.0f);
 
     bool forceLinearSpace = false;
+
+    bool operator==(MaterialTexture const& rhs) const {
+        return path == rhs.path &&
+            channel == rhs.channel &&
+            wrapMode == rhs.wrapMode &&
+            scale == rhs.scale &&
+            bias == rhs.bias &&
+            uvTransform == rhs.uvTransform &&
+            forceLinearSpace == rhs.forceLinearSpace;
+    }
 };
 
 typedef std::map<TfToken, VtValue> MaterialParams;
@@ -102,6 +112,10 @@ typedef std::map<rpr::MaterialNodeInput, MaterialTexture> MaterialRprParamsTextu
 struct NormalMapParam {
     MaterialTexture texture;
     float effectScale = 1.0f;
+
+    bool operator==(NormalMapParam const& rhs) const {
+        return texture == rhs.texture && effectScale == rhs.effectScale;
+    }
 };
 using MaterialRprParamsNormalMap = std::vector<std::pair<std::vector<rpr::MaterialNodeInput>, NormalMapParam>>;
 
@@ -148,6 +162,11 @@ public:
         return m_doublesided;
     }
 
+    /// Materials created from equal adapters have identical node graphs.
+    /// Textures are identified by their path and sampling parameters
+    bool operator==(MaterialAdapter const& rhs) const;
+    uint64_t GetHash() const;
+
 private:
     void PopulateRprColor(const MaterialParams& params);
     void PopulateEmissive(const MaterialParams& params);
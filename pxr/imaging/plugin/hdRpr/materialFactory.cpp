@@ -18,6 +18,8 @@ limitations under the License.
 
 #include <RadeonProRender.hpp>
 
+#include <algorithm>
+
 PXR_NAMESPACE_OPEN_SCOPE
 
 namespace {
@@ -80,6 +82,23 @@ bool GetSelectedChannel(const EColorChannel& colorChannel, rpr_int& out_selected
     return false;
 }
 
+template <typename Map>
+bool HaveSameKeys(Map const& lhs, Map const& rhs) {
+    return lhs.size() == rhs.size() &&
+        std::equal(lhs.begin(), lhs.end(), rhs.begin(),
+            [](typename Map::value_type const& a, typename Map::value_type const& b) { return a.first == b.first; });
+}
+
+// Scale and bias nodes are created only for non-default values, the rest of the texture parameters define the node graph
+bool HaveSameTextureGraph(MaterialTexture const& lhs, MaterialTexture const& rhs) {
+    MaterialTexture lhsGraph = lhs;
+    lhsGraph.scale = rhs.scale;
+    lhsGraph.bias = rhs.bias;
+    return lhsGraph == rhs &&
+        GfIsEqual(lhs.scale, GfVec4f(1.0f)) == GfIsEqual(rhs.scale, GfVec4f(1.0f)) &&
+        GfIsEqual(lhs.bias, GfVec4f(0.0f)) == GfIsEqual(rhs.bias, GfVec4f(0.0f));
+}
+
 } // namespace anonymous
 
 RprMaterialFactory::RprMaterialFactory(ImageCache* imageCache)
@@ -87,10 +106,10 @@ RprMaterialFactory::RprMaterialFactory(ImageCache* imageCache)
 
 }
 
-HdRprApiMaterial* RprMaterialFactory::CreatePointsMaterial(VtVec3fArray const& colors) {
+HdRprApiMaterial* RprMaterialFactory::CreatePointsMaterial(VtVec3fArray const& colors, bool indexByUV) {
     auto context = m_imageCache->GetContext();
 
-    auto setupPointsMaterial = [&colors, context](HdRprApiMaterial* material) -> bool {
+    auto setupPointsMaterial = [&colors, indexByUV, context](HdRprApiMaterial* material) -> bool {
         rpr::Status status;
         auto rootMaterialNode = context->CreateMaterialNode(RPR_MATERIAL_NODE_UBERV2, &status);
         if (!rootMaterialNode) {
@@ -114,7 +133,7 @@ HdRprApiMaterial* RprMaterialFactory::CreatePointsMaterial(VtVec3fArray const& c
             return !RPR_ERROR_CHECK(status, "Failed to create input lookup node");
         }
         material->auxiliaryObjects.push_back(lookupIndex);
-        if (RPR_ERROR_CHECK(lookupIndex->SetInput(RPR_MATERIAL_INPUT_VALUE, RPR_MATERIAL_NODE_LOOKUP_OBJECT_ID), "Failed to set lookup node input value")) {
+        if (RPR_ERROR_CHECK(lookupIndex->SetInput(RPR_MATERIAL_INPUT_VALUE, indexByUV ? RPR_MATERIAL_NODE_LOOKUP_UV : RPR_MATERIAL_NODE_LOOKUP_OBJECT_ID), "Failed to set lookup node input value")) {
             return false;
         }
 
@@ -199,21 +218,22 @@ HdRprApiMaterial* RprMaterialFactory::CreateMaterial(EMaterialType type, const M
         RPR_ERROR_CHECK(material->rootMaterial->SetInput(paramId, paramValue), "Failed to set material node uint input");
     }
 
-    auto getTextureMaterialNode = [&material](ImageCache* imageCache, MaterialTexture const& matTex) -> rpr::MaterialNode* {
+    // Unless loadSynchronously is set, texture nodes might sample a placeholder of placeholderColor until their image is loaded
+    // Scale and bias nodes are recorded to out_arithmeticNodes when it's not null
+    auto getTextureMaterialNode = [&material](ImageCache* imageCache, MaterialTexture const& matTex, GfVec3f const& placeholderColor, bool loadSynchronously,
+                                              HdRprApiMaterial::TextureArithmeticNodes* out_arithmeticNodes) -> rpr::MaterialNode* {
         if (matTex.path.empty()) {
             return nullptr;
         }
 
-        auto image = imageCache->GetImage(matTex.path, matTex.forceLinearSpace);
-        if (!image) {
-            return nullptr;
-        }
-        auto rprImage = image.get();
-        material->materialImages.push_back(std::move(image));
-
-        rpr::ImageWrapType rprWrapType;
-        if (GetWrapType(matTex.wrapMode, rprWrapType)) {
-            RPR_ERROR_CHECK(rprImage->SetWrap(rprWrapType), "Failed to set image wrap mode");
+        // Keep the image alive until it's bound so that BindImage finds it in the cache
+        std::shared_ptr<rpr::Image> loadedImage;
+        bool isUdim = ImageCache::IsUdimPath(matTex.path);
+        if (loadSynchronously && !isUdim) {
+            loadedImage = imageCache->GetImage(matTex.path, matTex.forceLinearSpace);
+            if (!loadedImage) {
+                return nullptr;
+            }
         }
 
         rpr::Status status;
@@ -225,7 +245,35 @@ HdRprApiMaterial* RprMaterialFactory::CreateMaterial(EMaterialType type, const M
             return nullptr;
         }
 
-        RPR_ERROR_CHECK(materialNode->SetInput(RPR_MATERIAL_INPUT_DATA, rprImage), "Failed to set material node image data input");
+        rpr::ImageWrapType rprWrapType;
+        bool hasWrapType = GetWrapType(matTex.wrapMode, rprWrapType);
+
+        if (isUdim) {
+            auto udimImage = imageCache->GetUdimImage(matTex.path, matTex.forceLinearSpace);
+            if (!udimImage) {
+                delete materialNode;
+                return nullptr;
+            }
+
+            if (hasWrapType) {
+                RPR_ERROR_CHECK(udimImage->image->SetWrap(rprWrapType), "Failed to set image wrap mode");
+            }
+            RPR_ERROR_CHECK(materialNode->SetInput(RPR_MATERIAL_INPUT_DATA, udimImage->image.get()), "Failed to set material node image data input");
+
+            // Meshes request only the tiles covered by their uvs (see HdRprApi::RequireUdimTiles).
+            // We can't tell which tiles are used when uvs are transformed, so all of them are loaded
+            if (loadSynchronously || !GfIsEqual(matTex.uvTransform, GfMatrix3f(1.0f))) {
+                imageCache->RequireUdimTiles(udimImage.get(), udimImage->availableTiles);
+            }
+            material->udimImages.push_back(std::move(udimImage));
+        } else {
+            auto imageBinding = imageCache->BindImage(materialNode, matTex.path, matTex.forceLinearSpace, hasWrapType ? &rprWrapType : nullptr, placeholderColor);
+            if (!imageBinding) {
+                delete materialNode;
+                return nullptr;
+            }
+            material->imageBindings.push_back(std::move(imageBinding));
+        }
         material->auxiliaryObjects.push_back(materialNode);
 
         if (!GfIsEqual(matTex.uvTransform, GfMatrix3f(1.0f))) {
@@ -275,6 +323,9 @@ HdRprApiMaterial* RprMaterialFactory::CreateMaterial(EMaterialType type, const M
                 RPR_ERROR_CHECK(arithmetic->SetInput(RPR_MATERIAL_INPUT_COLOR0, materialNode), "Failed to set material node node input");
                 RPR_ERROR_CHECK(arithmetic->SetInput(RPR_MATERIAL_INPUT_COLOR1, matTex.scale[0], matTex.scale[1], matTex.scale[2], matTex.scale[3]), "Failed to set material node vec4 input");
                 material->auxiliaryObjects.push_back(arithmetic);
+                if (out_arithmeticNodes) {
+                    out_arithmeticNodes->scale = arithmetic;
+                }
 
                 materialNode = arithmetic;
             } else {
@@ -289,6 +340,9 @@ HdRprApiMaterial* RprMaterialFactory::CreateMaterial(EMaterialType type, const M
                 RPR_ERROR_CHECK(arithmetic->SetInput(RPR_MATERIAL_INPUT_COLOR0, materialNode), "Failed to set material node node input");
                 RPR_ERROR_CHECK(arithmetic->SetInput(RPR_MATERIAL_INPUT_COLOR1, matTex.bias[0], matTex.bias[1], matTex.bias[2], matTex.bias[3]), "Failed to set material node vec4 input");
                 material->auxiliaryObjects.push_back(arithmetic);
+                if (out_arithmeticNodes) {
+                    out_arithmeticNodes->bias = arithmetic;
+                }
 
                 materialNode = arithmetic;
             } else {
@@ -341,7 +395,7 @@ HdRprApiMaterial* RprMaterialFactory::CreateMaterial(EMaterialType type, const M
         auto& paramId = texParam.first;
         auto& matTex = texParam.second;
 
-        auto outNode = getTextureMaterialNode(m_imageCache, matTex);
+        auto outNode = getTextureMaterialNode(m_imageCache, matTex, GfVec3f(0.5f), false, &material->textureArithmeticNodes[paramId]);
         if (!outNode) {
             continue;
         }
@@ -354,7 +408,8 @@ HdRprApiMaterial* RprMaterialFactory::CreateMaterial(EMaterialType type, const M
     }
 
     for (auto const& normalMapParam : materialAdapter.GetNormalMapParams()) {
-        auto textureNode = getTextureMaterialNode(m_imageCache, normalMapParam.second.texture);
+        // Flat tangent space normal
+        auto textureNode = getTextureMaterialNode(m_imageCache, normalMapParam.second.texture, GfVec3f(0.5f, 0.5f, 1.0f), false, nullptr);
         if (!textureNode) {
             continue;
         }
@@ -400,19 +455,85 @@ HdRprApiMaterial* RprMaterialFactory::CreateMaterial(EMaterialType type, const M
         }
     }
 
-    material->displacementMaterial = getTextureMaterialNode(m_imageCache, materialAdapter.GetDisplacementTexture());
+    // Displacement changes the geometry, swapping its texture later would cause a costly re-tessellation
+    material->displacementMaterial = getTextureMaterialNode(m_imageCache, materialAdapter.GetDisplacementTexture(), GfVec3f(0.0f), true, nullptr);
 
     return material;
 }
 
+bool RprMaterialFactory::UpdateMaterial(HdRprApiMaterial* material, MaterialAdapter const& prevMaterialAdapter, MaterialAdapter const& materialAdapter) {
+    if (!material) {
+        return false;
+    }
+
+    auto& prevTextures = prevMaterialAdapter.GetTexRprParams();
+    auto& textures = materialAdapter.GetTexRprParams();
+    if (prevMaterialAdapter.GetType() != materialAdapter.GetType() ||
+        prevMaterialAdapter.IsDoublesided() != materialAdapter.IsDoublesided() ||
+        !HaveSameKeys(prevMaterialAdapter.GetVec4fRprParams(), materialAdapter.GetVec4fRprParams()) ||
+        !HaveSameKeys(prevMaterialAdapter.GetURprParams(), materialAdapter.GetURprParams()) ||
+        !HaveSameKeys(prevTextures, textures) ||
+        !std::equal(prevTextures.begin(), prevTextures.end(), textures.begin(),
+            [](MaterialRprParamsTexture::value_type const& lhs, MaterialRprParamsTexture::value_type const& rhs) {
+                return HaveSameTextureGraph(lhs.second, rhs.second);
+            }) ||
+        !(prevMaterialAdapter.GetNormalMapParams() == materialAdapter.GetNormalMapParams()) ||
+        !(prevMaterialAdapter.GetDisplacementTexture() == materialAdapter.GetDisplacementTexture())) {
+        return false;
+    }
+
+    auto prevVec4fParamIt = prevMaterialAdapter.GetVec4fRprParams().begin();
+    for (auto const& param : materialAdapter.GetVec4fRprParams()) {
+        auto& paramId = param.first;
+        auto& paramValue = param.second;
+        auto& prevParamValue = (prevVec4fParamIt++)->second;
+
+        if (paramValue == prevParamValue || textures.count(paramId)) {
+            continue;
+        }
+        RPR_ERROR_CHECK(material->rootMaterial->SetInput(paramId, paramValue[0], paramValue[1], paramValue[2], paramValue[3]), "Failed to set material node vec4 input");
+    }
+
+    auto prevUParamIt = prevMaterialAdapter.GetURprParams().begin();
+    for (auto const& param : materialAdapter.GetURprParams()) {
+        if (param.second != (prevUParamIt++)->second) {
+            RPR_ERROR_CHECK(material->rootMaterial->SetInput(param.first, param.second), "Failed to set material node uint input");
+        }
+    }
+
+    auto prevTextureIt = prevTextures.begin();
+    for (auto const& texParam : textures) {
+        auto& matTex = texParam.second;
+        auto& prevMatTex = (prevTextureIt++)->second;
+
+        auto nodesIt = material->textureArithmeticNodes.find(texParam.first);
+        if (nodesIt == material->textureArithmeticNodes.end()) {
+            continue;
+        }
+
+        auto& nodes = nodesIt->second;
+        if (nodes.scale && matTex.scale != prevMatTex.scale) {
+            RPR_ERROR_CHECK(nodes.scale->SetInput(RPR_MATERIAL_INPUT_COLOR1, matTex.scale[0], matTex.scale[1], matTex.scale[2], matTex.scale[3]), "Failed to set material node vec4 input");
+        }
+        if (nodes.bias && matTex.bias != prevMatTex.bias) {
+            RPR_ERROR_CHECK(nodes.bias->SetInput(RPR_MATERIAL_INPUT_COLOR1, matTex.bias[0], matTex.bias[1], matTex.bias[2], matTex.bias[3]), "Failed to set material node vec4 input");
+        }
+    }
+
+    return true;
+}
+
 void RprMaterialFactory::Release(HdRprApiMaterial* material) {
     if (!material) {
         return;
     }
 
-    if (!material->materialImages.empty()) {
+    if (!material->imageBindings.empty() || !material->udimImages.empty()) {
         m_imageCache->RequireGarbageCollection();
     }
+    // Make sure that the image cache does not bind loaded images to the nodes we are going to release
+    material->imageBindings.clear();
+    material->udimImages.clear();
 
     delete material->rootMaterial;
     delete material->twosidedNode;
@@ -422,6 +543,23 @@ void RprMaterialFactory::Release(HdRprApiMaterial* material) {
     delete material;
 }
 
+bool RprMaterialFactory::RequireUdimTiles(HdRprApiMaterial const* material, std::vector<uint32_t> const& tiles) {
+    bool isChanged = false;
+    for (auto& udimImage : material->udimImages) {
+        isChanged |= m_imageCache->RequireUdimTiles(udimImage.get(), tiles);
+    }
+    return isChanged;
+}
+
+bool RprMaterialFactory::HasMissingUdimTiles(HdRprApiMaterial const* material, std::vector<uint32_t> const& tiles) const {
+    for (auto& udimImage : material->udimImages) {
+        if (m_imageCache->HasMissingUdimTiles(udimImage.get(), tiles)) {
+            return true;
+        }
+    }
+    return false;
+}
+
 void RprMaterialFactory::AttachMaterial(rpr::Shape* mesh, HdRprApiMaterial const* material, bool doublesided, bool displacementEnabled) {
     if (material) {
         if (material->twosidedNode) {
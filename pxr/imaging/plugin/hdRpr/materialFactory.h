@@ -16,7 +16,9 @@ limitations under the License.
 
 #include "pxr/pxr.h"
 #include "materialAdapter.h"
+#include "imageCache.h"
 
+#include <map>
 #include <vector>
 
 namespace rpr { class MaterialNode; class Image; class Shape; class Curve; }
@@ -28,19 +30,33 @@ struct HdRprApiMaterial {
     rpr::MaterialNode* twosidedNode = nullptr;
     rpr::MaterialNode* displacementMaterial = nullptr;
     std::vector<rpr::ContextObject*> auxiliaryObjects;
-    std::vector<std::shared_ptr<rpr::Image>> materialImages;
-};
+    std::vector<std::shared_ptr<ImageCache::ImageBinding>> imageBindings;
+    std::vector<std::shared_ptr<ImageCache::UdimImage>> udimImages;
 
-class ImageCache;
+    // Arithmetic nodes that apply scale and bias to the textures bound to the inputs of the root material
+    struct TextureArithmeticNodes {
+        rpr::MaterialNode* scale = nullptr;
+        rpr::MaterialNode* bias = nullptr;
+    };
+    std::map<rpr::MaterialNodeInput, TextureArithmeticNodes> textureArithmeticNodes;
+};
 
 class RprMaterialFactory {
 public:
     RprMaterialFactory(ImageCache* imageCache);
 
     HdRprApiMaterial* CreateMaterial(EMaterialType type, MaterialAdapter const& materialAdapter);
-    HdRprApiMaterial* CreatePointsMaterial(VtVec3fArray const& colors);
+    // Sets the parameters that differ between the adapters on the existing nodes of the material created from prevMaterialAdapter.
+    // Returns false without modifying the material if the adapters require different node graphs
+    bool UpdateMaterial(HdRprApiMaterial* material, MaterialAdapter const& prevMaterialAdapter, MaterialAdapter const& materialAdapter);
+    // Colors are looked up by the object id of the shape or, if indexByUV is set, by the first uv coordinate
+    HdRprApiMaterial* CreatePointsMaterial(VtVec3fArray const& colors, bool indexByUV = false);
     void Release(HdRprApiMaterial* material);
 
+    // Loads UDIM tiles of the material's textures that are not loaded yet. Returns true if any tile was bound
+    bool RequireUdimTiles(HdRprApiMaterial const* material, std::vector<uint32_t> const& tiles);
+    bool HasMissingUdimTiles(HdRprApiMaterial const* material, std::vector<uint32_t> const& tiles) const;
+
     void AttachMaterial(rpr::Shape* mesh, HdRprApiMaterial const* material, bool doublesided, bool displacementEnabled);
     void AttachMaterial(rpr::Curve* mesh, HdRprApiMaterial const* material);
 
@@ -24,16 +24,242 @@ limitations under the License.
 
 #include "pxr/imaging/hd/meshUtil.h"
 #include "pxr/imaging/hd/sprim.h"
-#include "pxr/imaging/hd/smoothNormals.h"
 #include "pxr/imaging/hd/extComputationUtils.h"
 
 #include "pxr/base/gf/matrix4f.h"
+#include "pxr/base/gf/range2f.h"
 #include "pxr/base/gf/vec4f.h"
+#include "pxr/base/work/loops.h"
 
 #include "pxr/usd/usdUtils/pipeline.h"
 
+#include <algorithm>
+#include <cmath>
+
 PXR_NAMESPACE_OPEN_SCOPE
 
+namespace {
+
+template <typename T>
+VtArray<T> GatherValues(VtArray<T> const& values, VtIntArray const& indices) {
+    VtArray<T> result(indices.size());
+    WorkParallelForN(indices.size(), [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            result[i] = values[indices[i]];
+        }
+    });
+    return result;
+}
+
+/// Returns sorted list of UDIM tiles that faces cover with their uvs.
+/// Tile of uv is 1001 + floor(u) + 10 * floor(v), uvs outside of [0, 10) x [0, 100) do not map to any tile.
+/// Tiles are taken from uv bounds of each face, so a face that touches the upper edge of its tile does not require the next tile.
+std::vector<uint32_t> GetUdimTiles(VtVec2fArray const& uvs, VtIntArray const& uvIndices,
+                                   VtIntArray const& faceVertexIndices, VtIntArray const& faceVertexCounts) {
+    if (uvs.empty()) {
+        // Meshes without uvs sample the first tile
+        return {1001};
+    }
+
+    // Uvs without indices are indexed the same way as points
+    auto& indices = uvIndices.empty() ? faceVertexIndices : uvIndices;
+
+    std::vector<uint8_t> isTileUsed(1000, 0);
+    size_t faceVertexOffset = 0;
+    for (auto numFaceVertices : faceVertexCounts) {
+        if (numFaceVertices <= 0 ||
+            faceVertexOffset + numFaceVertices > indices.size()) {
+            faceVertexOffset += std::max(numFaceVertices, 0);
+            continue;
+        }
+
+        GfRange2f bounds;
+        for (int i = 0; i < numFaceVertices; ++i) {
+            auto index = indices[faceVertexOffset + i];
+            if (index >= 0 && size_t(index) < uvs.size()) {
+                bounds.UnionWith(uvs[index]);
+            }
+        }
+        faceVertexOffset += numFaceVertices;
+        if (bounds.IsEmpty()) {
+            continue;
+        }
+
+        auto& min = bounds.GetMin();
+        auto& max = bounds.GetMax();
+        int uBegin = std::max(int(std::floor(min[0])), 0);
+        int vBegin = std::max(int(std::floor(min[1])), 0);
+        int uEnd = std::min(std::max(int(std::ceil(max[0])), int(std::floor(min[0])) + 1), 10);
+        int vEnd = std::min(std::max(int(std::ceil(max[1])), int(std::floor(min[1])) + 1), 100);
+        for (int v = vBegin; v < vEnd; ++v) {
+            for (int u = uBegin; u < uEnd; ++u) {
+                isTileUsed[u + 10 * v] = 1;
+            }
+        }
+    }
+
+    std::vector<uint32_t> tiles;
+    for (uint32_t i = 0; i < isTileUsed.size(); ++i) {
+        if (isTileUsed[i]) {
+            tiles.push_back(1001 + i);
+        }
+    }
+    return tiles;
+}
+
+/// Remaps indices to the compact range of the values they reference.
+/// out_sourceIndices receives the original index of each referenced value.
+bool CompactIndices(VtIntArray* indices, size_t numValues, VtIntArray* out_sourceIndices) {
+    std::vector<int> sourceIndices(indices->cbegin(), indices->cend());
+    std::sort(sourceIndices.begin(), sourceIndices.end());
+    sourceIndices.erase(std::unique(sourceIndices.begin(), sourceIndices.end()), sourceIndices.end());
+    if (!sourceIndices.empty() &&
+        (sourceIndices.front() < 0 || size_t(sourceIndices.back()) >= numValues)) {
+        return false;
+    }
+
+    for (auto& index : *indices) {
+        index = static_cast<int>(std::lower_bound(sourceIndices.begin(), sourceIndices.end(), index) - sourceIndices.begin());
+    }
+
+    *out_sourceIndices = VtIntArray(sourceIndices.size());
+    std::copy(sourceIndices.begin(), sourceIndices.end(), out_sourceIndices->data());
+    return true;
+}
+
+/// Returns true if both topologies produce the same geom subset meshes, i.e. they may differ only in materials of geom subsets
+bool IsSameMeshSplit(HdMeshTopology const& lhs, HdMeshTopology const& rhs) {
+    if (lhs.GetScheme() != rhs.GetScheme() ||
+        lhs.GetOrientation() != rhs.GetOrientation() ||
+        lhs.GetFaceVertexCounts() != rhs.GetFaceVertexCounts() ||
+        lhs.GetFaceVertexIndices() != rhs.GetFaceVertexIndices() ||
+        lhs.GetHoleIndices() != rhs.GetHoleIndices()) {
+        return false;
+    }
+
+    auto& lhsSubsets = lhs.GetGeomSubsets();
+    auto& rhsSubsets = rhs.GetGeomSubsets();
+    if (lhsSubsets.size() != rhsSubsets.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < lhsSubsets.size(); ++i) {
+        if (lhsSubsets[i].type != rhsSubsets[i].type ||
+            lhsSubsets[i].id != rhsSubsets[i].id ||
+            lhsSubsets[i].indices != rhsSubsets[i].indices) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/// Geometry of the faces of a geom subset compacted to the vertices they reference
+struct GeomSubsetMeshData {
+    VtIntArray pointIndices;
+    VtVec3fArray points;
+    VtIntArray indices;
+    VtIntArray vertexPerFace;
+    VtVec3fArray normals;
+    VtIntArray normalIndices;
+    VtVec2fArray uvs;
+    VtIntArray uvIndices;
+    bool isValid = false;
+};
+
+template <typename T>
+bool SplitGeomSubsetPrimvar(VtArray<T> const& values, VtIntArray const& indices,
+                            VtIntArray* subsetIndices, GeomSubsetMeshData const& subsetMesh,
+                            VtArray<T>* out_values) {
+    if (values.empty()) {
+        return true;
+    }
+
+    if (!subsetIndices->empty()) {
+        // Face-varying primvar has its own indices that are compacted the same way as point indices
+        VtIntArray sourceIndices;
+        if (!CompactIndices(subsetIndices, values.size(), &sourceIndices)) {
+            return false;
+        }
+        *out_values = GatherValues(values, sourceIndices);
+    } else if (indices.empty()) {
+        // Vertex primvar shares indices with points
+        if (subsetMesh.pointIndices.empty() || size_t(subsetMesh.pointIndices.back()) < values.size()) {
+            *out_values = GatherValues(values, subsetMesh.pointIndices);
+        }
+    }
+    return true;
+}
+
+GeomSubsetMeshData SplitGeomSubset(HdGeomSubset const& subset, std::vector<int> const& faceOffsets,
+                                   VtIntArray const& faceVertexCounts, VtIntArray const& faceVertexIndices,
+                                   VtVec3fArray const& points,
+                                   VtVec3fArray const& normals, VtIntArray const& normalIndices,
+                                   VtVec2fArray const& uvs, VtIntArray const& uvIndices) {
+    GeomSubsetMeshData subsetMesh;
+
+    const size_t numFaces = faceVertexCounts.size();
+    size_t numSubsetFaces = 0;
+    size_t numSubsetFaceVertices = 0;
+    for (int faceIndex : subset.indices) {
+        if (faceIndex >= 0 && size_t(faceIndex) < numFaces && faceVertexCounts[faceIndex] > 0) {
+            numSubsetFaces++;
+            numSubsetFaceVertices += faceVertexCounts[faceIndex];
+        }
+    }
+
+    const bool hasNormalIndices = !normals.empty() && normalIndices.size() == faceVertexIndices.size();
+    const bool hasUvIndices = !uvs.empty() && uvIndices.size() == faceVertexIndices.size();
+
+    subsetMesh.vertexPerFace = VtIntArray(numSubsetFaces);
+    subsetMesh.indices = VtIntArray(numSubsetFaceVertices);
+    if (hasNormalIndices) {
+        subsetMesh.normalIndices = VtIntArray(numSubsetFaceVertices);
+    }
+    if (hasUvIndices) {
+        subsetMesh.uvIndices = VtIntArray(numSubsetFaceVertices);
+    }
+
+    auto vertexPerFaceData = subsetMesh.vertexPerFace.data();
+    auto indicesData = subsetMesh.indices.data();
+    auto normalIndicesData = hasNormalIndices ? subsetMesh.normalIndices.data() : nullptr;
+    auto uvIndicesData = hasUvIndices ? subsetMesh.uvIndices.data() : nullptr;
+
+    size_t subsetFace = 0;
+    size_t subsetOffset = 0;
+    for (int faceIndex : subset.indices) {
+        if (faceIndex < 0 || size_t(faceIndex) >= numFaces || faceVertexCounts[faceIndex] <= 0) {
+            continue;
+        }
+
+        const int numVertices = faceVertexCounts[faceIndex];
+        const int offset = faceOffsets[faceIndex];
+        vertexPerFaceData[subsetFace++] = numVertices;
+
+        std::copy_n(faceVertexIndices.cdata() + offset, numVertices, indicesData + subsetOffset);
+        if (normalIndicesData) {
+            std::copy_n(normalIndices.cdata() + offset, numVertices, normalIndicesData + subsetOffset);
+        }
+        if (uvIndicesData) {
+            std::copy_n(uvIndices.cdata() + offset, numVertices, uvIndicesData + subsetOffset);
+        }
+        subsetOffset += numVertices;
+    }
+
+    if (!CompactIndices(&subsetMesh.indices, points.size(), &subsetMesh.pointIndices)) {
+        return subsetMesh;
+    }
+    subsetMesh.points = GatherValues(points, subsetMesh.pointIndices);
+
+    if (!SplitGeomSubsetPrimvar(normals, normalIndices, &subsetMesh.normalIndices, subsetMesh, &subsetMesh.normals) ||
+        !SplitGeomSubsetPrimvar(uvs, uvIndices, &subsetMesh.uvIndices, subsetMesh, &subsetMesh.uvs)) {
+        return subsetMesh;
+    }
+
+    subsetMesh.isValid = true;
+    return subsetMesh;
+}
+
+} // namespace anonymous
+
 HdRprMesh::HdRprMesh(SdfPath const& id, SdfPath const& instancerId)
     : HdMesh(id, instancerId)
     , m_visibilityMask(kVisibleAll) {
@@ -157,6 +383,12 @@ void HdRprMesh::Sync(HdSceneDelegate* sceneDelegate,
     // 1. Pull scene data.
 
     bool newMesh = false;
+    bool updatePoints = false;
+    bool updateNormals = false;
+    bool dirtyUdimTiles = false;
+    const VtVec3fArray prevPoints = m_points;
+    // Smooth normals of the previous points can be updated incrementally
+    const bool prevSmoothNormalsValid = m_normalsValid && !m_authoredNormals && m_smoothNormals && m_normals.size() == m_points.size();
 
     bool pointsIsComputed = false;
     auto extComputationDescs = sceneDelegate->GetExtComputationPrimvarDescriptors(id, HdInterpolationVertex);
@@ -173,7 +405,7 @@ void HdRprMesh::Sync(HdSceneDelegate* sceneDelegate,
                 m_normalsValid = false;
                 pointsIsComputed = true;
 
-                newMesh = true;
+                updatePoints = true;
             }
         }
 
@@ -186,20 +418,37 @@ void HdRprMesh::Sync(HdSceneDelegate* sceneDelegate,
         m_points = pointsValue.Get<VtVec3fArray>();
         m_normalsValid = false;
 
-        newMesh = true;
+        updatePoints = true;
     }
 
+    bool isGeomSubsetMaterialDirty = false;
     if (HdChangeTracker::IsTopologyDirty(*dirtyBits, id)) {
-        m_topology = GetMeshTopology(sceneDelegate);
-        m_faceVertexCounts = m_topology.GetFaceVertexCounts();
-        m_faceVertexIndices = m_topology.GetFaceVertexIndices();
+        auto topology = GetMeshTopology(sceneDelegate);
+        if (!m_rprMeshes.empty() && !m_geomSubsets.empty() && IsSameMeshSplit(topology, m_topology)) {
+            // Only materials of geom subsets have changed, there is no need to split the mesh again
+            for (auto& subset : m_geomSubsets) {
+                for (auto const& newSubset : topology.GetGeomSubsets()) {
+                    if (newSubset.id == subset.id) {
+                        subset.materialId = newSubset.materialId;
+                        break;
+                    }
+                }
+            }
+            m_topology = topology;
+            isGeomSubsetMaterialDirty = true;
+        } else {
+            m_topology = topology;
+            m_faceVertexCounts = m_topology.GetFaceVertexCounts();
+            m_faceVertexIndices = m_topology.GetFaceVertexIndices();
 
-        m_adjacencyValid = false;
-        m_normalsValid = false;
+            m_adjacencyValid = false;
+            m_normalsValid = false;
+            dirtyUdimTiles = true;
 
-        m_enableSubdiv = m_topology.GetScheme() == PxOsdOpenSubdivTokens->catmullClark;
+            m_enableSubdiv = m_topology.GetScheme() == PxOsdOpenSubdivTokens->catmullClark;
 
-        newMesh = true;
+            newMesh = true;
+        }
     }
 
     std::map<HdInterpolation, HdPrimvarDescriptorVector> primvarDescsPerInterpolation = {
@@ -209,18 +458,30 @@ void HdRprMesh::Sync(HdSceneDelegate* sceneDelegate,
     };
 
     if (HdChangeTracker::IsPrimvarDirty(*dirtyBits, id, HdTokens->normals)) {
+        const size_t prevNumNormals = m_normals.size();
+        const VtIntArray prevNormalIndices = m_normalIndices;
         m_authoredNormals = GetPrimvarData(HdTokens->normals, sceneDelegate, primvarDescsPerInterpolation, m_normals, m_normalIndices);
 
-        newMesh = true;
+        // Normals can be updated in place only when their layout is preserved
+        if (m_normals.size() == prevNumNormals && m_normalIndices == prevNormalIndices) {
+            updateNormals = true;
+        } else {
+            newMesh = true;
+        }
     }
 
     auto stToken = UsdUtilsGetPrimaryUVSetName();
     if (HdChangeTracker::IsPrimvarDirty(*dirtyBits, id, stToken)) {
         GetPrimvarData(stToken, sceneDelegate, primvarDescsPerInterpolation, m_uvs, m_uvIndices);
+        dirtyUdimTiles = true;
 
         newMesh = true;
     }
 
+    if (dirtyUdimTiles) {
+        m_udimTiles = GetUdimTiles(m_uvs, m_uvIndices, m_faceVertexIndices, m_faceVertexCounts);
+    }
+
     if (*dirtyBits & HdChangeTracker::DirtyMaterialId) {
         m_cachedMaterialId = sceneDelegate->GetMaterialId(id);
     }
@@ -267,18 +528,76 @@ void HdRprMesh::Sync(HdSceneDelegate* sceneDelegate,
     m_smoothNormals = m_smoothNormals && !(m_enableSubdiv && m_refineLevel > 0);
 
     if (!m_authoredNormals && m_smoothNormals) {
-        if (!m_adjacencyValid) {
-            m_adjacency.BuildAdjacencyTable(&m_topology);
+        bool adjacencyRebuilt = false;
+        if (!m_adjacencyValid || m_adjacency.GetNumPoints() != m_points.size()) {
+            m_adjacency.Build(m_faceVertexCounts, m_faceVertexIndices, m_topology.GetOrientation(), m_points.size());
             m_adjacencyValid = true;
             m_normalsValid = false;
+            adjacencyRebuilt = true;
         }
 
         if (!m_normalsValid) {
-            m_normals = Hd_SmoothNormals::ComputeSmoothNormals(&m_adjacency, m_points.size(), m_points.cdata());
+            if (prevSmoothNormalsValid && !adjacencyRebuilt) {
+                m_adjacency.UpdateSmoothNormals(prevPoints, m_points, &m_normals);
+            } else {
+                m_adjacency.ComputeSmoothNormals(m_points, &m_normals);
+            }
             m_normalsValid = true;
 
-            newMesh = true;
+            updateNormals = true;
+        }
+    }
+
+    // The mesh is considered deforming until it's synced without points change
+    m_isDeforming = updatePoints && !m_rprMeshes.empty();
+
+    // Refined meshes can't share geometry with other meshes because subdivision is applied to the geometry itself.
+    // Deforming meshes are not shared to be able to update their points in place.
+    bool allowGeometrySharing = !(m_enableSubdiv && m_refineLevel > 0) && !m_isDeforming;
+    if (m_allowGeometrySharing && !allowGeometrySharing) {
+        // Meshes that might be shared have to be recreated to stop sharing. Meshes that may be shared again
+        // are not recreated just for that, the sharing takes effect the next time the mesh is created
+        newMesh = true;
+    }
+
+    ////////////////////////////////////////////////////////////////////////
+    // 3. Update vertices of RPR meshes
+
+    if (!newMesh && (updatePoints || updateNormals)) {
+        // Topology is unchanged: replace vertex data of existing meshes keeping their state, subsets and instances
+        bool updated = !m_rprMeshes.empty() && m_points.size() == prevPoints.size() &&
+            (m_geomSubsets.empty() || (m_geomSubsetPointIndices.size() == m_rprMeshes.size() && (!updateNormals || m_normalIndices.empty())));
+
+        for (size_t i = 0; i < m_rprMeshes.size() && updated; ++i) {
+            VtVec3fArray points;
+            VtVec3fArray normals;
+            if (m_geomSubsets.empty()) {
+                points = m_points;
+                if (updateNormals) {
+                    normals = m_normals;
+                }
+            } else {
+                auto const& pointIndices = m_geomSubsetPointIndices[i];
+                points = GatherValues(m_points, pointIndices);
+                if (updateNormals && !m_normals.empty()) {
+                    // Only per-vertex normals share indices with points, split the mesh again otherwise
+                    if (m_normals.size() != m_points.size()) {
+                        updated = false;
+                        break;
+                    }
+                    normals = GatherValues(m_normals, pointIndices);
+                }
+            }
+
+            auto instances = i < m_rprMeshInstances.size() ? &m_rprMeshInstances[i] : nullptr;
+            if (auto rprMesh = rprApi->UpdateMeshPoints(m_rprMeshes[i], points, normals, instances)) {
+                m_rprMeshes[i] = rprMesh;
+            } else {
+                updated = false;
+            }
         }
+
+        newMesh = !updated;
     }
 
     bool updateTransform = newMesh;
@@ -288,9 +607,11 @@ void HdRprMesh::Sync(HdSceneDelegate* sceneDelegate,
     }
 
     ////////////////////////////////////////////////////////////////////////
-    // 3. Create RPR meshes
+    // 4. Create RPR meshes
 
     if (newMesh) {
+        m_allowGeometrySharing = allowGeometrySharing;
+
         for (auto mesh : m_rprMeshes) {
             rprApi->Release(mesh);
         }
@@ -301,10 +622,11 @@ void HdRprMesh::Sync(HdSceneDelegate* sceneDelegate,
         }
         m_rprMeshInstances.clear();
         m_rprMeshes.clear();
+        m_geomSubsetPointIndices.clear();
 
         m_geomSubsets = m_topology.GetGeomSubsets();
         if (m_geomSubsets.empty()) {
-            if (auto rprMesh = rprApi->CreateMesh(m_points, m_faceVertexIndices, m_normals, m_normalIndices, m_uvs, m_uvIndices, m_faceVertexCounts, m_topology.GetOrientation())) {
+            if (auto rprMesh = rprApi->CreateMesh(m_points, m_faceVertexIndices, m_normals, m_normalIndices, m_uvs, m_uvIndices, m_faceVertexCounts, m_topology.GetOrientation(), m_allowGeometrySharing)) {
                 m_rprMeshes.push_back(rprMesh);
             }
         } else {
@@ -337,106 +659,52 @@ void HdRprMesh::Sync(HdSceneDelegate* sceneDelegate,
                 }
             }
 
-            // GeomSubset may reference face subset in any given order so we need to be able to
+            // GeomSubset may reference faces in any given order so we need to be able to
             //   randomly lookup face indexes but each face may be of an arbitrary number of vertices
-            std::vector<int> indexesOffsetPrefixSum;
-            indexesOffsetPrefixSum.reserve(m_faceVertexCounts.size());
-            int offset = 0;
-            for (auto numVerticesInFace : m_faceVertexCounts) {
-                indexesOffsetPrefixSum.push_back(offset);
-                offset += numVerticesInFace;
+            std::vector<int> faceOffsets(numFaces);
+            size_t numFaceVertices = 0;
+            for (size_t i = 0; i < numFaces; ++i) {
+                faceOffsets[i] = static_cast<int>(numFaceVertices);
+                numFaceVertices += std::max(m_faceVertexCounts[i], 0);
+            }
+            if (numFaceVertices > m_faceVertexIndices.size()) {
+                TF_RUNTIME_ERROR("Failed to split geom subsets: face vertex counts do not match indices");
+                m_geomSubsets.clear();
             }
-
-            VtIntArray vertexIndexRemapping;
-            VtIntArray normalIndexRemapping;
-            VtIntArray uvIndexRemapping;
 
             for (auto it = m_geomSubsets.begin(); it != m_geomSubsets.end();) {
-                auto const& subset = *it;
-                if (subset.type != HdGeomSubset::TypeFaceSet) {
+                if (it->type != HdGeomSubset::TypeFaceSet) {
                     TF_RUNTIME_ERROR("Unknown HdGeomSubset Type");
                     it = m_geomSubsets.erase(it);
-                    continue;
+                } else {
+                    ++it;
                 }
+            }
 
-                VtVec3fArray subsetPoints;
-                VtVec3fArray subsetNormals;
-                VtVec2fArray subsetUv;
-                VtIntArray subsetNormalIndices;
-                VtIntArray subsetUvIndices;
-                VtIntArray subsetIndexes;
-                VtIntArray subsetVertexPerFace;
-                subsetVertexPerFace.reserve(subset.indices.size());
-
-                vertexIndexRemapping.reserve(m_points.size());
-                std::fill(vertexIndexRemapping.begin(), vertexIndexRemapping.begin() + m_points.size(), -1);
-                if (!m_normalIndices.empty()) {
-                    normalIndexRemapping.reserve(m_normals.size());
-                    std::fill(normalIndexRemapping.begin(), normalIndexRemapping.begin() + m_normals.size(), -1);
+            // Each subset compacts its own vertices, so all of them can be split in parallel
+            std::vector<GeomSubsetMeshData> subsetMeshes(m_geomSubsets.size());
+            WorkParallelForN(m_geomSubsets.size(), [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; ++i) {
+                    subsetMeshes[i] = SplitGeomSubset(m_geomSubsets[i], faceOffsets, m_faceVertexCounts, m_faceVertexIndices,
+                                                      m_points, m_normals, m_normalIndices, m_uvs, m_uvIndices);
                 }
-                if (!m_uvIndices.empty()) {
-                    uvIndexRemapping.reserve(m_uvs.size());
-                    std::fill(uvIndexRemapping.begin(), uvIndexRemapping.begin() + m_uvs.size(), -1);
-                }
-
-                for (auto faceIndex : subset.indices) {
-                    int numVerticesInFace = m_faceVertexCounts[faceIndex];
-                    subsetVertexPerFace.push_back(numVerticesInFace);
-
-                    int faceIndexesOffset = indexesOffsetPrefixSum[faceIndex];
-
-                    for (int i = 0; i < numVerticesInFace; ++i) {
-                        const int pointIndex = m_faceVertexIndices[faceIndexesOffset + i];
-                        int subsetPointIndex = vertexIndexRemapping[pointIndex];
-                        if (subsetPointIndex == -1) {
-                            subsetPointIndex = static_cast<int>(subsetPoints.size());
-                            vertexIndexRemapping[pointIndex] = subsetPointIndex;
+            });
 
-                            subsetPoints.push_back(m_points[pointIndex]);
-                        }
-                        subsetIndexes.push_back(subsetPointIndex);
-
-                        if (!m_normals.empty()) {
-                            if (m_normalIndices.empty()) {
-                                subsetNormals.push_back(m_normals[pointIndex]);
-                            } else {
-                                const int normalIndex = m_normalIndices[faceIndexesOffset + i];
-                                int subsetNormalIndex = normalIndexRemapping[normalIndex];
-                                if (subsetNormalIndex == -1) {
-                                    subsetNormalIndex = static_cast<int>(subsetNormals.size());
-                                    normalIndexRemapping[normalIndex] = subsetNormalIndex;
-
-                                    subsetNormals.push_back(m_normals[normalIndex]);
-                                }
-                                subsetNormalIndices.push_back(subsetNormalIndex);
-                            }
-                        }
-
-                        if (!m_uvs.empty()) {
-                            if (m_uvIndices.empty()) {
-                                subsetUv.push_back(m_uvs[pointIndex]);
-                            } else {
-                                const int uvIndex = m_uvIndices[faceIndexesOffset + i];
-                                int subsetuvIndex = uvIndexRemapping[uvIndex];
-                                if (subsetuvIndex == -1) {
-                                    subsetuvIndex = static_cast<int>(subsetUv.size());
-                                    uvIndexRemapping[uvIndex] = subsetuvIndex;
-
-                                    subsetUv.push_back(m_uvs[uvIndex]);
-                                }
-                                subsetUvIndices.push_back(subsetuvIndex);
-                            }
-                        }
-                    }
+            HdGeomSubsets createdSubsets;
+            for (size_t i = 0; i < subsetMeshes.size(); ++i) {
+                auto& subsetMesh = subsetMeshes[i];
+                if (!subsetMesh.isValid) {
+                    TF_RUNTIME_ERROR("Failed to split geom subset %s: invalid indices", m_geomSubsets[i].id.GetText());
+                    continue;
                 }
 
-                if (auto rprMesh = rprApi->CreateMesh(subsetPoints, subsetIndexes, subsetNormals, subsetNormalIndices, subsetUv, subsetUvIndices, subsetVertexPerFace, m_topology.GetOrientation())) {
+                if (auto rprMesh = rprApi->CreateMesh(subsetMesh.points, subsetMesh.indices, subsetMesh.normals, subsetMesh.normalIndices, subsetMesh.uvs, subsetMesh.uvIndices, subsetMesh.vertexPerFace, m_topology.GetOrientation(), m_allowGeometrySharing)) {
                     m_rprMeshes.push_back(rprMesh);
-                    ++it;
-                } else {
-                    it = m_geomSubsets.erase(it);
+                    m_geomSubsetPointIndices.push_back(std::move(subsetMesh.pointIndices));
+                    createdSubsets.push_back(m_geomSubsets[i]);
                 }
             }
+            m_geomSubsets = std::move(createdSubsets);
         }
     }
 
@@ -482,7 +750,7 @@ void HdRprMesh::Sync(HdSceneDelegate* sceneDelegate,
             }
         }
 
-        if (newMesh || (*dirtyBits & HdChangeTracker::DirtyMaterialId) ||
+        if (newMesh || (*dirtyBits & HdChangeTracker::DirtyMaterialId) || isGeomSubsetMaterialDirty ||
             (*dirtyBits & HdChangeTracker::DirtyDoubleSided) || // update twosided material node
             (*dirtyBits & HdChangeTracker::DirtyDisplayStyle) || isRefineLevelDirty) { // update displacement material
             auto getMeshMaterial = [sceneDelegate, rprApi, dirtyBits, this](SdfPath const& materialId) {
@@ -499,11 +767,15 @@ void HdRprMesh::Sync(HdSceneDelegate* sceneDelegate,
                 for (auto& mesh : m_rprMeshes) {
                     rprApi->SetMeshMaterial(mesh, material, m_doublesided, m_displayStyle.displacementEnabled);
                 }
+                rprApi->RequireUdimTiles(material, m_udimTiles);
             } else {
                 if (m_geomSubsets.size() == m_rprMeshes.size()) {
                     for (int i = 0; i < m_rprMeshes.size(); ++i) {
-                        auto material = getMeshMaterial(m_geomSubsets[i].materialId);
+                        // The subset of unused faces uses the material bound to the parent mesh
+                        auto& materialId = m_geomSubsets[i].id == id ? m_cachedMaterialId : m_geomSubsets[i].materialId;
+                        auto material = getMeshMaterial(materialId);
                         rprApi->SetMeshMaterial(m_rprMeshes[i], material, m_doublesided, m_displayStyle.displacementEnabled);
+                        rprApi->RequireUdimTiles(material, m_udimTiles);
                     }
                 } else {
                     TF_CODING_ERROR("Unexpected number of meshes");
@@ -530,24 +802,17 @@ void HdRprMesh::Sync(HdSceneDelegate* sceneDelegate,
                 } else {
                     updateTransform = false;
 
-                    std::vector<TfSmallVector<GfMatrix4d, 2>> combinedTransforms;
-                    combinedTransforms.reserve(newNumInstances);
-                    for (size_t i = 0; i < newNumInstances; ++i) {
-                        // Convert transform
-                        // Apply prototype transform (m_transformSamples) to all the instances
-                        combinedTransforms.emplace_back(instanceTransforms.count);
-                        auto& instanceTransform = combinedTransforms.back();
-
-                        if (m_transformSamples.count == 0 ||
-                            (m_transformSamples.count == 1 && (m_transformSamples.values[0] == GfMatrix4d(1)))) {
-                            for (size_t j = 0; j < instanceTransforms.count; ++j) {
-                                instanceTransform[j] = instanceTransforms.values[j][i];
-                            }
-                        } else {
-                            for (size_t j = 0; j < instanceTransforms.count; ++j) {
-                                GfMatrix4d xf_j = m_transformSamples.Resample(instanceTransforms.times[j]);
-                                instanceTransform[j] = xf_j * instanceTransforms.values[j][i];
-                            }
+                    // Apply prototype transform (m_transformSamples) to all the instances
+                    if (m_transformSamples.count != 0 &&
+                        !(m_transformSamples.count == 1 && (m_transformSamples.values[0] == GfMatrix4d(1)))) {
+                        for (size_t j = 0; j < instanceTransforms.count; ++j) {
+                            GfMatrix4d xf_j = m_transformSamples.Resample(instanceTransforms.times[j]);
+                            auto transformsData = instanceTransforms.values[j].data();
+                            WorkParallelForN(newNumInstances, [&](size_t begin, size_t end) {
+                                for (size_t i = begin; i < end; ++i) {
+                                    transformsData[i] = xf_j * transformsData[i];
+                                }
+                            });
                         }
                     }
 
@@ -561,23 +826,7 @@ void HdRprMesh::Sync(HdSceneDelegate* sceneDelegate,
                     m_rprMeshInstances.resize(m_rprMeshes.size());
 
                     for (int i = 0; i < m_rprMeshes.size(); ++i) {
-                        auto& meshInstances = m_rprMeshInstances[i];
-                        if (meshInstances.size() != newNumInstances) {
-                            if (meshInstances.size() > newNumInstances) {
-                                for (size_t i = newNumInstances; i < meshInstances.size(); ++i) {
-                                    rprApi->Release(meshInstances[i]);
-                                }
-                                meshInstances.resize(newNumInstances);
-                            } else {
-                                for (int j = meshInstances.size(); j < newNumInstances; ++j) {
-                                    meshInstances.push_back(rprApi->CreateMeshInstance(m_rprMeshes[i]));
-                                }
-                            }
-                        }
-
-                        for (int j = 0; j < newNumInstances; ++j) {
-                            rprApi->SetTransform(meshInstances[j], instanceTransforms.count, instanceTransforms.times.data(), combinedTransforms[j].data());
-                        }
+                        rprApi->SetMeshInstances(m_rprMeshes[i], &m_rprMeshInstances[i], instanceTransforms.count, instanceTransforms.times.data(), instanceTransforms.values.data());
 
                         // Hide prototype
                         rprApi->SetMeshVisibility(m_rprMeshes[i], false);
@@ -14,8 +14,9 @@ limitations under the License.
 #ifndef HDRPR_MESH_H
 #define HDRPR_MESH_H
 
+#include "meshNormals.h"
+
 #include "pxr/imaging/hd/mesh.h"
-#include "pxr/imaging/hd/vertexAdjacency.h"
 #include "pxr/base/vt/array.h"
 #include "pxr/base/gf/vec2f.h"
 #include "pxr/base/gf/matrix4f.h"
@@ -69,12 +70,18 @@ private:
 
     HdMeshTopology m_topology;
     HdGeomSubsets m_geomSubsets;
+    // Indices of mesh points used by each geom subset mesh
+    std::vector<VtIntArray> m_geomSubsetPointIndices;
     VtVec3fArray m_points;
     VtIntArray m_faceVertexCounts;
     VtIntArray m_faceVertexIndices;
     bool m_enableSubdiv = false;
+    // Whether the current RPR meshes were created with geometry sharing allowed
+    bool m_allowGeometrySharing = false;
+    // Points changed on the last sync
+    bool m_isDeforming = false;
 
-    Hd_VertexAdjacency m_adjacency;
+    HdRprVertexAdjacency m_adjacency;
     bool m_adjacencyValid = false;
 
     VtVec3fArray m_normals;
@@ -85,6 +92,8 @@ private:
 
     VtVec2fArray m_uvs;
     VtIntArray m_uvIndices;
+    // UDIM tiles covered by uvs, only these tiles of the material's UDIM textures are loaded
+    std::vector<uint32_t> m_udimTiles;
 
     HdDisplayStyle m_displayStyle;
     int m_refineLevel = 0;
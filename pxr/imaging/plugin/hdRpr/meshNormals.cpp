@@ -0,0 +1,220 @@
+/************************************************************************
+Copyright 2020 Advanced Micro Devices, Inc
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+************************************************************************/
+
+#include "meshNormals.h"
+
+#include "pxr/imaging/hd/tokens.h"
+#include "pxr/base/work/loops.h"
+
+#include <algorithm>
+#include <atomic>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+void HdRprVertexAdjacency::Build(VtIntArray const& faceVertexCounts, VtIntArray const& faceVertexIndices, TfToken const& orientation, size_t numPoints) {
+    m_offsets.assign(numPoints + 1, 0);
+    m_neighbours.clear();
+
+    auto isValidFace = [&](size_t indicesOffset, int numVertices) {
+        if (numVertices < 3 || indicesOffset + numVertices > faceVertexIndices.size()) {
+            return false;
+        }
+        for (int i = 0; i < numVertices; ++i) {
+            int pointIndex = faceVertexIndices[indicesOffset + i];
+            if (pointIndex < 0 || size_t(pointIndex) >= numPoints) {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    // Count face corners per vertex
+    size_t indicesOffset = 0;
+    for (auto numVertices : faceVertexCounts) {
+        if (isValidFace(indicesOffset, numVertices)) {
+            for (int i = 0; i < numVertices; ++i) {
+                ++m_offsets[faceVertexIndices[indicesOffset + i] + 1];
+            }
+        }
+        indicesOffset += std::max(numVertices, 0);
+    }
+
+    for (size_t i = 0; i < numPoints; ++i) {
+        m_offsets[i + 1] += m_offsets[i];
+    }
+    m_neighbours.resize(2 * m_offsets[numPoints]);
+
+    // Fill neighbours of each face corner
+    const bool flip = orientation != HdTokens->rightHanded;
+    std::vector<int> cursors(m_offsets.begin(), m_offsets.end() - 1);
+    indicesOffset = 0;
+    for (auto numVertices : faceVertexCounts) {
+        if (isValidFace(indicesOffset, numVertices)) {
+            auto indices = faceVertexIndices.cdata() + indicesOffset;
+            for (int i = 0; i < numVertices; ++i) {
+                int prev = indices[(i + numVertices - 1) % numVertices];
+                int next = indices[(i + 1) % numVertices];
+                if (flip) {
+                    std::swap(prev, next);
+                }
+
+                int corner = cursors[indices[i]]++;
+                m_neighbours[2 * corner] = prev;
+                m_neighbours[2 * corner + 1] = next;
+            }
+        }
+        indicesOffset += std::max(numVertices, 0);
+    }
+}
+
+GfVec3f HdRprVertexAdjacency::ComputeSmoothNormal(GfVec3f const* points, size_t pointIndex) const {
+    const GfVec3f& point = points[pointIndex];
+
+    // Scalar loop: neighbours are gathered through indices, parallelism comes from processing vertices in parallel
+    float nx = 0.0f, ny = 0.0f, nz = 0.0f;
+    const int* neighbours = m_neighbours.data() + 2 * m_offsets[pointIndex];
+    const int numCorners = m_offsets[pointIndex + 1] - m_offsets[pointIndex];
+    for (int i = 0; i < numCorners; ++i) {
+        const GfVec3f& prev = points[neighbours[2 * i]];
+        const GfVec3f& next = points[neighbours[2 * i + 1]];
+
+        const float ax = next[0] - point[0], ay = next[1] - point[1], az = next[2] - point[2];
+        const float bx = prev[0] - point[0], by = prev[1] - point[1], bz = prev[2] - point[2];
+        nx += ay * bz - az * by;
+        ny += az * bx - ax * bz;
+        nz += ax * by - ay * bx;
+    }
+
+    GfVec3f normal(nx, ny, nz);
+    normal.Normalize();
+    return normal;
+}
+
+void HdRprVertexAdjacency::ComputeSmoothNormals(VtVec3fArray const& points, VtVec3fArray* normals) const {
+    const size_t numPoints = GetNumPoints();
+    if (points.size() != numPoints) {
+        TF_CODING_ERROR("Vertex adjacency does not match points");
+        normals->clear();
+        return;
+    }
+
+    VtVec3fArray newNormals(numPoints);
+    auto pointsData = points.cdata();
+    auto normalsData = newNormals.data();
+    WorkParallelForN(numPoints, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            normalsData[i] = ComputeSmoothNormal(pointsData, i);
+        }
+    });
+
+    *normals = std::move(newNormals);
+}
+
+void HdRprVertexAdjacency::UpdateSmoothNormals(VtVec3fArray const& prevPoints, VtVec3fArray const& points, VtVec3fArray* normals) const {
+    const size_t numPoints = GetNumPoints();
+    if (prevPoints.size() != numPoints ||
+        points.size() != numPoints ||
+        normals->size() != numPoints) {
+        return ComputeSmoothNormals(points, normals);
+    }
+
+    if (prevPoints.IsIdentical(points)) {
+        return;
+    }
+
+    // Find moved points
+    std::vector<uint8_t> isMoved(numPoints);
+    std::atomic<bool> anyMoved(false);
+    auto prevPointsData = prevPoints.cdata();
+    auto pointsData = points.cdata();
+    WorkParallelForN(numPoints, [&](size_t begin, size_t end) {
+        bool moved = false;
+        for (size_t i = begin; i < end; ++i) {
+            isMoved[i] = prevPointsData[i] != pointsData[i];
+            moved |= isMoved[i] != 0;
+        }
+        if (moved) {
+            anyMoved.store(true, std::memory_order_relaxed);
+        }
+    });
+
+    if (!anyMoved) {
+        return;
+    }
+
+    // Normal of a vertex depends only on the vertex itself and its neighbours in each face corner
+    auto normalsData = normals->data();
+    WorkParallelForN(numPoints, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            bool isDirty = isMoved[i] != 0;
+            for (int j = 2 * m_offsets[i]; j < 2 * m_offsets[i + 1] && !isDirty; ++j) {
+                isDirty = isMoved[m_neighbours[j]] != 0;
+            }
+
+            if (isDirty) {
+                normalsData[i] = ComputeSmoothNormal(pointsData, i);
+            }
+        }
+    });
+}
+
+void HdRprComputeFaceNormals(VtVec3fArray const& points, VtIntArray const& faceVertexCounts, VtIntArray const& faceVertexIndices,
+                             VtVec3fArray* normals, VtIntArray* normalIndices) {
+    const size_t numFaces = faceVertexCounts.size();
+
+    std::vector<size_t> faceOffsets(numFaces + 1);
+    faceOffsets[0] = 0;
+    for (size_t i = 0; i < numFaces; ++i) {
+        faceOffsets[i + 1] = faceOffsets[i] + std::max(faceVertexCounts[i], 0);
+    }
+    if (faceOffsets[numFaces] > faceVertexIndices.size()) {
+        TF_RUNTIME_ERROR("Failed to compute face normals: face vertex counts do not match indices");
+        normals->clear();
+        normalIndices->clear();
+        return;
+    }
+
+    VtVec3fArray newNormals(numFaces);
+    VtIntArray newNormalIndices(faceOffsets[numFaces]);
+
+    auto pointsData = points.cdata();
+    auto indicesData = faceVertexIndices.cdata();
+    auto normalsData = newNormals.data();
+    auto normalIndicesData = newNormalIndices.data();
+    WorkParallelForN(numFaces, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            auto indices = indicesData + faceOffsets[i];
+            auto numVertices = faceOffsets[i + 1] - faceOffsets[i];
+            std::fill(normalIndicesData + faceOffsets[i], normalIndicesData + faceOffsets[i + 1], int(i));
+
+            GfVec3f normal(0.0f);
+            if (numVertices >= 3 &&
+                size_t(indices[0]) < points.size() &&
+                size_t(indices[1]) < points.size() &&
+                size_t(indices[2]) < points.size()) {
+                auto p0 = pointsData[indices[0]];
+                auto p1 = pointsData[indices[1]];
+                auto p2 = pointsData[indices[2]];
+
+                normal = GfCross(p2 - p1, p0 - p1);
+                normal.Normalize();
+            }
+            normalsData[i] = normal;
+        }
+    });
+
+    *normals = std::move(newNormals);
+    *normalIndices = std::move(newNormalIndices);
+}
+
+PXR_NAMESPACE_CLOSE_SCOPE
@@ -0,0 +1,56 @@
+/************************************************************************
+Copyright 2020 Advanced Micro Devices, Inc
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+************************************************************************/
+
+#ifndef HDRPR_MESH_NORMALS_H
+#define HDRPR_MESH_NORMALS_H
+
+#include "pxr/base/tf/token.h"
+#include "pxr/base/vt/array.h"
+#include "pxr/base/gf/vec3f.h"
+
+#include <vector>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+/// Vertex adjacency of a polygonal mesh.
+/// For each vertex it stores the previous and the next vertex of every face corner the vertex belongs to.
+/// The layout is compact (offsets + flat neighbour list) so that all normals can be gathered in parallel without synchronization.
+class HdRprVertexAdjacency {
+public:
+    void Build(VtIntArray const& faceVertexCounts, VtIntArray const& faceVertexIndices, TfToken const& orientation, size_t numPoints);
+
+    size_t GetNumPoints() const { return m_offsets.empty() ? 0 : m_offsets.size() - 1; }
+
+    /// Computes area weighted vertex normals
+    void ComputeSmoothNormals(VtVec3fArray const& points, VtVec3fArray* normals) const;
+
+    /// Recomputes normals only of the vertices affected by the points that differ from prevPoints.
+    /// normals must be smooth normals computed from prevPoints, otherwise they are computed from scratch.
+    void UpdateSmoothNormals(VtVec3fArray const& prevPoints, VtVec3fArray const& points, VtVec3fArray* normals) const;
+
+private:
+    GfVec3f ComputeSmoothNormal(GfVec3f const* points, size_t pointIndex) const;
+
+private:
+    std::vector<int> m_offsets;
+    std::vector<int> m_neighbours;
+};
+
+/// Computes flat normal of each face. Face vertices are expected to be in right handed winding order.
+/// Each face vertex gets the index of its face normal.
+void HdRprComputeFaceNormals(VtVec3fArray const& points, VtIntArray const& faceVertexCounts, VtIntArray const& faceVertexIndices,
+                             VtVec3fArray* normals, VtIntArray* normalIndices);
+
+PXR_NAMESPACE_CLOSE_SCOPE
+
+#endif // HDRPR_MESH_NORMALS_H
@@ -16,12 +16,124 @@ limitations under the License.
 #include "primvarUtil.h"
 #include "renderParam.h"
 #include "materialAdapter.h"
+#include "config.h"
 
 #include "pxr/imaging/hd/extComputationUtils.h"
 #include "pxr/usdImaging/usdImaging/implicitSurfaceMeshUtils.h"
+#include "pxr/base/work/loops.h"
+
+#include <algorithm>
+#include <cmath>
 
 PXR_NAMESPACE_OPEN_SCOPE
 
+namespace {
+
+int GetPointsMaxInstances() {
+    HdRprConfig* config;
+    auto configInstanceLock = HdRprConfig::GetInstance(&config);
+    return config->GetPointsMaxInstances();
+}
+
+/// Low-poly shape that substitutes a sphere of unit diameter in the proxy mesh of points
+struct PointProxyShape {
+    std::vector<GfVec3f> vertices;
+    std::vector<int> indices;
+};
+
+// Octahedra are too heavy for huge point sets, a point covers a few pixels at most there
+const size_t kMaxOctahedronProxies = 1000000;
+
+PointProxyShape const& GetPointProxyShape(size_t numPoints) {
+    static const PointProxyShape octahedron = {
+        {{0.5f, 0.0f, 0.0f}, {-0.5f, 0.0f, 0.0f}, {0.0f, 0.5f, 0.0f}, {0.0f, -0.5f, 0.0f}, {0.0f, 0.0f, 0.5f}, {0.0f, 0.0f, -0.5f}},
+        {0, 2, 4, 0, 5, 2, 0, 4, 3, 0, 3, 5, 1, 4, 2, 1, 2, 5, 1, 3, 4, 1, 5, 3}
+    };
+    const float t = 0.5f / std::sqrt(3.0f);
+    static const PointProxyShape tetrahedron = {
+        {{t, t, t}, {t, -t, -t}, {-t, t, -t}, {-t, -t, t}},
+        {0, 1, 2, 0, 3, 1, 0, 2, 3, 1, 3, 2}
+    };
+    return numPoints > kMaxOctahedronProxies ? tetrahedron : octahedron;
+}
+
+float GetPointWidth(VtFloatArray const& widths, HdInterpolation interpolation, size_t pointIndex) {
+    if (interpolation == HdInterpolationVertex) {
+        return pointIndex < widths.size() ? widths.cdata()[pointIndex] : 1.0f;
+    } else if (interpolation == HdInterpolationConstant) {
+        return widths.empty() ? 1.0f : widths.cdata()[0];
+    }
+    return 1.0f;
+}
+
+/// Places a copy of the proxy shape at each point scaled by point width
+VtVec3fArray GenerateProxyMeshPoints(VtVec3fArray const& points, VtFloatArray const& widths, HdInterpolation widthsInterpolation) {
+    auto& shape = GetPointProxyShape(points.size());
+    const size_t numShapeVertices = shape.vertices.size();
+
+    VtVec3fArray proxyPoints(points.size() * numShapeVertices);
+    auto pointsData = points.cdata();
+    auto proxyPointsData = proxyPoints.data();
+    WorkParallelForN(points.size(), [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            auto width = GetPointWidth(widths, widthsInterpolation, i);
+            for (size_t j = 0; j < numShapeVertices; ++j) {
+                proxyPointsData[i * numShapeVertices + j] = pointsData[i] + shape.vertices[j] * width;
+            }
+        }
+    });
+    return proxyPoints;
+}
+
+/// Proxy shape vertices lie on a sphere, so sphere normals make the proxy look smooth
+VtVec3fArray GetProxyMeshNormals(size_t numPoints) {
+    auto& shape = GetPointProxyShape(numPoints);
+    VtVec3fArray normals(shape.vertices.size());
+    for (size_t i = 0; i < shape.vertices.size(); ++i) {
+        normals[i] = shape.vertices[i].GetNormalized();
+    }
+    return normals;
+}
+
+/// Generates topology of the proxy mesh. If uvs are requested, all vertices of the i-th point get (i, 0) uv
+/// so that per-point values can be looked up by uv in the material
+void GenerateProxyMeshTopology(size_t numPoints, bool generateUVs,
+                               VtIntArray* indices, VtIntArray* normalIndices, VtIntArray* vpf, VtVec2fArray* uvs, VtIntArray* uvIndices) {
+    auto& shape = GetPointProxyShape(numPoints);
+    const size_t numShapeVertices = shape.vertices.size();
+    const size_t numShapeIndices = shape.indices.size();
+
+    *vpf = VtIntArray(numPoints * (numShapeIndices / 3), 3);
+    *indices = VtIntArray(numPoints * numShapeIndices);
+    *normalIndices = VtIntArray(numPoints * numShapeIndices);
+    if (generateUVs) {
+        *uvs = VtVec2fArray(numPoints);
+        *uvIndices = VtIntArray(numPoints * numShapeIndices);
+    } else {
+        uvs->clear();
+        uvIndices->clear();
+    }
+
+    auto indicesData = indices->data();
+    auto normalIndicesData = normalIndices->data();
+    auto uvsData = generateUVs ? uvs->data() : nullptr;
+    auto uvIndicesData = generateUVs ? uvIndices->data() : nullptr;
+    WorkParallelForN(numPoints, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            for (size_t j = 0; j < numShapeIndices; ++j) {
+                indicesData[i * numShapeIndices + j] = int(i * numShapeVertices) + shape.indices[j];
+                normalIndicesData[i * numShapeIndices + j] = shape.indices[j];
+            }
+            if (generateUVs) {
+                uvsData[i] = GfVec2f(float(i), 0.0f);
+                std::fill(uvIndicesData + i * numShapeIndices, uvIndicesData + (i + 1) * numShapeIndices, int(i));
+            }
+        }
+    });
+}
+
+} // namespace anonymous
+
 HdRprPoints::HdRprPoints(SdfPath const& id, SdfPath const& instancerId)
     : HdPoints(id, instancerId)
     , m_visibilityMask(kVisibleAll)
@@ -53,9 +165,12 @@ void HdRprPoints::Sync(
             auto valueStore = HdExtComputationUtils::GetComputedPrimvarValues({desc}, sceneDelegate);
             auto pointValueIt = valueStore.find(desc.name);
             if (pointValueIt != valueStore.end()) {
-                m_points = pointValueIt->second.Get<VtVec3fArray>();
+                auto points = pointValueIt->second.Get<VtVec3fArray>();
                 isPointsComputed = true;
-                dirtyPoints = true;
+                if (points != m_points) {
+                    m_points = points;
+                    dirtyPoints = true;
+                }
             }
         }
 
@@ -64,32 +179,57 @@ void HdRprPoints::Sync(
 
     if (!isPointsComputed &&
         HdChangeTracker::IsPrimvarDirty(*dirtyBits, id, HdTokens->points)) {
-        VtValue pointsValue = sceneDelegate->Get(id, HdTokens->points);
-        m_points = pointsValue.Get<VtVec3fArray>();
-        dirtyPoints = true;
+        auto points = sceneDelegate->Get(id, HdTokens->points).Get<VtVec3fArray>();
+        if (points != m_points) {
+            m_points = points;
+            dirtyPoints = true;
+        }
     }
 
+    // Dirty bits are only a hint, data is compared with the current state so that
+    // e.g. a transform-only change does not rebuild per-point data
+    bool dirtyWidths = false;
     if (*dirtyBits & HdChangeTracker::DirtyWidths) {
+        VtFloatArray widths;
+        HdInterpolation widthsInterpolation;
         HdRprFillPrimvarDescsPerInterpolation(sceneDelegate, id, &primvarDescsPerInterpolation);
-        if (HdRprIsPrimvarExists(HdTokens->widths, primvarDescsPerInterpolation, &m_widthsInterpolation)) {
-            m_widths = sceneDelegate->Get(id, HdTokens->widths).Get<VtFloatArray>();
+        if (HdRprIsPrimvarExists(HdTokens->widths, primvarDescsPerInterpolation, &widthsInterpolation)) {
+            widths = sceneDelegate->Get(id, HdTokens->widths).Get<VtFloatArray>();
+            if (widthsInterpolation != HdInterpolationVertex &&
+                widthsInterpolation != HdInterpolationConstant) {
+                TF_WARN("[%s] Unsupported widths interpolation. Fallback value is 1.0f with a constant interpolation", id.GetText());
+            }
         } else {
-            m_widths = VtFloatArray(1, 1.0f);
-            m_widthsInterpolation = HdInterpolationConstant;
+            widths = VtFloatArray(1, 1.0f);
+            widthsInterpolation = HdInterpolationConstant;
             TF_WARN("[%s] Points does not have widths. Fallback value is 1.0f with a constant interpolation", id.GetText());
         }
+
+        if (widthsInterpolation != m_widthsInterpolation || widths != m_widths) {
+            m_widths = widths;
+            m_widthsInterpolation = widthsInterpolation;
+            dirtyWidths = true;
+        }
     }
 
-    bool dirtyDisplayColors = HdChangeTracker::IsPrimvarDirty(*dirtyBits, id, HdTokens->displayColor);
-    if (dirtyDisplayColors) {
+    bool dirtyDisplayColors = false;
+    if (HdChangeTracker::IsPrimvarDirty(*dirtyBits, id, HdTokens->displayColor)) {
+        VtVec3fArray colors;
+        HdInterpolation colorsInterpolation;
         HdRprFillPrimvarDescsPerInterpolation(sceneDelegate, id, &primvarDescsPerInterpolation);
-        if (HdRprIsPrimvarExists(HdTokens->displayColor, primvarDescsPerInterpolation, &m_colorsInterpolation)) {
-            m_colors = sceneDelegate->Get(GetId(), HdTokens->displayColor).Get<VtVec3fArray>();
+        if (HdRprIsPrimvarExists(HdTokens->displayColor, primvarDescsPerInterpolation, &colorsInterpolation)) {
+            colors = sceneDelegate->Get(GetId(), HdTokens->displayColor).Get<VtVec3fArray>();
         } else {
-            m_colors = VtVec3fArray(1, GfVec3f(1, 0, 1));
-            m_colorsInterpolation = HdInterpolationConstant;
+            colors = VtVec3fArray(1, GfVec3f(1, 0, 1));
+            colorsInterpolation = HdInterpolationConstant;
             TF_WARN("[%s] Points does not have display colors. Fallback value is pink color with a constant interpolation", id.GetText());
         }
+
+        if (!m_material || colorsInterpolation != m_colorsInterpolation || colors != m_colors) {
+            m_colors = colors;
+            m_colorsInterpolation = colorsInterpolation;
+            dirtyDisplayColors = true;
+        }
     }
 
     if (*dirtyBits & HdChangeTracker::DirtyVisibility) {
@@ -119,99 +259,152 @@ void HdRprPoints::Sync(
         }
     }
 
-    if (dirtyDisplayColors) {
+    // Instancing is cheap in RPR but each instance is still a separate scene object.
+    // For large point sets it's much more efficient to merge all points into one mesh
+    const int maxInstances = GetPointsMaxInstances();
+    const bool useProxyMesh = maxInstances > 0 && m_points.size() > size_t(maxInstances);
+    const bool dirtyRepresentation = useProxyMesh != m_useProxyMesh;
+    m_useProxyMesh = useProxyMesh;
+
+    bool dirtyMaterial = false;
+    if (dirtyDisplayColors ||
+        (dirtyRepresentation && m_colorsInterpolation == HdInterpolationVertex)) {
         if (m_material) {
             rprApi->Release(m_material);
             m_material = nullptr;
         }
 
         if (m_colorsInterpolation == HdInterpolationVertex) {
-            m_material = rprApi->CreatePointsMaterial(m_colors);
+            // Proxy mesh is a single object so colors are indexed by the uvs of the mesh
+            m_material = rprApi->CreatePointsMaterial(m_colors, useProxyMesh);
         } else if (!m_colors.empty()) {
             auto matAdapter = MaterialAdapter(EMaterialType::COLOR, MaterialParams{{HdRprMaterialTokens->color, VtValue(m_colors[0])}});
             m_material = rprApi->CreateMaterial(matAdapter);
         }
+        dirtyMaterial = true;
     }
 
-    bool dirtyPrototypeMesh = false;
-    bool dirtyInstances = false;
-    if (m_instances.size() != m_points.size()) {
-        if (m_points.empty()) {
-            rprApi->Release(m_prototypeMesh);
-            m_prototypeMesh = nullptr;
-        } else {
-            auto& topology = UsdImagingGetUnitSphereMeshTopology();
-            auto& points = UsdImagingGetUnitSphereMeshPoints();
-
-            m_prototypeMesh = rprApi->CreateMesh(points, topology.GetFaceVertexIndices(), VtVec3fArray(), VtIntArray(), VtVec2fArray(), VtIntArray(), topology.GetFaceVertexCounts(), topology.GetOrientation());
-            rprApi->SetMeshVisibility(m_prototypeMesh, kInvisible);
-            rprApi->SetMeshRefineLevel(m_prototypeMesh, m_subdivisionLevel);
+    if (!_sharedData.visible) {
+        // if primitive is fully invisible then visibility mask has no effect
+        dirtyVisibilityMask = false;
+    }
+    const bool dirtyVisibility = (*dirtyBits & HdChangeTracker::DirtyVisibility) || dirtyVisibilityMask;
+    const uint32_t visibilityMask = _sharedData.visible ? m_visibilityMask : kInvisible;
 
-            dirtyPrototypeMesh = true;
+    if (useProxyMesh) {
+        if (dirtyRepresentation) {
+            ReleaseInstances(rprApi);
         }
 
-        if (m_instances.size() > m_points.size()) {
-            for (size_t i = m_points.size(); i < m_instances.size(); ++i) {
-                rprApi->Release(m_instances[i]);
+        const bool generateUVs = m_colorsInterpolation == HdInterpolationVertex;
+
+        bool dirtyProxyMesh = false;
+        if (dirtyPoints || dirtyRepresentation ||
+            dirtyWidths ||
+            generateUVs != m_proxyMeshHasUVs) {
+            auto proxyPoints = GenerateProxyMeshPoints(m_points, m_widths, m_widthsInterpolation);
+
+            rpr::Shape* proxyMesh = nullptr;
+            if (m_proxyMesh &&
+                m_proxyMeshNumPoints == m_points.size() &&
+                m_proxyMeshHasUVs == generateUVs) {
+                // Topology is the same, only move vertices
+                proxyMesh = rprApi->UpdateMeshPoints(m_proxyMesh, proxyPoints, VtVec3fArray(), nullptr);
             }
-            m_instances.resize(m_points.size());
-        } else {
-            m_instances.reserve(m_points.size());
-            for (size_t i = m_instances.size(); i < m_points.size(); ++i) {
-                if (auto instance = rprApi->CreateMeshInstance(m_prototypeMesh)) {
-                    rprApi->SetMeshId(instance, i);
-                    m_instances.push_back(instance);
-                }
+
+            if (proxyMesh) {
+                m_proxyMesh = proxyMesh;
+            } else {
+                rprApi->Release(m_proxyMesh);
+
+                VtIntArray indices, normalIndices, vpf, uvIndices;
+                VtVec2fArray uvs;
+                GenerateProxyMeshTopology(m_points.size(), generateUVs, &indices, &normalIndices, &vpf, &uvs, &uvIndices);
+                auto normals = GetProxyMeshNormals(m_points.size());
+                m_proxyMesh = rprApi->CreateMesh(proxyPoints, indices, normals, normalIndices, uvs, uvIndices, vpf, HdTokens->rightHanded);
+                m_proxyMeshNumPoints = m_points.size();
+                m_proxyMeshHasUVs = generateUVs;
+                dirtyProxyMesh = true;
             }
+        }
 
-            dirtyInstances = true;
+        if (m_proxyMesh) {
+            if (dirtyProxyMesh || (*dirtyBits & HdChangeTracker::DirtyTransform)) {
+                rprApi->SetTransform(m_proxyMesh, m_transform);
+            }
+            if (dirtyProxyMesh || dirtyMaterial) {
+                rprApi->SetMeshMaterial(m_proxyMesh, m_material, false, false);
+            }
+            if (dirtyProxyMesh || dirtyVisibility) {
+                rprApi->SetMeshVisibility(m_proxyMesh, visibilityMask);
+            }
+        }
+    } else {
+        if (dirtyRepresentation) {
+            rprApi->Release(m_proxyMesh);
+            m_proxyMesh = nullptr;
         }
-        m_instances.shrink_to_fit();
-    }
 
-    if (!m_instances.empty()) {
-        if (dirtySubdivisionLevel && !dirtyPrototypeMesh) {
+        if (m_points.empty()) {
+            ReleaseInstances(rprApi);
+        } else if (!m_prototypeMesh) {
+            auto& topology = UsdImagingGetUnitSphereMeshTopology();
+            auto& points = UsdImagingGetUnitSphereMeshPoints();
+
+            m_prototypeMesh = rprApi->CreateMesh(points, topology.GetFaceVertexIndices(), VtVec3fArray(), VtIntArray(), VtVec2fArray(), VtIntArray(), topology.GetFaceVertexCounts(), topology.GetOrientation());
+            rprApi->SetMeshVisibility(m_prototypeMesh, kInvisible);
+            rprApi->SetMeshRefineLevel(m_prototypeMesh, m_subdivisionLevel);
+        } else if (dirtySubdivisionLevel) {
             rprApi->SetMeshRefineLevel(m_prototypeMesh, m_subdivisionLevel);
         }
 
-        if ((*dirtyBits & HdChangeTracker::DirtyTransform) ||
-            (*dirtyBits & HdChangeTracker::DirtyWidths) ||
-            dirtyPoints || dirtyInstances) {
-
-            std::function<float(size_t)> sampleWidth;
-            if (m_widthsInterpolation == HdInterpolationVertex) {
-                sampleWidth = [this](size_t idx) { return m_widths[idx]; };
-            } else if (m_widthsInterpolation == HdInterpolationConstant) {
-                sampleWidth = [this](size_t) { return m_widths[0]; };
-            } else {
-                sampleWidth = [](size_t) { return 1.0f; };
-                TF_WARN("[%s] Unsupported widths interpolation. Fallback value is 1.0f with a constant interpolation", id.GetText());
+        if (m_prototypeMesh) {
+            // Point transforms relative to the primitive are rebuilt only if points or widths were changed
+            bool dirtyLocalTransforms = dirtyPoints || dirtyWidths || m_localTransforms.size() != m_points.size();
+            if (dirtyLocalTransforms) {
+                m_localTransforms = VtMatrix4fArray(m_points.size());
+                auto localTransformsData = m_localTransforms.data();
+                auto pointsData = m_points.cdata();
+                WorkParallelForN(m_points.size(), [&](size_t begin, size_t end) {
+                    for (size_t i = begin; i < end; ++i) {
+                        auto width = GetPointWidth(m_widths, m_widthsInterpolation, i);
+                        localTransformsData[i] = GfMatrix4f(1.0f).SetScale(GfVec3f(width)).SetTranslateOnly(pointsData[i]);
+                    }
+                });
             }
 
-            for (size_t i = 0; i < m_instances.size(); ++i) {
-                auto& position = m_points[i];
-                auto width = sampleWidth(i);
-                auto transform = GfMatrix4f(1.0f).SetScale(GfVec3f(width)).SetTranslateOnly(position) * m_transform;
-
-                rprApi->SetTransform(m_instances[i], transform);
+            bool dirtyInstances = false;
+            if (dirtyLocalTransforms ||
+                (*dirtyBits & HdChangeTracker::DirtyTransform) ||
+                m_instances.size() != m_points.size()) {
+                VtMatrix4fArray transforms(m_localTransforms.size());
+                auto transformsData = transforms.data();
+                auto localTransformsData = m_localTransforms.cdata();
+                WorkParallelForN(m_localTransforms.size(), [&](size_t begin, size_t end) {
+                    for (size_t i = begin; i < end; ++i) {
+                        transformsData[i] = localTransformsData[i] * m_transform;
+                    }
+                });
+
+                // Existing instances are reused, only new ones need the full setup
+                size_t numOldInstances = m_instances.size();
+                rprApi->SetMeshInstances(m_prototypeMesh, &m_instances, transforms);
+                for (size_t i = numOldInstances; i < m_instances.size(); ++i) {
+                    rprApi->SetMeshId(m_instances[i], i);
+                    dirtyInstances = true;
+                }
             }
-        }
 
-        if (dirtyDisplayColors || dirtyInstances) {
-            for (size_t i = 0; i < m_instances.size(); ++i) {
-                rprApi->SetMeshMaterial(m_instances[i], m_material, false, false);
+            if (dirtyMaterial || dirtyInstances) {
+                for (size_t i = 0; i < m_instances.size(); ++i) {
+                    rprApi->SetMeshMaterial(m_instances[i], m_material, false, false);
+                }
             }
-        }
 
-        if (!_sharedData.visible) {
-            // if primitive is fully invisible then visibility mask has no effect
-            dirtyVisibilityMask = false;
-        }
-        if ((*dirtyBits & HdChangeTracker::DirtyVisibility) ||
-            dirtyVisibilityMask || dirtyInstances) {
-            auto visibilityMask = _sharedData.visible ? m_visibilityMask : kInvisible;
-            for (size_t i = 0; i < m_instances.size(); ++i) {
-                rprApi->SetMeshVisibility(m_instances[i], visibilityMask);
+            if (dirtyVisibility || dirtyInstances) {
+                for (size_t i = 0; i < m_instances.size(); ++i) {
+                    rprApi->SetMeshVisibility(m_instances[i], visibilityMask);
+                }
             }
         }
     }
@@ -222,13 +415,10 @@ void HdRprPoints::Sync(
 void HdRprPoints::Finalize(HdRenderParam* renderParam) {
     auto rprApi = static_cast<HdRprRenderParam*>(renderParam)->AcquireRprApiForEdit();
 
-    rprApi->Release(m_prototypeMesh);
-    m_prototypeMesh = nullptr;
+    ReleaseInstances(rprApi);
 
-    for (auto instance : m_instances) {
-        rprApi->Release(instance);
-    }
-    m_instances.clear();
+    rprApi->Release(m_proxyMesh);
+    m_proxyMesh = nullptr;
 
     rprApi->Release(m_material);
     m_material = nullptr;
@@ -236,13 +426,25 @@ void HdRprPoints::Finalize(HdRenderParam* renderParam) {
     HdPoints::Finalize(renderParam);
 }
 
+void HdRprPoints::ReleaseInstances(HdRprApi* rprApi) {
+    for (auto instance : m_instances) {
+        rprApi->Release(instance);
+    }
+    m_instances.clear();
+    m_localTransforms = VtMatrix4fArray();
+
+    rprApi->Release(m_prototypeMesh);
+    m_prototypeMesh = nullptr;
+}
+
 HdDirtyBits HdRprPoints::GetInitialDirtyBitsMask() const {
     return HdChangeTracker::Clean |
         HdChangeTracker::DirtyPoints |
         HdChangeTracker::DirtyWidths |
         HdChangeTracker::DirtyTransform |
         HdChangeTracker::DirtyPrimvar |
-        HdChangeTracker::DirtyVisibility;
+        HdChangeTracker::DirtyVisibility |
+        DirtyProxyMesh;
 }
 
 HdDirtyBits HdRprPoints::_PropagateDirtyBits(HdDirtyBits bits) const {
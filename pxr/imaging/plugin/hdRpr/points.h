@@ -22,10 +22,14 @@ namespace rpr { class Shape; }
 
 PXR_NAMESPACE_OPEN_SCOPE
 
+class HdRprApi;
 struct HdRprApiMaterial;
 
 class HdRprPoints : public HdPoints {
 public:
+    // Render settings the choice between sphere instances and the proxy mesh depends on are changed
+    static const HdDirtyBits DirtyProxyMesh = HdChangeTracker::CustomBitsBegin;
+
     HdRprPoints(SdfPath const& id, SdfPath const& instancerId);
 
     ~HdRprPoints() override = default;
@@ -45,20 +49,30 @@ protected:
     void _InitRepr(TfToken const& reprName,
                    HdDirtyBits* dirtyBits) override;
 
+private:
+    void ReleaseInstances(HdRprApi* rprApi);
+
 private:
     rpr::Shape* m_prototypeMesh = nullptr;
     std::vector<rpr::Shape*> m_instances;
+    VtMatrix4fArray m_localTransforms;
     HdRprApiMaterial* m_material = nullptr;
 
+    // Large point sets are rendered as a single mesh of low-poly proxies instead of sphere instances
+    rpr::Shape* m_proxyMesh = nullptr;
+    size_t m_proxyMeshNumPoints = 0;
+    bool m_proxyMeshHasUVs = false;
+    bool m_useProxyMesh = false;
+
     GfMatrix4f m_transform;
 
     VtVec3fArray m_points;
 
     VtVec3fArray m_colors;
-    HdInterpolation m_colorsInterpolation;
+    HdInterpolation m_colorsInterpolation = HdInterpolationConstant;
 
     VtFloatArray m_widths;
-    HdInterpolation m_widthsInterpolation;
+    HdInterpolation m_widthsInterpolation = HdInterpolationConstant;
 
     uint32_t m_visibilityMask;
     int m_subdivisionLevel;
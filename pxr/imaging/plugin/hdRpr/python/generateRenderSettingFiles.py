@@ -252,6 +252,57 @@ render_setting_categories = [
             }
         ]
     },
+    {
+        'name': 'Volume',
+        'settings': [
+            {
+                'name': 'volumeResolution',
+                'ui_name': 'Volume Resolution',
+                'help': 'Resolution of volume grids passed to the renderer. Auto uses full resolution in batch mode only, and half or quarter resolution (Low and Medium render quality) in interactive sessions.',
+                'defaultValue': 0,
+                'values': [
+                    "Auto",
+                    "Full",
+                    "Half",
+                    "Quarter"
+                ]
+            }
+        ]
+    },
+    {
+        'name': 'Points',
+        'settings': [
+            {
+                'name': 'pointsMaxInstances',
+                'ui_name': 'Points Max Instances',
+                'help': 'Points primitives with more points are rendered as a single mesh of low-poly spheres instead of one sphere instance per point. Zero disables such meshes.',
+                'defaultValue': 0,
+                'minValue': 0,
+                'maxValue': 2 ** 30
+            }
+        ]
+    },
+    {
+        'name': 'Textures',
+        'settings': [
+            {
+                'name': 'textureCacheSize',
+                'ui_name': 'Texture Cache Size (MB)',
+                'help': 'Amount of memory used by cached textures. Once it is exceeded, textures that are not used by any material are released, least recently used first.',
+                'defaultValue': 2048,
+                'minValue': 0,
+                'maxValue': 2 ** 20
+            },
+            {
+                'name': 'interactiveMaxTextureResolution',
+                'ui_name': 'Interactive Max Texture Resolution',
+                'help': 'Textures are loaded at the first mip level that is not bigger than this resolution in interactive sessions. Batch renders always use full resolution textures.',
+                'defaultValue': 4096,
+                'minValue': 64,
+                'maxValue': 2 ** 16
+            }
+        ]
+    },
     {
         'name': 'UsdNativeCamera',
         'settings': [
@@ -32,7 +32,7 @@ void HdRprRenderBuffer::Sync(HdSceneDelegate* sceneDelegate,
     if (*dirtyBits & DirtyDescription) {
         // hdRpr has the background thread write directly into render buffers,
         // so we need to stop the render thread before reallocating them.
-        static_cast<HdRprRenderParam*>(renderParam)->AcquireRprApiForEdit();
+        static_cast<HdRprRenderParam*>(renderParam)->GetRenderThread()->StopRender();
     }
 
     HdRenderBuffer::Sync(sceneDelegate, renderParam, dirtyBits);
@@ -41,7 +41,7 @@ void HdRprRenderBuffer::Sync(HdSceneDelegate* sceneDelegate,
 void HdRprRenderBuffer::Finalize(HdRenderParam* renderParam) {
     // hdRpr has the background thread write directly into render buffers,
     // so we need to stop the render thread before reallocating them.
-    static_cast<HdRprRenderParam*>(renderParam)->AcquireRprApiForEdit();
+    static_cast<HdRprRenderParam*>(renderParam)->GetRenderThread()->StopRender();
 
     HdRenderBuffer::Finalize(renderParam);
 }
@@ -117,6 +117,11 @@ private:
 TF_DEFINE_PRIVATE_TOKENS(_tokens,
     (openvdbAsset) \
     (percentDone) \
+    (appliedCommands) \
+    (coalescedCommands) \
+    (pendingTextureLoads) \
+    (materialNodes) \
+    (sharedMaterialNodes) \
     (renderMode) \
     (batch) \
     (progressive)
@@ -394,6 +399,11 @@ VtDictionary HdRprDelegate::GetRenderStats() const {
         percentDone = std::max(percentDone, double(numPixels - numActivePixels) / numPixels);
     }
     stats[_tokens->percentDone.GetString()] = 100.0 * percentDone;
+    stats[_tokens->appliedCommands.GetString()] = m_rprApi->GetNumAppliedCommands();
+    stats[_tokens->coalescedCommands.GetString()] = m_rprApi->GetNumCoalescedCommands();
+    stats[_tokens->pendingTextureLoads.GetString()] = m_rprApi->GetNumPendingImageLoads();
+    stats[_tokens->materialNodes.GetString()] = m_rprApi->GetNumMaterialNodes();
+    stats[_tokens->sharedMaterialNodes.GetString()] = m_rprApi->GetNumSharedMaterialNodes();
     return stats;
 }
 
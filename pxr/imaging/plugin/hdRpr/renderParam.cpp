@@ -46,13 +46,13 @@ void HdRprRenderParam::NotifyVolumesAboutFieldChange(HdSceneDelegate* sceneDeleg
         auto& subscriptions = subscriptionsIt->second;
         for (size_t i = 0; i < subscriptions.size(); ++i) {
             if (auto volume = subscriptions[i].lock()) {
-                // Force HdVolume Sync
-                sceneDelegate->GetRenderIndex().GetChangeTracker().MarkRprimDirty(volume->GetId(), HdChangeTracker::DirtyTopology);
-
-                // Possible Optimization: notify volume about exact changed field
-                // Does not make sense right now because Hydra removes and creates
-                // from scratch all HdFields whenever one of them is changed (e.g added/removed/edited primvar)
-                // (USD 20.02)
+                if (subscriptionsIt->first == fieldId) {
+                    // Force HdVolume Sync of the changed field only
+                    // Hydra removes and creates from scratch all HdFields whenever one of them is changed (e.g added/removed/edited primvar)
+                    // (USD 20.02), so the volume checks itself whether the field really differs
+                    volume->MarkFieldDirty(fieldId);
+                    sceneDelegate->GetRenderIndex().GetChangeTracker().MarkRprimDirty(volume->GetId(), HdRprVolume::DirtyFields);
+                }
             } else {
                 std::swap(subscriptions[i], subscriptions.back());
                 subscriptions.pop_back();
@@ -43,10 +43,10 @@ public:
     ~HdRprRenderParam() override = default;
 
     HdRprApi const* GetRprApi() const { return m_rprApi; }
-    HdRprApi* AcquireRprApiForEdit() {
-        m_renderThread->StopRender();
-        return m_rprApi;
-    }
+
+    // The render thread is not stopped here. HdRprApi stops it on the first edit that modifies RPR objects,
+    // edits that are only recorded (e.g. shape transform or visibility) let the render thread keep sampling the current scene
+    HdRprApi* AcquireRprApiForEdit() { return m_rprApi; }
 
     HdRprRenderThread* GetRenderThread() { return m_renderThread; }
 
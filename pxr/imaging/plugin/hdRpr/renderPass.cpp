@@ -17,9 +17,16 @@ limitations under the License.
 #include "rprApi.h"
 #include "renderBuffer.h"
 #include "renderParam.h"
+#include "points.h"
+
+#ifdef USE_VOLUME
+#include "volume.h"
+#endif
 
 #include "pxr/imaging/hd/renderPassState.h"
 #include "pxr/imaging/hd/renderIndex.h"
+#include "pxr/imaging/hd/material.h"
+#include "pxr/imaging/hd/tokens.h"
 
 #include <GL/glew.h>
 
@@ -49,6 +56,17 @@ void HdRprRenderPass::_Execute(HdRenderPassStateSharedPtr const& renderPassState
         if (config->IsDirty(HdRprConfig::DirtyAll)) {
             stopRender = true;
         }
+        if (config->IsDirty(HdRprConfig::DirtyVolume) ||
+            config->IsDirty(HdRprConfig::DirtyRenderQuality)) {
+            MarkVolumesLodDirty();
+        }
+        if (config->IsDirty(HdRprConfig::DirtyTextures) &&
+            !static_cast<HdRprDelegate*>(GetRenderIndex()->GetRenderDelegate())->IsBatch()) {
+            MarkMaterialsDirty();
+        }
+        if (config->IsDirty(HdRprConfig::DirtyPoints)) {
+            MarkPointsProxyMeshDirty();
+        }
     }
     if (stopRender) {
         m_renderParam->GetRenderThread()->StopRender();
@@ -79,11 +97,50 @@ void HdRprRenderPass::_Execute(HdRenderPassStateSharedPtr const& renderPassState
                 rprRenderBuffer->SetConverged(false);
             }
         }
+
+        // Sync might record changes without stopping the render thread,
+        // restart it to apply them (no-op if it's already stopped)
+        m_renderParam->GetRenderThread()->StopRender();
         m_renderParam->GetRenderThread()->StartRender();
     }
 }
 
+void HdRprRenderPass::MarkVolumesLodDirty() {
+#ifdef USE_VOLUME
+    auto renderIndex = GetRenderIndex();
+    auto& changeTracker = renderIndex->GetChangeTracker();
+    for (auto& rprimId : renderIndex->GetRprimIds()) {
+        if (dynamic_cast<HdRprVolume const*>(renderIndex->GetRprim(rprimId))) {
+            changeTracker.MarkRprimDirty(rprimId, HdRprVolume::DirtyLod);
+        }
+    }
+#endif // USE_VOLUME
+}
+
+void HdRprRenderPass::MarkMaterialsDirty() {
+    auto renderIndex = GetRenderIndex();
+    auto& changeTracker = renderIndex->GetChangeTracker();
+    for (auto& materialId : renderIndex->GetSprimSubtree(HdPrimTypeTokens->material, SdfPath::AbsoluteRootPath())) {
+        changeTracker.MarkSprimDirty(materialId, HdMaterial::DirtyResource);
+    }
+}
+
+void HdRprRenderPass::MarkPointsProxyMeshDirty() {
+    auto renderIndex = GetRenderIndex();
+    auto& changeTracker = renderIndex->GetChangeTracker();
+    for (auto& rprimId : renderIndex->GetRprimIds()) {
+        if (dynamic_cast<HdRprPoints const*>(renderIndex->GetRprim(rprimId))) {
+            changeTracker.MarkRprimDirty(rprimId, HdRprPoints::DirtyProxyMesh);
+        }
+    }
+}
+
 bool HdRprRenderPass::IsConverged() const {
+    // Keep the viewport updating until all textures are in place
+    if (m_renderParam->GetRprApi()->GetNumPendingImageLoads() > 0) {
+        return false;
+    }
+
     for (auto& aovBinding : m_renderParam->GetRprApi()->GetAovBindings()) {
         if (aovBinding.renderBuffer &&
             !aovBinding.renderBuffer->IsConverged()) {
@@ -35,6 +35,14 @@ public:
     void _Execute(HdRenderPassStateSharedPtr const& renderPassState,
                   TfTokenVector const& renderTags) override;
 
+private:
+    // Level of detail of volumes depends on render settings
+    void MarkVolumesLodDirty();
+    // Resolution of material textures depends on render settings
+    void MarkMaterialsDirty();
+    // Points are rendered either as sphere instances or as a proxy mesh depending on render settings
+    void MarkPointsProxyMeshDirty();
+
 private:
     HdRprRenderParam* m_renderParam;
 };
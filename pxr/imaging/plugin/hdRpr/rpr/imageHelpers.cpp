@@ -22,41 +22,47 @@ limitations under the License.
 #ifdef ENABLE_RAT
 #include <IMG/IMG_File.h>
 #include <PXL/PXL_Raster.h>
+#include <SYS/fpreal16.h>
 #endif
 
+#include <algorithm>
 #include <cstring>
 #include <vector>
 #include <array>
 
 namespace rpr {
 
+#ifdef ENABLE_RAT
 namespace {
 
-ImageDesc GetRprImageDesc(ImageFormat format, uint32_t width, uint32_t height, uint32_t depth = 1) {
-    int bytesPerComponent = 1;
-    if (format.type == RPR_COMPONENT_TYPE_FLOAT16) {
-        bytesPerComponent = 2;
-    } else if (format.type == RPR_COMPONENT_TYPE_FLOAT32) {
-        bytesPerComponent = 4;
+/// Copies RAT raster flipping it in Y axis. When scale is bigger than one, each scale x scale block of pixels is averaged into one pixel
+template <typename T>
+void CopyRatPixels(uint8_t const* src, size_t srcStride, int numComponents, int scale, int width, int height, T* dst) {
+    for (int y = 0; y < height; ++y) {
+        auto dstRow = dst + size_t(height - 1 - y) * width * numComponents;
+        for (int x = 0; x < width; ++x) {
+            for (int c = 0; c < numComponents; ++c) {
+                float sum = 0.0f;
+                for (int by = 0; by < scale; ++by) {
+                    auto srcRow = reinterpret_cast<T const*>(src + srcStride * (y * scale + by));
+                    for (int bx = 0; bx < scale; ++bx) {
+                        sum += float(srcRow[(x * scale + bx) * numComponents + c]);
+                    }
+                }
+                dstRow[x * numComponents + c] = T(sum / float(scale * scale));
+            }
+        }
     }
-
-    ImageDesc desc = {};
-    desc.image_width = width;
-    desc.image_height = height;
-    desc.image_depth = depth;
-    desc.image_row_pitch = width * format.num_components * bytesPerComponent;
-    desc.image_slice_pitch = desc.image_row_pitch * height;
-
-    return desc;
 }
 
 } // namespace anonymous
+#endif // ENABLE_RAT
 
 Image* CreateImage(Context* context, uint32_t width, uint32_t height, ImageFormat format, void const* data, rpr::Status* status) {
-    return context->CreateImage(format, GetRprImageDesc(format, width, height), data, status);
+    return context->CreateImage(format, GetImageDesc(format, width, height), data, status);
 }
 
-Image* CreateImage(Context* context, char const* path, bool forceLinearSpace) {
+bool LoadImageData(char const* path, bool forceLinearSpace, uint32_t maxResolution, ImageData* imageData) {
     PXR_NAMESPACE_USING_DIRECTIVE
 
 #ifdef ENABLE_RAT
@@ -65,6 +71,7 @@ Image* CreateImage(Context* context, char const* path, bool forceLinearSpace) {
         auto ratImage = std::unique_ptr<IMG_File>(IMG_File::open(path));
         if (!ratImage) {
             TF_RUNTIME_ERROR("Failed to load image %s", path);
+            return false;
         }
 
         UT_Array<PXL_Raster*> images;
@@ -76,6 +83,7 @@ Image* CreateImage(Context* context, char const* path, bool forceLinearSpace) {
         if (!ratImage->readImages(images) ||
             images.isEmpty()) {
             TF_RUNTIME_ERROR("Failed to load image %s", path);
+            return false;
         }
 
         // XXX: use the only first image, find out what to do with other images
@@ -92,6 +100,7 @@ Image* CreateImage(Context* context, char const* path, bool forceLinearSpace) {
             format.num_components = 4;
         } else {
             TF_RUNTIME_ERROR("Failed to load image %s: unsupported RAT packing", path);
+            return false;
         }
 
         if (image->getFormat() == PXL_INT8) {
@@ -102,93 +111,168 @@ Image* CreateImage(Context* context, char const* path, bool forceLinearSpace) {
             format.type = RPR_COMPONENT_TYPE_FLOAT32;
         } else {
             TF_RUNTIME_ERROR("Failed to load image %s: unsupported RAT format", path);
+            return false;
         }
 
-        ImageDesc desc = GetRprImageDesc(format, image->getXres(), image->getYres());
-        if (desc.image_height < 1 ||
-            desc.image_width < 1) {
+        int width = image->getXres();
+        int height = image->getYres();
+        if (height < 1 ||
+            width < 1) {
             TF_RUNTIME_ERROR("Failed to load image %s: incorrect dimensions", path);
+            return false;
         }
+        size_t fullResolutionSize = size_t(image->getStride()) * height;
 
-        // RAT image is flipped in Y axis
-        std::vector<uint8_t> flippedImage;
-        flippedImage.reserve(image->getStride() * desc.image_height);
-        for (int y = 0; y < desc.image_height; ++y) {
-            auto srcData = reinterpret_cast<uint8_t*>(image->getPixels()) + image->getStride() * y;
-            auto dstData = &flippedImage[image->getStride() * (desc.image_height - 1 - y)];
-            std::memcpy(dstData, srcData, image->getStride());
+        // RAT files are read as a single level, emulate mip levels by averaging blocks of pixels
+        int scale = 1;
+        if (maxResolution) {
+            while (width > 1 && height > 1 &&
+                   uint32_t(std::max(width, height)) > maxResolution) {
+                width /= 2;
+                height /= 2;
+                scale *= 2;
+            }
         }
 
-        rpr::Status status;
-        auto rprImage = context->CreateImage(format, desc, flippedImage.data(), &status);
-        if (!rprImage) {
-            RPR_ERROR_CHECK(status, "Failed to create image from data", context);
-            return nullptr;
+        ImageDesc desc = GetImageDesc(format, width, height);
+
+        // RAT image is flipped in Y axis
+        auto srcPixels = reinterpret_cast<uint8_t const*>(image->getPixels());
+        std::shared_ptr<std::vector<uint8_t>> flippedImage;
+        if (scale == 1) {
+            flippedImage = std::make_shared<std::vector<uint8_t>>(image->getStride() * height);
+            for (int y = 0; y < height; ++y) {
+                auto srcData = srcPixels + image->getStride() * y;
+                auto dstData = &(*flippedImage)[image->getStride() * (height - 1 - y)];
+                std::memcpy(dstData, srcData, image->getStride());
+            }
+        } else {
+            flippedImage = std::make_shared<std::vector<uint8_t>>(desc.image_slice_pitch);
+            auto dstPixels = flippedImage->data();
+            if (format.type == RPR_COMPONENT_TYPE_UINT8) {
+                CopyRatPixels(srcPixels, image->getStride(), format.num_components, scale, width, height, dstPixels);
+            } else if (format.type == RPR_COMPONENT_TYPE_FLOAT16) {
+                CopyRatPixels(srcPixels, image->getStride(), format.num_components, scale, width, height, reinterpret_cast<fpreal16*>(dstPixels));
+            } else {
+                CopyRatPixels(srcPixels, image->getStride(), format.num_components, scale, width, height, reinterpret_cast<float*>(dstPixels));
+            }
         }
 
+        imageData->format = format;
+        imageData->desc = desc;
+        imageData->pixels = std::shared_ptr<void const>(flippedImage, flippedImage->data());
+        imageData->fullResolutionSize = fullResolutionSize;
+        imageData->gamma = 0.0f;
         if (!forceLinearSpace &&
             (image->getColorSpace() == PXL_CS_LINEAR ||
             image->getColorSpace() == PXL_CS_GAMMA2_2 || 
             image->getColorSpace() == PXL_CS_CUSTOM_GAMMA)) {
-            RPR_ERROR_CHECK(rprImage->SetGamma(image->getColorSpaceGamma()), "Failed to set image gamma", context);
+            imageData->gamma = image->getColorSpaceGamma();
         }
 
-        return rprImage;
+        return true;
     }
 #endif
 
-    if (GlfImage::IsSupportedImageFile(path)) {
-        auto textureData = GlfUVTextureData::New(path, INT_MAX, 0, 0, 0, 0);
-        if (textureData && textureData->Read(0, false)) {
-            ImageFormat format = {};
-            switch (textureData->GLType()) {
-            case GL_UNSIGNED_BYTE:
-                format.type = RPR_COMPONENT_TYPE_UINT8;
-                break;
-            case GL_HALF_FLOAT:
-                format.type = RPR_COMPONENT_TYPE_FLOAT16;
-                break;
-            case GL_FLOAT:
-                format.type = RPR_COMPONENT_TYPE_FLOAT32;
-                break;
-            default:
-                TF_RUNTIME_ERROR("Failed to create image %s. Unsupported pixel data GLtype: %#x", path, textureData->GLType());
-            }
+    if (!GlfImage::IsSupportedImageFile(path)) {
+        return false;
+    }
 
-            switch (textureData->GLFormat()) {
-            case GL_RED:
-                format.num_components = 1;
-                break;
-            case GL_RGB:
-                format.num_components = 3;
-                break;
-            case GL_RGBA:
-                format.num_components = 4;
-                break;
-            default:
-                TF_RUNTIME_ERROR("Failed to create image %s. Unsupported pixel data GLformat: %#x", path, textureData->GLFormat());
-            }
-            ImageDesc desc = GetRprImageDesc(format, textureData->ResizedWidth(), textureData->ResizedHeight());
+    auto image = GlfImage::OpenForReading(path);
+    if (!image) {
+        return false;
+    }
+    size_t fullResolutionSize = size_t(image->GetWidth()) * image->GetHeight() * image->GetBytesPerPixel();
 
-            rpr::Status status;
-            auto rprImage = context->CreateImage(format, desc, textureData->GetRawBuffer(), &status);
-            if (!rprImage) {
-                RPR_ERROR_CHECK(status, "Failed to create image from data", context);
-                return nullptr;
-            }
+    size_t targetMemory = INT_MAX;
+    if (maxResolution) {
+        // Size of the first mip level that fits into maxResolution
+        int width = image->GetWidth();
+        int height = image->GetHeight();
+        while (width > 1 && height > 1 &&
+               uint32_t(std::max(width, height)) > maxResolution) {
+            width /= 2;
+            height /= 2;
+        }
+        targetMemory = std::min(targetMemory, size_t(width) * height * image->GetBytesPerPixel());
+    }
+    image.reset();
 
-            auto internalFormat = textureData->GLInternalFormat();
-            if (!forceLinearSpace &&
-                (internalFormat == GL_SRGB ||
-                internalFormat == GL_SRGB8 ||
-                internalFormat == GL_SRGB_ALPHA ||
-                internalFormat == GL_SRGB8_ALPHA8)) {
-                // XXX(RPR): sRGB formula is different from straight pow decoding, but it's the best we can do right now
-                RPR_ERROR_CHECK(rprImage->SetGamma(2.2f), "Failed to set image gamma");
-            }
+    auto textureData = GlfUVTextureData::New(path, targetMemory, 0, 0, 0, 0);
+    if (!textureData || !textureData->Read(0, false)) {
+        return false;
+    }
 
-            return rprImage;
-        }
+    ImageFormat format = {};
+    switch (textureData->GLType()) {
+    case GL_UNSIGNED_BYTE:
+        format.type = RPR_COMPONENT_TYPE_UINT8;
+        break;
+    case GL_HALF_FLOAT:
+        format.type = RPR_COMPONENT_TYPE_FLOAT16;
+        break;
+    case GL_FLOAT:
+        format.type = RPR_COMPONENT_TYPE_FLOAT32;
+        break;
+    default:
+        TF_RUNTIME_ERROR("Failed to create image %s. Unsupported pixel data GLtype: %#x", path, textureData->GLType());
+        return false;
+    }
+
+    switch (textureData->GLFormat()) {
+    case GL_RED:
+        format.num_components = 1;
+        break;
+    case GL_RGB:
+        format.num_components = 3;
+        break;
+    case GL_RGBA:
+        format.num_components = 4;
+        break;
+    default:
+        TF_RUNTIME_ERROR("Failed to create image %s. Unsupported pixel data GLformat: %#x", path, textureData->GLFormat());
+        return false;
+    }
+
+    imageData->format = format;
+    imageData->desc = GetImageDesc(format, textureData->ResizedWidth(), textureData->ResizedHeight());
+    // Keep texture data alive as long as somebody references its pixels
+    imageData->pixels = std::shared_ptr<void const>(textureData->GetRawBuffer(), [textureData](void const*) {});
+    imageData->fullResolutionSize = fullResolutionSize;
+    imageData->gamma = 0.0f;
+
+    auto internalFormat = textureData->GLInternalFormat();
+    if (!forceLinearSpace &&
+        (internalFormat == GL_SRGB ||
+        internalFormat == GL_SRGB8 ||
+        internalFormat == GL_SRGB_ALPHA ||
+        internalFormat == GL_SRGB8_ALPHA8)) {
+        // XXX(RPR): sRGB formula is different from straight pow decoding, but it's the best we can do right now
+        imageData->gamma = 2.2f;
+    }
+
+    return true;
+}
+
+Image* CreateImage(Context* context, ImageData const& imageData) {
+    rpr::Status status;
+    auto rprImage = context->CreateImage(imageData.format, imageData.desc, imageData.pixels.get(), &status);
+    if (!rprImage) {
+        RPR_ERROR_CHECK(status, "Failed to create image from data", context);
+        return nullptr;
+    }
+
+    if (imageData.gamma != 0.0f) {
+        RPR_ERROR_CHECK(rprImage->SetGamma(imageData.gamma), "Failed to set image gamma", context);
+    }
+
+    return rprImage;
+}
+
+Image* CreateImage(Context* context, char const* path, bool forceLinearSpace) {
+    ImageData imageData;
+    if (LoadImageData(path, forceLinearSpace, 0, &imageData)) {
+        return CreateImage(context, imageData);
     }
 
     return context->CreateImageFromFile(path);
@@ -202,4 +286,22 @@ ImageDesc GetImageDesc(Image* image) {
     return GetInfo<ImageDesc>(image, RPR_IMAGE_DESC);
 }
 
+ImageDesc GetImageDesc(ImageFormat format, uint32_t width, uint32_t height, uint32_t depth) {
+    int bytesPerComponent = 1;
+    if (format.type == RPR_COMPONENT_TYPE_FLOAT16) {
+        bytesPerComponent = 2;
+    } else if (format.type == RPR_COMPONENT_TYPE_FLOAT32) {
+        bytesPerComponent = 4;
+    }
+
+    ImageDesc desc = {};
+    desc.image_width = width;
+    desc.image_height = height;
+    desc.image_depth = depth;
+    desc.image_row_pitch = width * format.num_components * bytesPerComponent;
+    desc.image_slice_pitch = desc.image_row_pitch * height;
+
+    return desc;
+}
+
 } // namespace rpr
@@ -16,13 +16,34 @@ limitations under the License.
 
 #include <RadeonProRender.hpp>
 
+#include <memory>
+
 namespace rpr {
 
+/// Decoded image that is ready to be uploaded to RPR
+struct ImageData {
+    ImageFormat format = {};
+    ImageDesc desc = {};
+    std::shared_ptr<void const> pixels;
+    // Gamma that should be set on the image, zero if the image is in linear space
+    float gamma = 0.0f;
+    // Size in bytes the image would take at full resolution
+    size_t fullResolutionSize = 0;
+};
+
+/// Decodes the image on the calling thread, does not touch RPR so it can be called from any thread.
+/// When maxResolution is non-zero, the image is loaded at the first mip level that fits into it.
+/// Mip levels are read from the file when it has them, otherwise the image is halved until it fits.
+/// Returns false if the image can't be decoded, CreateImageFromFile might still be able to load it.
+bool LoadImageData(char const* path, bool forceLinearSpace, uint32_t maxResolution, ImageData* imageData);
+Image* CreateImage(Context* context, ImageData const& imageData);
+
 Image* CreateImage(Context* context, char const* path, bool forceLinearSpace = false);
 Image* CreateImage(Context* context, uint32_t width, uint32_t height, ImageFormat format, void const* data, rpr::Status* status = nullptr);
 
 ImageFormat GetImageFormat(Image* image);
 ImageDesc GetImageDesc(Image* image);
+ImageDesc GetImageDesc(ImageFormat format, uint32_t width, uint32_t height, uint32_t depth = 1);
 
 } // namespace rpr
 
@@ -21,8 +21,10 @@ limitations under the License.
 
 #include "config.h"
 #include "camera.h"
+#include "debugCodes.h"
 #include "imageCache.h"
 #include "materialAdapter.h"
+#include "meshNormals.h"
 #include "renderDelegate.h"
 #include "renderBuffer.h"
 #include "renderParam.h"
@@ -31,6 +33,7 @@ limitations under the License.
 #include "pxr/base/gf/vec2f.h"
 #include "pxr/base/gf/rotation.h"
 #include "pxr/base/arch/fileSystem.h"
+#include "pxr/base/arch/hash.h"
 #include "pxr/base/plug/plugin.h"
 #include "pxr/base/plug/thisPlugin.h"
 #include "pxr/imaging/pxOsd/tokens.h"
@@ -39,6 +42,7 @@ limitations under the License.
 #include "pxr/usd/usdRender/tokens.h"
 #include "pxr/usd/usdGeom/tokens.h"
 #include "pxr/base/tf/envSetting.h"
+#include "pxr/base/work/loops.h"
 
 #include "rpr/contextHelpers.h"
 #include "rpr/imageHelpers.h"
@@ -52,6 +56,9 @@ limitations under the License.
 #include <fstream>
 #include <vector>
 #include <mutex>
+#include <atomic>
+#include <unordered_map>
+#include <unordered_set>
 
 #ifdef WIN32
 #include <shlobj_core.h>
@@ -77,7 +84,6 @@ TF_DEFINE_PRIVATE_TOKENS(HdRprAovTokens,
 namespace {
 
 using RecursiveLockGuard = std::lock_guard<std::recursive_mutex>;
-std::recursive_mutex g_rprAccessMutex;
 
 bool ArchCreateDirectory(const char* path) {
 #ifdef WIN32
@@ -93,6 +99,204 @@ struct RenderSetting {
     bool isDirty;
 };
 
+/// Records attach/detach requests of scene objects so that they can be committed into rpr::Scene in one go.
+/// Tracks which objects are attached to the scene, requests that match the committed state are dropped.
+template <typename T>
+class SceneEditQueue {
+public:
+    void Attach(T* object) { Push(object, true); }
+    void Detach(T* object) { Push(object, false); }
+
+    /// Drops pending request for the object and forgets it.
+    /// Returns true if the object is currently attached to the scene (i.e. it should be detached before deletion).
+    bool Erase(T* object) {
+        m_edits.erase(object);
+        return m_attached.erase(object) != 0;
+    }
+
+    /// Transfers the requested state of the object to its replacement.
+    /// The replacement is attached to the scene unless the object is detached or going to be detached.
+    /// Returns true if the object is currently attached to the scene.
+    bool Replace(T* object, T* replacement) {
+        bool isAttached = m_attached.count(object) != 0;
+        bool attachReplacement = isAttached;
+
+        auto it = m_edits.find(object);
+        if (it != m_edits.end()) {
+            attachReplacement = it->second;
+        }
+        Erase(object);
+
+        if (attachReplacement) {
+            Attach(replacement);
+        }
+        return isAttached;
+    }
+
+    bool IsEmpty() const { return m_edits.empty(); }
+
+    bool Commit(rpr::Scene* scene) {
+        if (m_edits.empty()) {
+            return false;
+        }
+
+        for (auto& edit : m_edits) {
+            if (edit.second) {
+                if (!RPR_ERROR_CHECK(scene->Attach(edit.first), "Failed to attach object to scene")) {
+                    m_attached.insert(edit.first);
+                }
+            } else {
+                if (!RPR_ERROR_CHECK(scene->Detach(edit.first), "Failed to detach object from scene")) {
+                    m_attached.erase(edit.first);
+                }
+            }
+        }
+        m_edits.clear();
+        return true;
+    }
+
+private:
+    void Push(T* object, bool attach) {
+        bool isAttached = m_attached.count(object) != 0;
+        if (attach == isAttached) {
+            // Cancels the opposite request if any
+            m_edits.erase(object);
+        } else {
+            m_edits[object] = attach;
+        }
+    }
+
+private:
+    // Requested states that differ from the committed ones
+    std::unordered_map<T*, bool> m_edits;
+    std::unordered_set<T*> m_attached;
+};
+
+/// Latest requested state of rpr::Shape. Changes are recorded during Sync and applied to RPR in Update.
+struct ShapeState {
+    enum DirtyBits : uint32_t {
+        Clean = 0,
+        DirtyTransform = 1 << 0,
+        DirtyMotion = 1 << 1,
+        DirtyVisibility = 1 << 2,
+        DirtyMaterial = 1 << 3,
+        DirtyId = 1 << 4,
+    };
+    // Values that are waiting to be applied
+    uint32_t dirtyBits = Clean;
+    // Values that were requested at least once
+    uint32_t validBits = Clean;
+
+    GfMatrix4f transform;
+    GfVec3f linearMotion;
+    GfVec3f scaleMotion;
+    GfVec3f rotateAxis;
+    float rotateAngle;
+
+    uint32_t visibilityMask;
+    uint32_t id;
+
+    HdRprApiMaterial const* material;
+    bool doublesided;
+    bool displacementEnabled;
+};
+
+struct ShapeMotion {
+    GfVec3f linearMotion;
+    GfVec3f scaleMotion;
+    GfVec3f rotateAxis;
+    float rotateAngle;
+};
+
+/// Mesh data in the form it was passed to RPR (except for points).
+/// Used to recreate the mesh with new vertices without reprocessing its topology.
+struct MeshData {
+    size_t numPoints;
+    VtVec3fArray normals;
+    VtIntArray normalIndexes;
+    VtVec2fArray uvs;
+    VtIntArray uvIndexes;
+    VtIntArray indexes;
+    VtIntArray vpf;
+    bool generatedNormals;
+};
+
+struct MeshGeometry {
+    VtVec3fArray points;
+    VtIntArray pointIndexes;
+    VtVec3fArray normals;
+    VtIntArray normalIndexes;
+    VtVec2fArray uvs;
+    VtIntArray uvIndexes;
+    VtIntArray vpf;
+    TfToken polygonWinding;
+
+    bool operator==(MeshGeometry const& rhs) const {
+        return polygonWinding == rhs.polygonWinding &&
+            vpf == rhs.vpf &&
+            pointIndexes == rhs.pointIndexes &&
+            points == rhs.points &&
+            normalIndexes == rhs.normalIndexes &&
+            normals == rhs.normals &&
+            uvIndexes == rhs.uvIndexes &&
+            uvs == rhs.uvs;
+    }
+};
+
+template <typename T>
+uint64_t HashArray(VtArray<T> const& array, uint64_t seed) {
+    return ArchHash64(reinterpret_cast<const char*>(array.cdata()), array.size() * sizeof(T), seed);
+}
+
+uint64_t HashMeshGeometry(MeshGeometry const& geometry) {
+    uint64_t hash = geometry.polygonWinding.Hash();
+    hash = HashArray(geometry.vpf, hash);
+    hash = HashArray(geometry.pointIndexes, hash);
+    hash = HashArray(geometry.points, hash);
+    hash = HashArray(geometry.normalIndexes, hash);
+    hash = HashArray(geometry.normals, hash);
+    hash = HashArray(geometry.uvIndexes, hash);
+    return HashArray(geometry.uvs, hash);
+}
+
+struct MeshPrototype {
+    MeshGeometry geometry;
+    uint64_t hash;
+    rpr::Shape* shape;
+    // Number of shapes that use prototype geometry: the prototype itself while it's not released plus all its instances
+    int numUsers;
+};
+
+struct MaterialPrototype {
+    MaterialAdapter adapter;
+    uint64_t hash;
+    // Materials with stale textures are not shared anymore
+    uint64_t imagesStateHash;
+    HdRprApiMaterial* material;
+    int numUsers;
+};
+
+std::vector<std::string> GetTexturePaths(MaterialAdapter const& materialAdapter) {
+    std::vector<std::string> paths;
+    for (auto& param : materialAdapter.GetTexRprParams()) {
+        paths.push_back(param.second.path);
+    }
+    for (auto& param : materialAdapter.GetNormalMapParams()) {
+        paths.push_back(param.second.texture.path);
+    }
+    if (!materialAdapter.GetDisplacementTexture().path.empty()) {
+        paths.push_back(materialAdapter.GetDisplacementTexture().path);
+    }
+    return paths;
+}
+
+size_t CountMaterialNodes(HdRprApiMaterial const* material) {
+    return size_t(material->rootMaterial != nullptr) +
+        size_t(material->twosidedNode != nullptr) +
+        size_t(material->displacementMaterial != nullptr) +
+        material->auxiliaryObjects.size();
+}
+
 } // namespace anonymous
 
 struct HdRprApiVolume {
@@ -104,6 +308,7 @@ struct HdRprApiVolume {
     std::unique_ptr<rpr::Shape> cubeMesh;
     std::unique_ptr<HdRprApiMaterial> cubeMeshMaterial;
     GfMatrix4f voxelsTransform;
+    GfVec3i gridSize;
 };
 
 struct HdRprApiEnvironmentLight {
@@ -138,12 +343,19 @@ public:
         //InitIfNeeded();
     }
 
+    void StopRenderForEdit() {
+        // Render thread does not hold m_rprAccessMutex while rendering, so it should be stopped before modification of RPR objects.
+        // Commands that are only recorded (see RecordShapeCommand) do not require it - they are applied on the next render start
+        auto rprRenderParam = static_cast<HdRprRenderParam*>(m_delegate->GetRenderParam());
+        rprRenderParam->GetRenderThread()->StopRender();
+    }
+
     void InitIfNeeded() {
         if (m_state != kStateUninitialized) {
             return;
         }
 
-        RecursiveLockGuard rprLock(g_rprAccessMutex);
+        RecursiveLockGuard rprLock(m_rprAccessMutex);
 
         if (m_state != kStateUninitialized) {
             return;
@@ -168,101 +380,86 @@ public:
     }
 
     rpr::Shape* CreateMesh(const VtVec3fArray& points, const VtIntArray& pointIndexes,
-                           VtVec3fArray normals, const VtIntArray& normalIndexes,
-                           VtVec2fArray uvs, const VtIntArray& uvIndexes,
-                           const VtIntArray& vpf, TfToken const& polygonWinding = HdTokens->rightHanded) {
+                           const VtVec3fArray& normals, const VtIntArray& normalIndexes,
+                           const VtVec2fArray& uvs, const VtIntArray& uvIndexes,
+                           const VtIntArray& vpf, TfToken const& polygonWinding = HdTokens->rightHanded,
+                           bool allowSharing = false) {
         if (!m_rprContext) {
             return nullptr;
         }
 
-        VtIntArray newIndexes, newVpf;
-        SplitPolygons(pointIndexes, vpf, newIndexes, newVpf);
-        ConvertIndices(&newIndexes, newVpf, polygonWinding);
+        std::unique_ptr<MeshPrototype> prototype;
+        if (allowSharing) {
+            prototype = make_unique<MeshPrototype>();
+            prototype->geometry = {points, pointIndexes, normals, normalIndexes, uvs, uvIndexes, vpf, polygonWinding};
+            prototype->hash = HashMeshGeometry(prototype->geometry);
+
+            RecursiveLockGuard rprLock(m_rprAccessMutex);
+            if (auto mesh = CreateSharedMeshInstance(*prototype)) {
+                return mesh;
+            }
+        }
+
+        MeshData meshData;
+        meshData.numPoints = points.size();
+        meshData.generatedNormals = false;
+        if (!SplitPolygons(vpf, polygonWinding,
+                           pointIndexes, normals.empty() ? VtIntArray() : normalIndexes, uvs.empty() ? VtIntArray() : uvIndexes,
+                           &meshData.vpf, &meshData.indexes, &meshData.normalIndexes, &meshData.uvIndexes)) {
+            TF_RUNTIME_ERROR("Failed to create mesh: face vertex counts do not match indices");
+            return nullptr;
+        }
 
-        VtIntArray newNormalIndexes;
         if (normals.empty()) {
             if (m_rprContextMetadata.pluginType == rpr::kPluginHybrid) {
                 // XXX (Hybrid): we need to generate geometry normals by ourself
-                normals.reserve(newVpf.size());
-                newNormalIndexes.clear();
-                newNormalIndexes.reserve(newIndexes.size());
-
-                size_t indicesOffset = 0u;
-                for (auto numVerticesPerFace : newVpf) {
-                    for (int i = 0; i < numVerticesPerFace; ++i) {
-                        newNormalIndexes.push_back(normals.size());
-                    }
-
-                    auto indices = &newIndexes[indicesOffset];
-                    indicesOffset += numVerticesPerFace;
-
-                    auto p0 = points[indices[0]];
-                    auto p1 = points[indices[1]];
-                    auto p2 = points[indices[2]];
-
-                    auto e0 = p0 - p1;
-                    auto e1 = p2 - p1;
-
-                    auto normal = GfCross(e1, e0);
-                    GfNormalize(&normal);
-                    normals.push_back(normal);
-                }
+                GenerateFaceNormals(points, &meshData);
             }
         } else {
-            if (!normalIndexes.empty()) {
-                SplitPolygons(normalIndexes, vpf, newNormalIndexes);
-                ConvertIndices(&newNormalIndexes, newVpf, polygonWinding);
-            } else {
-                newNormalIndexes = newIndexes;
+            meshData.normals = normals;
+            if (meshData.normalIndexes.empty()) {
+                meshData.normalIndexes = meshData.indexes;
             }
         }
 
-        VtIntArray newUvIndexes;
         if (uvs.empty()) {
             if (m_rprContextMetadata.pluginType == rpr::kPluginHybrid) {
-                newUvIndexes = newIndexes;
-                uvs = VtVec2fArray(points.size(), GfVec2f(0.0f));
+                meshData.uvIndexes = meshData.indexes;
+                meshData.uvs = VtVec2fArray(points.size(), GfVec2f(0.0f));
             }
         } else {
-            if (!uvIndexes.empty()) {
-                SplitPolygons(uvIndexes, vpf, newUvIndexes);
-                ConvertIndices(&newUvIndexes, newVpf, polygonWinding);
-            } else {
-                newUvIndexes = newIndexes;
+            meshData.uvs = uvs;
+            if (meshData.uvIndexes.empty()) {
+                meshData.uvIndexes = meshData.indexes;
             }
         }
 
-        auto normalIndicesData = !newNormalIndexes.empty() ? newNormalIndexes.data() : newIndexes.data();
-        if (normals.empty()) {
-            normalIndicesData = nullptr;
-        }
+        RecursiveLockGuard rprLock(m_rprAccessMutex);
 
-        auto uvIndicesData = !newUvIndexes.empty() ? newUvIndexes.data() : uvIndexes.data();
-        if (uvs.empty()) {
-            uvIndicesData = nullptr;
+        if (prototype) {
+            // Identical meshes are synced in parallel, one of them might have been registered while the lock was released
+            if (auto mesh = CreateSharedMeshInstance(*prototype)) {
+                return mesh;
+            }
         }
 
-        RecursiveLockGuard rprLock(g_rprAccessMutex);
-
-        rpr::Status status;
-        auto mesh = m_rprContext->CreateShape(
-            (rpr_float const*)points.data(), points.size(), sizeof(GfVec3f),
-            (rpr_float const*)(normals.data()), normals.size(), sizeof(GfVec3f),
-            (rpr_float const*)(uvs.data()), uvs.size(), sizeof(GfVec2f),
-            newIndexes.data(), sizeof(rpr_int),
-            normalIndicesData, sizeof(rpr_int),
-            uvIndicesData, sizeof(rpr_int),
-            newVpf.data(), newVpf.size(), &status);
+        auto mesh = CreateShape(points, meshData);
         if (!mesh) {
-            RPR_ERROR_CHECK(status, "Failed to create mesh");
             return nullptr;
         }
 
-        if (RPR_ERROR_CHECK(m_scene->Attach(mesh), "Failed to attach mesh to scene")) {
-            delete mesh;
-            return nullptr;
+        AttachToScene(mesh);
+        m_meshData.emplace(mesh, std::move(meshData));
+
+        if (prototype) {
+            prototype->shape = mesh;
+            prototype->numUsers = 1;
+            m_sharedMeshes.emplace(mesh, prototype.get());
+
+            auto hash = prototype->hash;
+            m_meshPrototypes.emplace(hash, std::move(prototype));
         }
-        m_dirtyFlags |= ChangeTracker::DirtyScene;
+
         return mesh;
     }
 
@@ -271,21 +468,146 @@ public:
             return nullptr;
         }
 
-        RecursiveLockGuard rprLock(g_rprAccessMutex);
+        RecursiveLockGuard rprLock(m_rprAccessMutex);
 
-        rpr::Status status;
-        auto mesh = m_rprContext->CreateShapeInstance(prototype, &status);
-        if (!mesh) {
-            RPR_ERROR_CHECK(status, "Failed to create mesh instance");
+        // Instances of a shared mesh are created directly from its prototype
+        auto sharedMeshIt = m_sharedMeshes.find(prototype);
+        if (sharedMeshIt != m_sharedMeshes.end()) {
+            return CreateMeshInstance(sharedMeshIt->second->shape, sharedMeshIt->second);
+        }
+
+        return CreateMeshInstance(prototype, nullptr);
+    }
+
+    void SetMeshInstances(rpr::Shape* prototypeMesh, std::vector<rpr::Shape*>* instances, size_t numSamples, float* timeSamples, VtMatrix4dArray const* transformSamples) {
+        if (!m_rprContext || numSamples == 0) {
+            return;
+        }
+
+        const size_t numInstances = transformSamples[0].size();
+        for (size_t i = 1; i < numSamples; ++i) {
+            if (transformSamples[i].size() != numInstances) {
+                TF_CODING_ERROR("Each time sample should have the transforms of all instances");
+                return;
+            }
+        }
+
+        ResizeMeshInstances(prototypeMesh, instances, numInstances);
+
+        auto& startTransforms = transformSamples[0];
+        auto& endTransforms = transformSamples[numSamples - 1];
+        auto& shapes = *instances;
+
+        std::vector<GfMatrix4f> transforms(shapes.size());
+        std::vector<ShapeMotion> motions(numSamples > 1 ? shapes.size() : 0);
+        WorkParallelForN(shapes.size(), [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                transforms[i] = GfMatrix4f(startTransforms[i]);
+                if (numSamples > 1) {
+                    // XXX (RPR): there is no way to sample all transforms via current RPR API
+                    auto& motion = motions[i];
+                    GetMotion(startTransforms[i], endTransforms[i], &motion.linearMotion, &motion.scaleMotion, &motion.rotateAxis, &motion.rotateAngle);
+                }
+            }
+        });
+
+        {
+            std::lock_guard<std::mutex> lock(m_sceneEditMutex);
+            for (size_t i = 0; i < shapes.size(); ++i) {
+                RecordTransformLocked(shapes[i], transforms[i]);
+                if (numSamples > 1) {
+                    RecordMotionLocked(shapes[i], motions[i]);
+                }
+            }
+        }
+        m_dirtyFlags |= ChangeTracker::DirtyScene;
+    }
+
+    void SetMeshInstances(rpr::Shape* prototypeMesh, std::vector<rpr::Shape*>* instances, VtMatrix4fArray const& transforms) {
+        if (!m_rprContext) {
+            return;
+        }
+
+        ResizeMeshInstances(prototypeMesh, instances, transforms.size());
+
+        {
+            std::lock_guard<std::mutex> lock(m_sceneEditMutex);
+            for (size_t i = 0; i < instances->size(); ++i) {
+                RecordTransformLocked((*instances)[i], transforms[i]);
+            }
+        }
+        m_dirtyFlags |= ChangeTracker::DirtyScene;
+    }
+
+    rpr::Shape* UpdateMeshPoints(rpr::Shape* mesh, VtVec3fArray const& points, VtVec3fArray const& normals, std::vector<rpr::Shape*>* instances) {
+        if (!m_rprContext) {
             return nullptr;
         }
 
-        if (RPR_ERROR_CHECK(m_scene->Attach(mesh), "Failed to attach mesh to scene")) {
-            delete mesh;
+        RecursiveLockGuard rprLock(m_rprAccessMutex);
+
+        auto meshDataIt = m_meshData.find(mesh);
+        if (meshDataIt == m_meshData.end() ||
+            meshDataIt->second.numPoints != points.size() ||
+            m_sharedMeshes.count(mesh)) {
             return nullptr;
         }
-        m_dirtyFlags |= ChangeTracker::DirtyScene;
-        return mesh;
+
+        auto meshData = meshDataIt->second;
+        if (meshData.generatedNormals) {
+            GenerateFaceNormals(points, &meshData);
+        } else if (!normals.empty()) {
+            if (normals.size() != meshData.normals.size()) {
+                return nullptr;
+            }
+            meshData.normals = normals;
+        }
+
+        // XXX (RPR): vertex buffers of existing mesh can not be modified, so the mesh is recreated from the already processed topology
+        auto newMesh = CreateShape(points, meshData);
+        if (!newMesh) {
+            return nullptr;
+        }
+
+        if (m_rprContextMetadata.pluginType != rpr::kPluginHybrid) {
+            size_t dummy;
+            int subdFactor;
+            if (!RPR_ERROR_CHECK(mesh->GetInfo(RPR_SHAPE_SUBDIVISION_FACTOR, sizeof(subdFactor), &subdFactor, &dummy), "Failed to query mesh subdivision factor") &&
+                subdFactor > 0) {
+                RPR_ERROR_CHECK(newMesh->SetSubdivisionFactor(subdFactor), "Failed to set mesh subdividion level");
+
+                rpr_subdiv_boundary_interfop_type interfopType;
+                if (!RPR_ERROR_CHECK(mesh->GetInfo(RPR_SHAPE_SUBDIVISION_BOUNDARYINTEROP, sizeof(interfopType), &interfopType, &dummy), "Failed to query mesh subdivision interfopType")) {
+                    RPR_ERROR_CHECK(newMesh->SetSubdivisionBoundaryInterop(interfopType), "Fail set mesh subdividion boundary");
+                }
+            }
+        }
+
+        ReplaceShape(mesh, newMesh);
+        m_meshData.erase(meshDataIt);
+        m_meshData.emplace(newMesh, std::move(meshData));
+
+        if (instances) {
+            for (auto& instance : *instances) {
+                if (!instance) {
+                    continue;
+                }
+
+                rpr::Status status;
+                auto newInstance = m_rprContext->CreateShapeInstance(newMesh, &status);
+                if (newInstance) {
+                    ReplaceShape(instance, newInstance);
+                } else {
+                    RPR_ERROR_CHECK(status, "Failed to create mesh instance");
+                    ReleaseFromScene(instance);
+                }
+                delete instance;
+                instance = newInstance;
+            }
+        }
+
+        delete mesh;
+        return newMesh;
     }
 
     void SetMeshRefineLevel(rpr::Shape* mesh, const int level) {
@@ -298,7 +620,12 @@ public:
             return;
         }
 
-        RecursiveLockGuard rprLock(g_rprAccessMutex);
+        RecursiveLockGuard rprLock(m_rprAccessMutex);
+
+        if (IsSharedMeshInstance(mesh)) {
+            // Subdivision settings are part of the geometry that is owned by the prototype
+            return;
+        }
 
         bool dirty = true;
 
@@ -328,7 +655,12 @@ public:
             RPR_SUBDIV_BOUNDARY_INTERFOP_TYPE_EDGE_AND_CORNER :
             RPR_SUBDIV_BOUNDARY_INTERFOP_TYPE_EDGE_ONLY;
 
-        RecursiveLockGuard rprLock(g_rprAccessMutex);
+        RecursiveLockGuard rprLock(m_rprAccessMutex);
+
+        if (IsSharedMeshInstance(mesh)) {
+            // Subdivision settings are part of the geometry that is owned by the prototype
+            return;
+        }
 
         bool dirty = true;
 
@@ -345,28 +677,47 @@ public:
     }
 
     void SetMeshMaterial(rpr::Shape* mesh, HdRprApiMaterial const* material, bool doublesided, bool displacementEnabled) {
-        RecursiveLockGuard rprLock(g_rprAccessMutex);
-        m_materialFactory->AttachMaterial(mesh, material, doublesided, displacementEnabled);
-        m_dirtyFlags |= ChangeTracker::DirtyScene;
+        RecordShapeCommand(mesh, ShapeState::DirtyMaterial,
+            [=](ShapeState const& state) {
+                return state.material == material &&
+                       state.doublesided == doublesided &&
+                       state.displacementEnabled == displacementEnabled;
+            },
+            [=](ShapeState* state) {
+                state->material = material;
+                state->doublesided = doublesided;
+                state->displacementEnabled = displacementEnabled;
+            });
+    }
+
+    void RequireUdimTiles(HdRprApiMaterial const* material, std::vector<uint32_t> const& tiles) {
+        RecursiveLockGuard rprLock(m_rprAccessMutex);
+        if (m_materialFactory->RequireUdimTiles(material, tiles)) {
+            m_dirtyFlags |= ChangeTracker::DirtyScene;
+        }
+    }
+
+    bool HasMissingUdimTiles(HdRprApiMaterial const* material, std::vector<uint32_t> const& tiles) {
+        RecursiveLockGuard rprLock(m_rprAccessMutex);
+        return m_materialFactory->HasMissingUdimTiles(material, tiles);
     }
 
     void SetCurveMaterial(rpr::Curve* curve, HdRprApiMaterial const* material) {
-        RecursiveLockGuard rprLock(g_rprAccessMutex);
+        RecursiveLockGuard rprLock(m_rprAccessMutex);
         m_materialFactory->AttachMaterial(curve, material);
         m_dirtyFlags |= ChangeTracker::DirtyScene;
     }
 
     void SetCurveVisibility(rpr::Curve* curve, uint32_t visibilityMask) {
-        RecursiveLockGuard rprLock(g_rprAccessMutex);
         if (m_rprContextMetadata.pluginType == rpr::kPluginHybrid) {
             // XXX (Hybrid): rprCurveSetVisibility not supported, emulate visibility using attach/detach
             if (visibilityMask) {
-                m_scene->Attach(curve);
+                AttachToScene(curve);
             } else {
-                m_scene->Detach(curve);
+                DetachFromScene(curve);
             }
-            m_dirtyFlags |= ChangeTracker::DirtyScene;
         } else {
+            RecursiveLockGuard rprLock(m_rprAccessMutex);
             RPR_ERROR_CHECK(curve->SetVisibilityFlag(RPR_CURVE_VISIBILITY_PRIMARY_ONLY_FLAG, visibilityMask & kVisiblePrimary), "Failed to set curve primary visibility");
             RPR_ERROR_CHECK(curve->SetVisibilityFlag(RPR_CURVE_VISIBILITY_SHADOW, visibilityMask & kVisibleShadow), "Failed to set curve shadow visibility");
             RPR_ERROR_CHECK(curve->SetVisibilityFlag(RPR_CURVE_VISIBILITY_REFLECTION, visibilityMask & kVisibleReflection), "Failed to set curve reflection visibility");
@@ -382,54 +733,69 @@ public:
 
     void Release(rpr::Curve* curve) {
         if (curve) {
-            RecursiveLockGuard rprLock(g_rprAccessMutex);
+            RecursiveLockGuard rprLock(m_rprAccessMutex);
 
-            if (!RPR_ERROR_CHECK(m_scene->Detach(curve), "Failed to detach curve from scene")) {
-                m_dirtyFlags |= ChangeTracker::DirtyScene;
-            };
+            ReleaseFromScene(curve);
             delete curve;
         }
     }
 
     void Release(rpr::Shape* shape) {
         if (shape) {
-            RecursiveLockGuard rprLock(g_rprAccessMutex);
+            RecursiveLockGuard rprLock(m_rprAccessMutex);
 
-            if (!RPR_ERROR_CHECK(m_scene->Detach(shape), "Failed to detach mesh from scene")) {
-                m_dirtyFlags |= ChangeTracker::DirtyScene;
-            };
-            delete shape;
+            ReleaseFromScene(shape);
+            m_meshData.erase(shape);
+
+            auto sharedMeshIt = m_sharedMeshes.find(shape);
+            if (sharedMeshIt == m_sharedMeshes.end()) {
+                delete shape;
+                return;
+            }
+
+            auto prototype = sharedMeshIt->second;
+            m_sharedMeshes.erase(sharedMeshIt);
+
+            if (shape != prototype->shape) {
+                delete shape;
+            } else if (prototype->numUsers > 1) {
+                // Instances still reference the prototype geometry, keep it detached from the scene until the last of them is released
+                m_materialFactory->AttachMaterial(shape, nullptr, false, false);
+            }
+
+            if (--prototype->numUsers == 0) {
+                delete prototype->shape;
+
+                auto range = m_meshPrototypes.equal_range(prototype->hash);
+                for (auto it = range.first; it != range.second; ++it) {
+                    if (it->second.get() == prototype) {
+                        m_meshPrototypes.erase(it);
+                        break;
+                    }
+                }
+            }
         }
     }
 
     void SetMeshVisibility(rpr::Shape* mesh, uint32_t visibilityMask) {
-        RecursiveLockGuard rprLock(g_rprAccessMutex);
         if (m_rprContextMetadata.pluginType == rpr::kPluginHybrid) {
             // XXX (Hybrid): rprShapeSetVisibility not supported, emulate visibility using attach/detach
             if (visibilityMask) {
-                m_scene->Attach(mesh);
+                AttachToScene(mesh);
             } else {
-                m_scene->Detach(mesh);
+                DetachFromScene(mesh);
             }
-            m_dirtyFlags |= ChangeTracker::DirtyScene;
         } else {
-            RPR_ERROR_CHECK(mesh->SetVisibilityFlag(RPR_SHAPE_VISIBILITY_PRIMARY_ONLY_FLAG, visibilityMask & kVisiblePrimary), "Failed to set mesh primary visibility");
-            RPR_ERROR_CHECK(mesh->SetVisibilityFlag(RPR_SHAPE_VISIBILITY_SHADOW, visibilityMask & kVisibleShadow), "Failed to set mesh shadow visibility");
-            RPR_ERROR_CHECK(mesh->SetVisibilityFlag(RPR_SHAPE_VISIBILITY_REFLECTION, visibilityMask & kVisibleReflection), "Failed to set mesh reflection visibility");
-            RPR_ERROR_CHECK(mesh->SetVisibilityFlag(RPR_SHAPE_VISIBILITY_REFRACTION, visibilityMask & kVisibleRefraction), "Failed to set mesh refraction visibility");
-            RPR_ERROR_CHECK(mesh->SetVisibilityFlag(RPR_SHAPE_VISIBILITY_TRANSPARENT, visibilityMask & kVisibleTransparent), "Failed to set mesh transparent visibility");
-            RPR_ERROR_CHECK(mesh->SetVisibilityFlag(RPR_SHAPE_VISIBILITY_DIFFUSE, visibilityMask & kVisibleDiffuse), "Failed to set mesh diffuse visibility");
-            RPR_ERROR_CHECK(mesh->SetVisibilityFlag(RPR_SHAPE_VISIBILITY_GLOSSY_REFLECTION, visibilityMask & kVisibleGlossyReflection), "Failed to set mesh glossyReflection visibility");
-            RPR_ERROR_CHECK(mesh->SetVisibilityFlag(RPR_SHAPE_VISIBILITY_GLOSSY_REFRACTION, visibilityMask & kVisibleGlossyRefraction), "Failed to set mesh glossyRefraction visibility");
-            RPR_ERROR_CHECK(mesh->SetVisibilityFlag(RPR_SHAPE_VISIBILITY_LIGHT, visibilityMask & kVisibleLight), "Failed to set mesh light visibility");
-
-            m_dirtyFlags |= ChangeTracker::DirtyScene;
+            RecordShapeCommand(mesh, ShapeState::DirtyVisibility,
+                [=](ShapeState const& state) { return state.visibilityMask == visibilityMask; },
+                [=](ShapeState* state) { state->visibilityMask = visibilityMask; });
         }
     }
 
     void SetMeshId(rpr::Shape* mesh, uint32_t id) {
-        RecursiveLockGuard rprLock(g_rprAccessMutex);
-        RPR_ERROR_CHECK(mesh->SetObjectID(id), "Failed to set mesh id");
+        RecordShapeCommand(mesh, ShapeState::DirtyId,
+            [=](ShapeState const& state) { return state.id == id; },
+            [=](ShapeState* state) { state->id = id; });
     }
 
     rpr::Curve* CreateCurve(VtVec3fArray const& points, VtIntArray const& indices, VtFloatArray const& radiuses, VtVec2fArray const& uvs, VtIntArray const& segmentPerCurve) {
@@ -454,7 +820,7 @@ public:
             creationFlags |= rpr::kCurveCreationFlagTapered;
         }
 
-        RecursiveLockGuard rprLock(g_rprAccessMutex);
+        RecursiveLockGuard rprLock(m_rprAccessMutex);
 
         rpr::Status status;
         auto curve = m_rprContext->CreateCurve(
@@ -466,11 +832,7 @@ public:
             return nullptr;
         }
 
-        if (RPR_ERROR_CHECK(m_scene->Attach(curve), "Failed to attach curve to scene")) {
-            delete curve;
-            return nullptr;
-        }
-        m_dirtyFlags |= ChangeTracker::DirtyScene;
+        AttachToScene(curve);
         return curve;
     }
 
@@ -480,7 +842,7 @@ public:
             return nullptr;
         }
 
-        RecursiveLockGuard rprLock(g_rprAccessMutex);
+        RecursiveLockGuard rprLock(m_rprAccessMutex);
 
         rpr::Status status;
         auto light = creator(&status);
@@ -540,7 +902,7 @@ public:
     }
 
     void SetDirectionalLightAttributes(rpr::DirectionalLight* light, GfVec3f const& color, float shadowSoftnessAngle) {
-        RecursiveLockGuard rprLock(g_rprAccessMutex);
+        RecursiveLockGuard rprLock(m_rprAccessMutex);
 
         RPR_ERROR_CHECK(light->SetRadiantPower(color[0], color[1], color[2]), "Failed to set directional light color");
         RPR_ERROR_CHECK(light->SetShadowSoftnessAngle(GfClamp(shadowSoftnessAngle, 0.0f, float(M_PI_4))), "Failed to set directional light color");
@@ -548,14 +910,14 @@ public:
 
     template <typename Light>
     void SetLightColor(Light* light, GfVec3f const& color) {
-        RecursiveLockGuard rprLock(g_rprAccessMutex);
+        RecursiveLockGuard rprLock(m_rprAccessMutex);
 
         RPR_ERROR_CHECK(light->SetRadiantPower(color[0], color[1], color[2]), "Failed to set light color");
     }
 
     void Release(rpr::Light* light) {
         if (light) {
-            RecursiveLockGuard rprLock(g_rprAccessMutex);
+            RecursiveLockGuard rprLock(m_rprAccessMutex);
 
             if (!RPR_ERROR_CHECK(m_scene->Detach(light), "Failed to detach light from scene")) {
                 m_dirtyFlags |= ChangeTracker::DirtyScene;
@@ -600,7 +962,7 @@ public:
 
     void Release(HdRprApiEnvironmentLight* envLight) {
         if (envLight) {
-            RecursiveLockGuard rprLock(g_rprAccessMutex);
+            RecursiveLockGuard rprLock(m_rprAccessMutex);
 
             rpr::Status status;
             if (envLight->state == HdRprApiEnvironmentLight::kAttachedAsEnvLight) {
@@ -621,7 +983,7 @@ public:
             return nullptr;
         }
 
-        RecursiveLockGuard rprLock(g_rprAccessMutex);
+        RecursiveLockGuard rprLock(m_rprAccessMutex);
 
         auto image = std::unique_ptr<rpr::Image>(rpr::CreateImage(m_rprContext.get(), path.c_str()));
         if (!image) {
@@ -652,12 +1014,20 @@ public:
     }
 
     void SetTransform(rpr::SceneObject* object, GfMatrix4f const& transform) {
-        RecursiveLockGuard rprLock(g_rprAccessMutex);
+        RecursiveLockGuard rprLock(m_rprAccessMutex);
         if (!RPR_ERROR_CHECK(object->SetTransform(transform.GetArray(), false), "Fail set object transform")) {
             m_dirtyFlags |= ChangeTracker::DirtyScene;
         }
     }
 
+    void SetTransform(rpr::Shape* shape, GfMatrix4f const& transform) {
+        {
+            std::lock_guard<std::mutex> lock(m_sceneEditMutex);
+            RecordTransformLocked(shape, transform);
+        }
+        m_dirtyFlags |= ChangeTracker::DirtyScene;
+    }
+
     void DecomposeTransform(GfMatrix4d const& transform, GfVec3f& scale, GfQuatf& orient, GfVec3f& translate) {
         translate = GfVec3f(transform.ExtractTranslation());
 
@@ -765,46 +1135,159 @@ public:
         auto& startTransform = transformSamples[0];
         auto& endTransform = transformSamples[numSamples - 1];
 
-        GfVec3f linearMotion, scaleMotion, rotateAxis;
-        float rotateAngle;
-        GetMotion(startTransform, endTransform, &linearMotion, &scaleMotion, &rotateAxis, &rotateAngle);
+        ShapeMotion motion;
+        GetMotion(startTransform, endTransform, &motion.linearMotion, &motion.scaleMotion, &motion.rotateAxis, &motion.rotateAngle);
+
+        {
+            std::lock_guard<std::mutex> lock(m_sceneEditMutex);
+            RecordTransformLocked(shape, GfMatrix4f(startTransform));
+            RecordMotionLocked(shape, motion);
+        }
+        m_dirtyFlags |= ChangeTracker::DirtyScene;
+    }
+
+    HdRprApiMaterial* CreateMaterial(const MaterialAdapter& materialAdapter) {
+        if (!m_rprContext) {
+            return nullptr;
+        }
 
-        auto rprStartTransform = GfMatrix4f(startTransform);
+        // Materials with identical node graphs share the same RPR material
+        auto hash = materialAdapter.GetHash();
 
-        RecursiveLockGuard rprLock(g_rprAccessMutex);
+        RecursiveLockGuard rprLock(m_rprAccessMutex);
 
-        RPR_ERROR_CHECK(shape->SetTransform(rprStartTransform.GetArray(), false), "Fail set shape transform");
-        RPR_ERROR_CHECK(shape->SetLinearMotion(linearMotion[0], linearMotion[1], linearMotion[2]), "Fail to set shape linear motion");
-        RPR_ERROR_CHECK(shape->SetScaleMotion(scaleMotion[0], scaleMotion[1], scaleMotion[2]), "Fail to set shape scale motion");
-        RPR_ERROR_CHECK(shape->SetAngularMotion(rotateAxis[0], rotateAxis[1], rotateAxis[2], rotateAngle), "Fail to set shape angular motion");
-        m_dirtyFlags |= ChangeTracker::DirtyScene;
+        auto imagesStateHash = m_imageCache->GetImagesStateHash(GetTexturePaths(materialAdapter));
+        if (auto prototype = FindMaterialPrototype(hash, imagesStateHash, materialAdapter)) {
+            prototype->numUsers++;
+            m_numSharedMaterialNodes += CountMaterialNodes(prototype->material);
+            return prototype->material;
+        }
+
+        auto material = m_materialFactory->CreateMaterial(materialAdapter.GetType(), materialAdapter);
+        if (!material) {
+            return nullptr;
+        }
+        m_numMaterialNodes += CountMaterialNodes(material);
+
+        auto prototype = std::unique_ptr<MaterialPrototype>(new MaterialPrototype{materialAdapter, hash, imagesStateHash, material, 1});
+        m_sharedMaterials.emplace(material, prototype.get());
+        m_materialPrototypes.emplace(hash, std::move(prototype));
+
+        return material;
     }
 
-    HdRprApiMaterial* CreateMaterial(const MaterialAdapter& MaterialAdapter) {
+    HdRprApiMaterial* UpdateMaterial(HdRprApiMaterial* material, MaterialAdapter const& materialAdapter) {
         if (!m_rprContext) {
             return nullptr;
         }
 
-        RecursiveLockGuard rprLock(g_rprAccessMutex);
-        return m_materialFactory->CreateMaterial(MaterialAdapter.GetType(), MaterialAdapter);
+        auto hash = materialAdapter.GetHash();
+
+        RecursiveLockGuard rprLock(m_rprAccessMutex);
+
+        auto sharedMaterialIt = m_sharedMaterials.find(material);
+        if (sharedMaterialIt != m_sharedMaterials.end()) {
+            auto prototype = sharedMaterialIt->second;
+
+            // Materials are re-synced when textures should be reloaded (e.g. max texture resolution changed),
+            // keep the nodes only if their images are still up to date
+            auto imagesStateHash = m_imageCache->GetImagesStateHash(GetTexturePaths(materialAdapter));
+            bool isUpToDate = prototype->imagesStateHash == imagesStateHash;
+            if (isUpToDate && prototype->hash == hash && prototype->adapter == materialAdapter) {
+                return material;
+            }
+
+            // The material can be modified in place only if nobody else uses it and there is no equal material to share
+            if (isUpToDate && prototype->numUsers == 1 && !FindMaterialPrototype(hash, imagesStateHash, materialAdapter) &&
+                m_materialFactory->UpdateMaterial(material, prototype->adapter, materialAdapter)) {
+                auto range = m_materialPrototypes.equal_range(prototype->hash);
+                for (auto it = range.first; it != range.second; ++it) {
+                    if (it->second.get() == prototype) {
+                        auto prototypePtr = std::move(it->second);
+                        m_materialPrototypes.erase(it);
+
+                        prototypePtr->adapter = materialAdapter;
+                        prototypePtr->hash = hash;
+                        m_materialPrototypes.emplace(hash, std::move(prototypePtr));
+                        break;
+                    }
+                }
+
+                m_dirtyFlags |= ChangeTracker::DirtyScene;
+                return material;
+            }
+        }
+
+        // The previous material might still be attached to the shapes, release it after the new one is created
+        auto newMaterial = CreateMaterial(materialAdapter);
+        Release(material);
+        return newMaterial;
     }
 
-    HdRprApiMaterial* CreatePointsMaterial(VtVec3fArray const& colors) {
+    HdRprApiMaterial* CreatePointsMaterial(VtVec3fArray const& colors, bool indexByUV) {
         if (!m_rprContext) {
             return nullptr;
         }
 
-        RecursiveLockGuard rprLock(g_rprAccessMutex);
-        return m_materialFactory->CreatePointsMaterial(colors);
+        RecursiveLockGuard rprLock(m_rprAccessMutex);
+        auto material = m_materialFactory->CreatePointsMaterial(colors, indexByUV);
+        if (material) {
+            m_numMaterialNodes += CountMaterialNodes(material);
+        }
+        return material;
     }
 
     void Release(HdRprApiMaterial* material) {
         if (material) {
-            RecursiveLockGuard rprLock(g_rprAccessMutex);
+            RecursiveLockGuard rprLock(m_rprAccessMutex);
+
+            auto sharedMaterialIt = m_sharedMaterials.find(material);
+            if (sharedMaterialIt != m_sharedMaterials.end()) {
+                auto prototype = sharedMaterialIt->second;
+                if (--prototype->numUsers > 0) {
+                    m_numSharedMaterialNodes -= CountMaterialNodes(material);
+                    return;
+                }
+
+                m_sharedMaterials.erase(sharedMaterialIt);
+                auto range = m_materialPrototypes.equal_range(prototype->hash);
+                for (auto it = range.first; it != range.second; ++it) {
+                    if (it->second.get() == prototype) {
+                        m_materialPrototypes.erase(it);
+                        break;
+                    }
+                }
+            }
+            m_numMaterialNodes -= CountMaterialNodes(material);
+
+            {
+                std::lock_guard<std::mutex> lock(m_sceneEditMutex);
+
+                // Pending commands might reference the material, apply them while it's still alive
+                CommitShapeCommands();
+
+                // Memory of the released material can be reused by a new one,
+                // make sure that next SetMeshMaterial with the same pointer will not be dropped
+                for (auto& entry : m_shapeStates) {
+                    if (entry.second.material == material) {
+                        entry.second.validBits &= ~ShapeState::DirtyMaterial;
+                    }
+                }
+            }
             m_materialFactory->Release(material);
         }
     }
 
+    MaterialPrototype* FindMaterialPrototype(uint64_t hash, uint64_t imagesStateHash, MaterialAdapter const& materialAdapter) {
+        auto range = m_materialPrototypes.equal_range(hash);
+        for (auto it = range.first; it != range.second; ++it) {
+            if (it->second->imagesStateHash == imagesStateHash && it->second->adapter == materialAdapter) {
+                return it->second.get();
+            }
+        }
+        return nullptr;
+    }
+
     HdRprApiVolume* CreateVolume(VtUIntArray const& densityCoords, VtFloatArray const& densityValues, VtVec3fArray const& densityLUT, float densityScale,
                                  VtUIntArray const& albedoCoords, VtFloatArray const& albedoValues, VtVec3fArray const& albedoLUT, float albedoScale,
                                  VtUIntArray const& emissionCoords, VtFloatArray const& emissionValues, VtVec3fArray const& emissionLUT, float emissionScale,
@@ -813,13 +1296,13 @@ public:
             return nullptr;
         }
 
-        RecursiveLockGuard rprLock(g_rprAccessMutex);
+        RecursiveLockGuard rprLock(m_rprAccessMutex);
 
         auto rprApiVolume = new HdRprApiVolume;
 
         MaterialAdapter matAdapter(EMaterialType::TRANSPERENT,
             MaterialParams{{HdPrimvarRoleTokens->color, VtValue(GfVec4f(1.0f))}});
-        rprApiVolume->cubeMeshMaterial.reset(CreateMaterial(matAdapter));
+        rprApiVolume->cubeMeshMaterial.reset(m_materialFactory->CreateMaterial(matAdapter.GetType(), matAdapter));
         rprApiVolume->cubeMesh.reset(CreateCubeMesh(1.0f, 1.0f, 1.0f));
 
         rpr::Status densityGridStatus;
@@ -856,17 +1339,21 @@ public:
             RPR_ERROR_CHECK(rprApiVolume->heteroVolume->SetEmissionLookup((float*)emissionLUT.data(), emissionLUT.size()), "Failed to set emission volume lookup values") ||
             RPR_ERROR_CHECK(rprApiVolume->heteroVolume->SetEmissionScale(emissionScale), "Failed to set volume's emission scale") ||
 
-            RPR_ERROR_CHECK(rprApiVolume->cubeMesh->SetHeteroVolume(rprApiVolume->heteroVolume.get()), "Failed to set hetero volume to mesh") ||
-            RPR_ERROR_CHECK(m_scene->Attach(rprApiVolume->heteroVolume.get()), "Failed attach hetero volume")) {
+            RPR_ERROR_CHECK(rprApiVolume->cubeMesh->SetHeteroVolume(rprApiVolume->heteroVolume.get()), "Failed to set hetero volume to mesh")) {
 
             RPR_ERROR_CHECK(densityGridStatus, "Failed to create density grid");
             RPR_ERROR_CHECK(albedoGridStatus, "Failed to create albedo grid");
             RPR_ERROR_CHECK(emissionGridStatus, "Failed to create emission grid");
             RPR_ERROR_CHECK(status, "Failed to create hetero volume");
+            if (rprApiVolume->cubeMesh) {
+                ReleaseFromScene(rprApiVolume->cubeMesh.get());
+            }
             delete rprApiVolume;
             return nullptr;
         }
 
+        AttachToScene(rprApiVolume->heteroVolume.get());
+
         HdRprApi::VolumeMaterialParameters defaultVolumeMaterialParams;
         if (defaultVolumeMaterialParams.transmissionColor != materialParams.transmissionColor ||
             defaultVolumeMaterialParams.scatteringColor != materialParams.scatteringColor ||
@@ -894,6 +1381,7 @@ public:
         }
         SetMeshMaterial(rprApiVolume->cubeMesh.get(), rprApiVolume->cubeMeshMaterial.get(), true, false);
 
+        rprApiVolume->gridSize = gridSize;
         rprApiVolume->voxelsTransform = GfMatrix4f(1.0f);
         rprApiVolume->voxelsTransform.SetScale(GfCompMult(voxelSize, gridSize));
         rprApiVolume->voxelsTransform.SetTranslateOnly(GfCompMult(voxelSize, GfVec3f(gridSize)) / 2.0f + gridBBLow);
@@ -901,10 +1389,50 @@ public:
         return rprApiVolume;
     }
 
+    void SetVolumeGrid(HdRprApiVolume* volume, HdRprApi::VolumeGridType type, VtUIntArray const& coords, VtFloatArray const& values, VtVec3fArray const& LUT, float scale) {
+        RecursiveLockGuard rprLock(m_rprAccessMutex);
+
+        auto& gridSize = volume->gridSize;
+        rpr::Status status;
+        std::unique_ptr<rpr::Grid> grid(m_rprContext->CreateGrid(gridSize[0], gridSize[1], gridSize[2],
+            &coords[0], coords.size() / 3, RPR_GRID_INDICES_TOPOLOGY_XYZ_U32,
+            &values[0], values.size() * sizeof(values[0]), 0, &status));
+        if (!grid) {
+            RPR_ERROR_CHECK(status, "Failed to create volume grid");
+            return;
+        }
+
+        auto heteroVolume = volume->heteroVolume.get();
+        if (type == HdRprApi::kVolumeGridDensity) {
+            if (RPR_ERROR_CHECK(heteroVolume->SetDensityGrid(grid.get()), "Failed to set density hetero volume grid") ||
+                RPR_ERROR_CHECK(heteroVolume->SetDensityLookup((float*)LUT.data(), LUT.size()), "Failed to set density volume lookup values") ||
+                RPR_ERROR_CHECK(heteroVolume->SetDensityScale(scale), "Failed to set volume's density scale")) {
+                return;
+            }
+            volume->densityGrid = std::move(grid);
+        } else if (type == HdRprApi::kVolumeGridAlbedo) {
+            if (RPR_ERROR_CHECK(heteroVolume->SetAlbedoGrid(grid.get()), "Failed to set albedo hetero volume grid") ||
+                RPR_ERROR_CHECK(heteroVolume->SetAlbedoLookup((float*)LUT.data(), LUT.size()), "Failed to set albedo volume lookup values") ||
+                RPR_ERROR_CHECK(heteroVolume->SetAlbedoScale(scale), "Failed to set volume's albedo scale")) {
+                return;
+            }
+            volume->albedoGrid = std::move(grid);
+        } else if (type == HdRprApi::kVolumeGridEmission) {
+            if (RPR_ERROR_CHECK(heteroVolume->SetEmissionGrid(grid.get()), "Failed to set emission hetero volume grid") ||
+                RPR_ERROR_CHECK(heteroVolume->SetEmissionLookup((float*)LUT.data(), LUT.size()), "Failed to set emission volume lookup values") ||
+                RPR_ERROR_CHECK(heteroVolume->SetEmissionScale(scale), "Failed to set volume's emission scale")) {
+                return;
+            }
+            volume->emissionGrid = std::move(grid);
+        }
+
+        m_dirtyFlags |= ChangeTracker::DirtyScene;
+    }
+
     void SetTransform(HdRprApiVolume* volume, GfMatrix4f const& transform) {
         auto t = transform * volume->voxelsTransform;
 
-        RecursiveLockGuard rprLock(g_rprAccessMutex);
+        RecursiveLockGuard rprLock(m_rprAccessMutex);
         RPR_ERROR_CHECK(volume->cubeMesh->SetTransform(t.data(), false), "Failed to set cubeMesh transform");
         RPR_ERROR_CHECK(volume->heteroVolume->SetTransform(t.data(), false), "Failed to set heteroVolume transform");
         m_dirtyFlags |= ChangeTracker::DirtyScene;
@@ -912,12 +1440,11 @@ public:
 
     void Release(HdRprApiVolume* volume) {
         if (volume) {
-            RecursiveLockGuard rprLock(g_rprAccessMutex);
+            RecursiveLockGuard rprLock(m_rprAccessMutex);
 
-            m_scene->Detach(volume->heteroVolume.get());
+            ReleaseFromScene(volume->heteroVolume.get());
+            ReleaseFromScene(volume->cubeMesh.get());
             delete volume;
-
-            m_dirtyFlags |= ChangeTracker::DirtyScene;
         }
     }
 
@@ -928,7 +1455,7 @@ public:
             return;
         }
 
-        RecursiveLockGuard rprLock(g_rprAccessMutex);
+        RecursiveLockGuard rprLock(m_rprAccessMutex);
 
         if (m_hdCamera != hdRprCamera) {
             m_hdCamera = hdRprCamera;
@@ -953,14 +1480,14 @@ public:
     }
 
     void SetViewportSize(GfVec2i const& size) {
-        RecursiveLockGuard rprLock(g_rprAccessMutex);
+        RecursiveLockGuard rprLock(m_rprAccessMutex);
 
         m_viewportSize = size;
         m_dirtyFlags |= ChangeTracker::DirtyViewport;
     }
 
     void SetAovBindings(HdRenderPassAovBindingVector const& aovBindings) {
-        RecursiveLockGuard rprLock(g_rprAccessMutex);
+        RecursiveLockGuard rprLock(m_rprAccessMutex);
 
         m_aovBindings = aovBindings;
         m_dirtyFlags |= ChangeTracker::DirtyAOVBindings;
@@ -993,9 +1520,23 @@ public:
     }
 
     void Update() {
-        RecursiveLockGuard rprLock(g_rprAccessMutex);
+        RecursiveLockGuard rprLock(m_rprAccessMutex);
+
+        CommitSceneEdits();
 
         m_imageCache->GarbageCollectIfNeeded();
+        if (m_imageCache->CommitLoadedImages()) {
+            m_dirtyFlags |= ChangeTracker::DirtyScene;
+        }
+        if (TfDebug::IsEnabled(HD_RPR_DEBUG_IMAGE_CACHE)) {
+            auto stats = m_imageCache->GetStatistics();
+            TF_DEBUG(HD_RPR_DEBUG_IMAGE_CACHE).Msg("Image cache: %zu images, memory usage: %zu/%zu bytes (%zu bytes saved by reduced resolution), hits: %zu, misses: %zu, evictions: %zu\n",
+                stats.numImages, stats.memoryUsage, stats.memoryBudget, stats.memorySaved, stats.numHits, stats.numMisses, stats.numEvictions);
+
+            auto diskStats = m_imageCache->GetDiskCacheStatistics();
+            TF_DEBUG(HD_RPR_DEBUG_IMAGE_CACHE).Msg("Texture disk cache: size: %zu/%zu bytes, hits: %zu, misses: %zu, writes: %zu, pruned files: %zu\n",
+                diskStats.size, diskStats.maxSize, diskStats.numHits, diskStats.numMisses, diskStats.numWrites, diskStats.numPrunedFiles);
+        }
 
         auto rprRenderParam = static_cast<HdRprRenderParam*>(m_delegate->GetRenderParam());
 
@@ -1080,6 +1621,16 @@ public:
         UpdateAovs(rprRenderParam, enableDenoise, tonemap, clearAovs);
 
         m_dirtyFlags = ChangeTracker::Clean;
+        {
+            // Sync does not stop the render thread for recorded edits, so new ones could arrive during Update
+            std::lock_guard<std::mutex> lock(m_sceneEditMutex);
+            if (!m_dirtyShapes.empty() ||
+                !m_shapeEdits.IsEmpty() ||
+                !m_curveEdits.IsEmpty() ||
+                !m_heteroVolumeEdits.IsEmpty()) {
+                m_dirtyFlags |= ChangeTracker::DirtyScene;
+            }
+        }
         if (m_hdCamera) {
             m_hdCamera->CleanDirtyBits();
         }
@@ -1150,6 +1701,12 @@ public:
             }
         }
 
+        if (preferences.IsDirty(HdRprConfig::DirtyTextures) || force) {
+            m_imageCache->SetMemoryBudget(size_t(preferences.GetTextureCacheSize()) * 1024 * 1024);
+            // Batch renders always use full resolution textures
+            m_imageCache->SetMaxResolution(m_delegate->IsBatch() ? 0 : preferences.GetInteractiveMaxTextureResolution());
+        }
+
         m_currentRenderQuality = preferences.GetRenderQuality();
 
         if (m_rprContextMetadata.pluginType == rpr::kPluginTahoe) {
@@ -1544,6 +2101,26 @@ Don't show this message again?
         return m_activePixels;
     }
 
+    size_t GetNumAppliedCommands() const {
+        return m_numAppliedCommands;
+    }
+
+    size_t GetNumCoalescedCommands() const {
+        return m_numCoalescedCommands;
+    }
+
+    size_t GetNumMaterialNodes() const {
+        return m_numMaterialNodes;
+    }
+
+    size_t GetNumSharedMaterialNodes() const {
+        return m_numSharedMaterialNodes;
+    }
+
+    size_t GetNumPendingImageLoads() const {
+        return m_imageCache ? m_imageCache->GetNumPendingLoads() : 0;
+    }
+
     bool IsCameraChanged() const {
         if (!m_hdCamera) {
             return false;
@@ -1554,7 +2131,8 @@ Don't show this message again?
 
     bool IsChanged() const {
         if (m_dirtyFlags != ChangeTracker::Clean ||
-            IsCameraChanged()) {
+            IsCameraChanged() ||
+            (m_imageCache && m_imageCache->HasLoadedImages())) {
             return true;
         }
 
@@ -1593,6 +2171,147 @@ Don't show this message again?
     }
 
 private:
+    // Must be called under m_rprAccessMutex
+    rpr::Shape* CreateShape(VtVec3fArray const& points, MeshData const& meshData) {
+        rpr::Status status;
+        auto mesh = m_rprContext->CreateShape(
+            (rpr_float const*)points.cdata(), points.size(), sizeof(GfVec3f),
+            (rpr_float const*)meshData.normals.cdata(), meshData.normals.size(), sizeof(GfVec3f),
+            (rpr_float const*)meshData.uvs.cdata(), meshData.uvs.size(), sizeof(GfVec2f),
+            meshData.indexes.cdata(), sizeof(rpr_int),
+            meshData.normals.empty() ? nullptr : meshData.normalIndexes.cdata(), sizeof(rpr_int),
+            meshData.uvs.empty() ? nullptr : meshData.uvIndexes.cdata(), sizeof(rpr_int),
+            meshData.vpf.cdata(), meshData.vpf.size(), &status);
+        if (!mesh) {
+            RPR_ERROR_CHECK(status, "Failed to create mesh");
+            return nullptr;
+        }
+        return mesh;
+    }
+
+    void GenerateFaceNormals(VtVec3fArray const& points, MeshData* meshData) {
+        HdRprComputeFaceNormals(points, meshData->vpf, meshData->indexes, &meshData->normals, &meshData->normalIndexes);
+        meshData->generatedNormals = true;
+    }
+
+    /// Transfers scene membership and recorded state of the shape to its replacement.
+    /// Must be called under m_rprAccessMutex right before the shape deletion.
+    void ReplaceShape(rpr::Shape* shape, rpr::Shape* replacement) {
+        bool isAttached;
+        {
+            std::lock_guard<std::mutex> lock(m_sceneEditMutex);
+            isAttached = m_shapeEdits.Replace(shape, replacement);
+
+            auto stateIt = m_shapeStates.find(shape);
+            if (stateIt != m_shapeStates.end()) {
+                auto state = stateIt->second;
+                m_shapeStates.erase(stateIt);
+
+                // All values that were ever requested have to be applied to the new shape
+                state.dirtyBits = state.validBits;
+                if (state.dirtyBits != ShapeState::Clean) {
+                    m_dirtyShapes.push_back(replacement);
+                }
+                m_shapeStates.emplace(replacement, state);
+            }
+        }
+
+        if (isAttached) {
+            RPR_ERROR_CHECK(m_scene->Detach(shape), "Failed to detach object from scene");
+        }
+        m_dirtyFlags |= ChangeTracker::DirtyScene;
+    }
+
+    rpr::Shape* CreateMeshInstance(rpr::Shape* prototype, MeshPrototype* sharedPrototype) {
+        rpr::Status status;
+        auto mesh = m_rprContext->CreateShapeInstance(prototype, &status);
+        if (!mesh) {
+            RPR_ERROR_CHECK(status, "Failed to create mesh instance");
+            return nullptr;
+        }
+
+        AttachToScene(mesh);
+
+        if (sharedPrototype) {
+            sharedPrototype->numUsers++;
+            m_sharedMeshes.emplace(mesh, sharedPrototype);
+        }
+
+        return mesh;
+    }
+
+    /// Returns an instance of the registered mesh with the same geometry, nullptr if there is no such mesh
+    rpr::Shape* CreateSharedMeshInstance(MeshPrototype const& prototype) {
+        auto range = m_meshPrototypes.equal_range(prototype.hash);
+        for (auto it = range.first; it != range.second; ++it) {
+            if (it->second->geometry == prototype.geometry) {
+                return CreateMeshInstance(it->second->shape, it->second.get());
+            }
+        }
+        return nullptr;
+    }
+
+    /// Releases excessive instances or creates missing ones, existing instances are kept as is.
+    /// All new instances are attached to the scene at once.
+    void ResizeMeshInstances(rpr::Shape* prototypeMesh, std::vector<rpr::Shape*>* instances, size_t numInstances) {
+        if (instances->size() == numInstances) {
+            return;
+        }
+
+        RecursiveLockGuard rprLock(m_rprAccessMutex);
+
+        if (instances->size() > numInstances) {
+            for (size_t i = numInstances; i < instances->size(); ++i) {
+                Release((*instances)[i]);
+            }
+            instances->resize(numInstances);
+            return;
+        }
+
+        // Instances of a shared mesh are created directly from its prototype
+        MeshPrototype* sharedPrototype = nullptr;
+        auto sharedMeshIt = m_sharedMeshes.find(prototypeMesh);
+        if (sharedMeshIt != m_sharedMeshes.end()) {
+            sharedPrototype = sharedMeshIt->second;
+            prototypeMesh = sharedPrototype->shape;
+        }
+
+        const size_t numOldInstances = instances->size();
+        instances->reserve(numInstances);
+        for (size_t i = numOldInstances; i < numInstances; ++i) {
+            rpr::Status status;
+            auto mesh = m_rprContext->CreateShapeInstance(prototypeMesh, &status);
+            if (!mesh) {
+                RPR_ERROR_CHECK(status, "Failed to create mesh instance");
+                break;
+            }
+
+            instances->push_back(mesh);
+            if (sharedPrototype) {
+                sharedPrototype->numUsers++;
+                m_sharedMeshes.emplace(mesh, sharedPrototype);
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_sceneEditMutex);
+            for (size_t i = numOldInstances; i < instances->size(); ++i) {
+                m_shapeEdits.Attach((*instances)[i]);
+            }
+        }
+        m_dirtyFlags |= ChangeTracker::DirtyScene;
+    }
+
+    bool IsSharedMeshInstance(rpr::Shape* mesh) {
+        auto sharedMeshIt = m_sharedMeshes.find(mesh);
+        return sharedMeshIt != m_sharedMeshes.end() && sharedMeshIt->second->shape != mesh;
+    }
+
+    bool IsGeometryShared(rpr::Shape* mesh) {
+        auto sharedMeshIt = m_sharedMeshes.find(mesh);
+        return sharedMeshIt != m_sharedMeshes.end() && sharedMeshIt->second->numUsers > 1;
+    }
+
     void InitRpr() {
         RenderQualityType renderQuality;
         {
@@ -1614,14 +2333,20 @@ private:
 
         RPR_ERROR_CHECK_THROW(m_rprContext->SetParameter(RPR_CONTEXT_Y_FLIP, 0), "Fail to set context Y FLIP parameter");
 
+        std::string textureCachePath;
+        if (!cachePath.empty()) {
+            textureCachePath = (cachePath + ARCH_PATH_SEP) + "textures";
+            ArchCreateDirectory(textureCachePath.c_str());
+        }
+        // Batch renders must not start with placeholder textures
+        m_imageCache.reset(new ImageCache(m_rprContext.get(), textureCachePath, !m_delegate->IsBatch()));
+        m_materialFactory.reset(new RprMaterialFactory(m_imageCache.get()));
+
         {
             HdRprConfig* config;
             auto configInstanceLock = HdRprConfig::GetInstance(&config);
             UpdateSettings(*config, true);
         }
-
-        m_imageCache.reset(new ImageCache(m_rprContext.get()));
-        m_materialFactory.reset(new RprMaterialFactory(m_imageCache.get()));
     }
 
     bool ValidateRifModels(std::string const& modelsPath) {
@@ -1720,70 +2445,325 @@ private:
         m_showRestartRequiredWarning = !fileExists;
     }
 
-    void SplitPolygons(const VtIntArray& indexes, const VtIntArray& vpf, VtIntArray& out_newIndexes, VtIntArray& out_newVpf) {
-        out_newIndexes.clear();
-        out_newVpf.clear();
+    SceneEditQueue<rpr::Shape>& GetSceneEditQueue(rpr::Shape*) { return m_shapeEdits; }
+    SceneEditQueue<rpr::Curve>& GetSceneEditQueue(rpr::Curve*) { return m_curveEdits; }
+    SceneEditQueue<rpr::HeteroVolume>& GetSceneEditQueue(rpr::HeteroVolume*) { return m_heteroVolumeEdits; }
 
-        out_newIndexes.reserve(indexes.size());
-        out_newVpf.reserve(vpf.size());
+    template <typename T>
+    void AttachToScene(T* object) {
+        {
+            std::lock_guard<std::mutex> lock(m_sceneEditMutex);
+            GetSceneEditQueue(object).Attach(object);
+        }
+        m_dirtyFlags |= ChangeTracker::DirtyScene;
+    }
 
-        VtIntArray::const_iterator idxIt = indexes.begin();
-        for (const int vCount : vpf) {
-            if (vCount == 3 || vCount == 4) {
-                for (int i = 0; i < vCount; ++i) {
-                    out_newIndexes.push_back(*idxIt);
-                    ++idxIt;
-                }
-                out_newVpf.push_back(vCount);
-            } else {
-                const int commonVertex = *idxIt;
-                constexpr int triangleVertexCount = 3;
-                for (int i = 1; i < vCount - 1; ++i) {
-                    out_newIndexes.push_back(commonVertex);
-                    out_newIndexes.push_back(*(idxIt + i + 0));
-                    out_newIndexes.push_back(*(idxIt + i + 1));
-                    out_newVpf.push_back(triangleVertexCount);
-                }
-                idxIt += vCount;
+    template <typename T>
+    void DetachFromScene(T* object) {
+        {
+            std::lock_guard<std::mutex> lock(m_sceneEditMutex);
+            GetSceneEditQueue(object).Detach(object);
+        }
+        m_dirtyFlags |= ChangeTracker::DirtyScene;
+    }
+
+    // Must be called under m_rprAccessMutex right before the object deletion
+    template <typename T>
+    void ReleaseFromScene(T* object) {
+        bool isAttached;
+        {
+            std::lock_guard<std::mutex> lock(m_sceneEditMutex);
+            isAttached = GetSceneEditQueue(object).Erase(object);
+            ErasePendingCommands(object);
+        }
+
+        if (isAttached &&
+            !RPR_ERROR_CHECK(m_scene->Detach(object), "Failed to detach object from scene")) {
+            m_dirtyFlags |= ChangeTracker::DirtyScene;
+        }
+    }
+
+    template <typename T>
+    void ErasePendingCommands(T* object) {}
+
+    void ErasePendingCommands(rpr::Shape* shape) {
+        m_shapeStates.erase(shape);
+    }
+
+    template <typename IsSameFunc, typename AssignFunc>
+    void RecordShapeCommand(rpr::Shape* shape, ShapeState::DirtyBits bit, IsSameFunc const& isSame, AssignFunc const& assign) {
+        {
+            std::lock_guard<std::mutex> lock(m_sceneEditMutex);
+            RecordShapeCommandLocked(shape, bit, isSame, assign);
+        }
+        m_dirtyFlags |= ChangeTracker::DirtyScene;
+    }
+
+    // Must be called under m_sceneEditMutex
+    template <typename IsSameFunc, typename AssignFunc>
+    void RecordShapeCommandLocked(rpr::Shape* shape, ShapeState::DirtyBits bit, IsSameFunc const& isSame, AssignFunc const& assign) {
+        auto& state = m_shapeStates[shape];
+        if ((state.validBits & bit) && isSame(state)) {
+            // The same value is either already applied or pending
+            ++m_numCoalescedCommands;
+            return;
+        }
+
+        if (state.dirtyBits & bit) {
+            // Last writer wins
+            ++m_numCoalescedCommands;
+        } else {
+            if (state.dirtyBits == ShapeState::Clean) {
+                m_dirtyShapes.push_back(shape);
+            }
+            state.dirtyBits |= bit;
+        }
+        state.validBits |= bit;
+        assign(&state);
+    }
+
+    // Must be called under m_sceneEditMutex
+    void RecordTransformLocked(rpr::Shape* shape, GfMatrix4f const& transform) {
+        RecordShapeCommandLocked(shape, ShapeState::DirtyTransform,
+            [&](ShapeState const& state) { return state.transform == transform; },
+            [&](ShapeState* state) { state->transform = transform; });
+    }
+
+    // Must be called under m_sceneEditMutex
+    void RecordMotionLocked(rpr::Shape* shape, ShapeMotion const& motion) {
+        RecordShapeCommandLocked(shape, ShapeState::DirtyMotion,
+            [&](ShapeState const& state) {
+                return state.linearMotion == motion.linearMotion &&
+                       state.scaleMotion == motion.scaleMotion &&
+                       state.rotateAxis == motion.rotateAxis &&
+                       state.rotateAngle == motion.rotateAngle;
+            },
+            [&](ShapeState* state) {
+                state->linearMotion = motion.linearMotion;
+                state->scaleMotion = motion.scaleMotion;
+                state->rotateAxis = motion.rotateAxis;
+                state->rotateAngle = motion.rotateAngle;
+            });
+    }
+
+    // Must be called under m_rprAccessMutex and m_sceneEditMutex
+    void CommitShapeCommands() {
+        for (auto shape : m_dirtyShapes) {
+            auto stateIt = m_shapeStates.find(shape);
+            if (stateIt == m_shapeStates.end() ||
+                stateIt->second.dirtyBits == ShapeState::Clean) {
+                // Shape was released or it's a duplicate
+                continue;
             }
+
+            auto& state = stateIt->second;
+            if (state.dirtyBits & ShapeState::DirtyTransform) {
+                RPR_ERROR_CHECK(shape->SetTransform(state.transform.GetArray(), false), "Fail set shape transform");
+                ++m_numAppliedCommands;
+            }
+            if (state.dirtyBits & ShapeState::DirtyMotion) {
+                RPR_ERROR_CHECK(shape->SetLinearMotion(state.linearMotion[0], state.linearMotion[1], state.linearMotion[2]), "Fail to set shape linear motion");
+                RPR_ERROR_CHECK(shape->SetScaleMotion(state.scaleMotion[0], state.scaleMotion[1], state.scaleMotion[2]), "Fail to set shape scale motion");
+                RPR_ERROR_CHECK(shape->SetAngularMotion(state.rotateAxis[0], state.rotateAxis[1], state.rotateAxis[2], state.rotateAngle), "Fail to set shape angular motion");
+                ++m_numAppliedCommands;
+            }
+            if (state.dirtyBits & ShapeState::DirtyVisibility) {
+                auto visibilityMask = state.visibilityMask;
+                RPR_ERROR_CHECK(shape->SetVisibilityFlag(RPR_SHAPE_VISIBILITY_PRIMARY_ONLY_FLAG, visibilityMask & kVisiblePrimary), "Failed to set mesh primary visibility");
+                RPR_ERROR_CHECK(shape->SetVisibilityFlag(RPR_SHAPE_VISIBILITY_SHADOW, visibilityMask & kVisibleShadow), "Failed to set mesh shadow visibility");
+                RPR_ERROR_CHECK(shape->SetVisibilityFlag(RPR_SHAPE_VISIBILITY_REFLECTION, visibilityMask & kVisibleReflection), "Failed to set mesh reflection visibility");
+                RPR_ERROR_CHECK(shape->SetVisibilityFlag(RPR_SHAPE_VISIBILITY_REFRACTION, visibilityMask & kVisibleRefraction), "Failed to set mesh refraction visibility");
+                RPR_ERROR_CHECK(shape->SetVisibilityFlag(RPR_SHAPE_VISIBILITY_TRANSPARENT, visibilityMask & kVisibleTransparent), "Failed to set mesh transparent visibility");
+                RPR_ERROR_CHECK(shape->SetVisibilityFlag(RPR_SHAPE_VISIBILITY_DIFFUSE, visibilityMask & kVisibleDiffuse), "Failed to set mesh diffuse visibility");
+                RPR_ERROR_CHECK(shape->SetVisibilityFlag(RPR_SHAPE_VISIBILITY_GLOSSY_REFLECTION, visibilityMask & kVisibleGlossyReflection), "Failed to set mesh glossyReflection visibility");
+                RPR_ERROR_CHECK(shape->SetVisibilityFlag(RPR_SHAPE_VISIBILITY_GLOSSY_REFRACTION, visibilityMask & kVisibleGlossyRefraction), "Failed to set mesh glossyRefraction visibility");
+                RPR_ERROR_CHECK(shape->SetVisibilityFlag(RPR_SHAPE_VISIBILITY_LIGHT, visibilityMask & kVisibleLight), "Failed to set mesh light visibility");
+                ++m_numAppliedCommands;
+            }
+            if (state.dirtyBits & ShapeState::DirtyMaterial) {
+                // XXX (RPR): displacement requires subdivision of the geometry that is shared with other meshes
+                bool displacementEnabled = state.displacementEnabled && !IsGeometryShared(shape);
+                m_materialFactory->AttachMaterial(shape, state.material, state.doublesided, displacementEnabled);
+                ++m_numAppliedCommands;
+            }
+            if (state.dirtyBits & ShapeState::DirtyId) {
+                RPR_ERROR_CHECK(shape->SetObjectID(state.id), "Failed to set mesh id");
+                ++m_numAppliedCommands;
+            }
+            state.dirtyBits = ShapeState::Clean;
         }
+        m_dirtyShapes.clear();
     }
 
-    void SplitPolygons(const VtIntArray& indexes, const VtIntArray& vpf, VtIntArray& out_newIndexes) {
-        out_newIndexes.clear();
-        out_newIndexes.reserve(indexes.size());
+    // Must be called under m_rprAccessMutex
+    void CommitSceneEdits() {
+        std::lock_guard<std::mutex> lock(m_sceneEditMutex);
 
-        VtIntArray::const_iterator idxIt = indexes.begin();
-        for (const int vCount : vpf) {
-            if (vCount == 3 || vCount == 4) {
-                for (int i = 0; i < vCount; ++i) {
-                    out_newIndexes.push_back(*idxIt);
-                    ++idxIt;
-                }
-            } else {
-                const int commonVertex = *idxIt;
-                for (int i = 1; i < vCount - 1; ++i) {
-                    out_newIndexes.push_back(commonVertex);
-                    out_newIndexes.push_back(*(idxIt + i + 0));
-                    out_newIndexes.push_back(*(idxIt + i + 1));
+        CommitShapeCommands();
+
+        bool isSceneEdited = false;
+        isSceneEdited |= m_shapeEdits.Commit(m_scene.get());
+        isSceneEdited |= m_curveEdits.Commit(m_scene.get());
+        isSceneEdited |= m_heteroVolumeEdits.Commit(m_scene.get());
+        if (isSceneEdited) {
+            m_dirtyFlags |= ChangeTracker::DirtyScene;
+        }
+    }
+
+    /// Splits polygons with more than 4 vertices into triangle fans (RPR supports only triangles and quads)
+    /// and converts winding order to right handed. All index streams are processed in one sweep.
+    /// Empty normal or uv index streams are left empty.
+    /// Returns false if face vertex counts do not match the size of index streams.
+    bool SplitPolygons(VtIntArray const& vpf, TfToken const& windingOrder,
+                       VtIntArray const& indexes, VtIntArray const& normalIndexes, VtIntArray const& uvIndexes,
+                       VtIntArray* out_vpf, VtIntArray* out_indexes, VtIntArray* out_normalIndexes, VtIntArray* out_uvIndexes) {
+        constexpr size_t kNumStreams = 3;
+        VtIntArray const* inStreams[kNumStreams] = {&indexes, &normalIndexes, &uvIndexes};
+        VtIntArray* outStreams[kNumStreams] = {out_indexes, out_normalIndexes, out_uvIndexes};
+
+        // First pass: count input and output indices and faces per block of faces
+        struct FaceBlock {
+            size_t numIndices = 0;
+            size_t numNewIndices = 0;
+            size_t numNewFaces = 0;
+            bool requiresSplit = false;
+        };
+        const size_t kFacesPerBlock = 16384;
+        const size_t numFaces = vpf.size();
+        const size_t numBlocks = (numFaces + kFacesPerBlock - 1) / kFacesPerBlock;
+        std::vector<FaceBlock> blocks(numBlocks);
+
+        const int* vpfData = vpf.cdata();
+        WorkParallelForN(numBlocks, [&](size_t begin, size_t end) {
+            for (size_t iBlock = begin; iBlock < end; ++iBlock) {
+                auto& block = blocks[iBlock];
+                size_t faceEnd = std::min(numFaces, (iBlock + 1) * kFacesPerBlock);
+                for (size_t iFace = iBlock * kFacesPerBlock; iFace < faceEnd; ++iFace) {
+                    const int vCount = vpfData[iFace];
+                    if (vCount == 3 || vCount == 4) {
+                        block.numNewIndices += vCount;
+                        block.numNewFaces += 1;
+                    } else {
+                        block.requiresSplit = true;
+                        if (vCount > 4) {
+                            block.numNewIndices += 3 * (vCount - 2);
+                            block.numNewFaces += vCount - 2;
+                        }
+                    }
+                    block.numIndices += std::max(vCount, 0);
                 }
-                idxIt += vCount;
+            }
+        });
+
+        // Exclusive prefix sum turns counts into block offsets
+        bool requiresSplit = false;
+        size_t numIndices = 0;
+        size_t numNewIndices = 0;
+        size_t numNewFaces = 0;
+        for (auto& block : blocks) {
+            requiresSplit |= block.requiresSplit;
+
+            auto blockNumIndices = block.numIndices;
+            auto blockNumNewIndices = block.numNewIndices;
+            auto blockNumNewFaces = block.numNewFaces;
+            block.numIndices = numIndices;
+            block.numNewIndices = numNewIndices;
+            block.numNewFaces = numNewFaces;
+            numIndices += blockNumIndices;
+            numNewIndices += blockNumNewIndices;
+            numNewFaces += blockNumNewFaces;
+        }
+
+        for (size_t i = 0; i < kNumStreams; ++i) {
+            if (!inStreams[i]->empty() && inStreams[i]->size() != numIndices) {
+                return false;
             }
         }
-    }
 
-    void ConvertIndices(VtIntArray* indices, VtIntArray const& vpf, TfToken const& windingOrder) {
-        if (windingOrder == HdTokens->rightHanded) {
-            return;
+        const bool flipWinding = windingOrder != HdTokens->rightHanded;
+        if (!requiresSplit && !flipWinding) {
+            // Triangles and quads in the right winding order can be passed to RPR as is
+            *out_vpf = vpf;
+            for (size_t i = 0; i < kNumStreams; ++i) {
+                *outStreams[i] = *inStreams[i];
+            }
+            return true;
+        }
+
+        // Second pass: scatter indices of each block starting from its offset
+        int* outVpfData = nullptr;
+        if (requiresSplit) {
+            *out_vpf = VtIntArray(numNewFaces);
+            outVpfData = out_vpf->data();
+        } else {
+            *out_vpf = vpf;
         }
 
-        // XXX: RPR does not allow to select which winding order we want to use and it's by default right handed
-        size_t indicesOffset = 0;
-        for (int iFace = 0; iFace < vpf.size(); ++iFace) {
-            auto faceIndices = indices->data() + indicesOffset;
-            std::swap(faceIndices[0], faceIndices[2]);
-            indicesOffset += vpf[iFace];
+        const int* inData[kNumStreams];
+        int* outData[kNumStreams];
+        for (size_t i = 0; i < kNumStreams; ++i) {
+            if (inStreams[i]->empty()) {
+                outStreams[i]->clear();
+                inData[i] = nullptr;
+                outData[i] = nullptr;
+            } else {
+                *outStreams[i] = VtIntArray(numNewIndices);
+                inData[i] = inStreams[i]->cdata();
+                outData[i] = outStreams[i]->data();
+            }
         }
+
+        WorkParallelForN(numBlocks, [&](size_t begin, size_t end) {
+            for (size_t iBlock = begin; iBlock < end; ++iBlock) {
+                size_t inOffset = blocks[iBlock].numIndices;
+                size_t outOffset = blocks[iBlock].numNewIndices;
+                size_t outFaceOffset = blocks[iBlock].numNewFaces;
+
+                size_t faceEnd = std::min(numFaces, (iBlock + 1) * kFacesPerBlock);
+                for (size_t iFace = iBlock * kFacesPerBlock; iFace < faceEnd; ++iFace) {
+                    const int vCount = vpfData[iFace];
+                    if (vCount == 3 || vCount == 4) {
+                        for (size_t i = 0; i < kNumStreams; ++i) {
+                            if (!inData[i]) continue;
+
+                            auto src = inData[i] + inOffset;
+                            auto dst = outData[i] + outOffset;
+                            std::copy(src, src + vCount, dst);
+                            if (flipWinding) {
+                                // XXX: RPR does not allow to select which winding order we want to use and it's by default right handed
+                                std::swap(dst[0], dst[2]);
+                            }
+                        }
+                        if (outVpfData) {
+                            outVpfData[outFaceOffset] = vCount;
+                        }
+                        outOffset += vCount;
+                        outFaceOffset += 1;
+                    } else if (vCount > 4) {
+                        for (size_t i = 0; i < kNumStreams; ++i) {
+                            if (!inData[i]) continue;
+
+                            auto src = inData[i] + inOffset;
+                            auto dst = outData[i] + outOffset;
+                            for (int iVertex = 1; iVertex < vCount - 1; ++iVertex) {
+                                dst[0] = src[flipWinding ? iVertex + 1 : 0];
+                                dst[1] = src[iVertex];
+                                dst[2] = src[flipWinding ? 0 : iVertex + 1];
+                                dst += 3;
+                            }
+                        }
+                        for (int iTriangle = 0; iTriangle < vCount - 2; ++iTriangle) {
+                            outVpfData[outFaceOffset + iTriangle] = 3;
+                        }
+                        outOffset += 3 * (vCount - 2);
+                        outFaceOffset += vCount - 2;
+                    }
+                    inOffset += std::max(vCount, 0);
+                }
+            }
+        });
+
+        return true;
     }
 
     rpr::Shape* CreateCubeMesh(float width, float height, float depth) {
@@ -2109,7 +3089,34 @@ private:
         DirtyViewport = 1 << 3,
         DirtyAOVBindings = 1 << 4,
     };
-    uint32_t m_dirtyFlags = ChangeTracker::AllDirty;
+    // Can be modified concurrently by Sync of different prims
+    std::atomic<uint32_t> m_dirtyFlags{ChangeTracker::AllDirty};
+
+    // Guards access to RPR core. Scene edits that are requested during parallel Sync
+    // are recorded under lightweight m_sceneEditMutex and committed to m_scene in Update
+    std::recursive_mutex m_rprAccessMutex;
+    std::mutex m_sceneEditMutex;
+    SceneEditQueue<rpr::Shape> m_shapeEdits;
+    SceneEditQueue<rpr::Curve> m_curveEdits;
+    SceneEditQueue<rpr::HeteroVolume> m_heteroVolumeEdits;
+
+    std::unordered_map<rpr::Shape*, ShapeState> m_shapeStates;
+    std::vector<rpr::Shape*> m_dirtyShapes;
+    std::atomic<size_t> m_numAppliedCommands{0};
+    std::atomic<size_t> m_numCoalescedCommands{0};
+
+    // Meshes with identical geometry share the same RPR mesh, all of them except the first one are created as instances
+    std::unordered_multimap<uint64_t, std::unique_ptr<MeshPrototype>> m_meshPrototypes;
+    std::unordered_map<rpr::Shape*, MeshPrototype*> m_sharedMeshes;
+
+    std::unordered_map<rpr::Shape*, MeshData> m_meshData;
+
+    // Materials created from equal adapters are shared, the material is released when the last of its users releases it
+    std::unordered_multimap<uint64_t, std::unique_ptr<MaterialPrototype>> m_materialPrototypes;
+    std::unordered_map<HdRprApiMaterial const*, MaterialPrototype*> m_sharedMaterials;
+    std::atomic<size_t> m_numMaterialNodes{0};
+    // Number of nodes that would have been created if materials were not shared
+    std::atomic<size_t> m_numSharedMaterialNodes{0};
 
     std::unique_ptr<rpr::Context> m_rprContext;
     rpr::ContextMetadata m_rprContextMetadata;
@@ -2161,79 +3168,104 @@ HdRprApi::~HdRprApi() {
     delete m_impl;
 }
 
-rpr::Shape* HdRprApi::CreateMesh(const VtVec3fArray& points, const VtIntArray& pointIndexes, const VtVec3fArray& normals, const VtIntArray& normalIndexes, const VtVec2fArray& uv, const VtIntArray& uvIndexes, const VtIntArray& vpf, TfToken const& polygonWinding) {
+rpr::Shape* HdRprApi::CreateMesh(const VtVec3fArray& points, const VtIntArray& pointIndexes, const VtVec3fArray& normals, const VtIntArray& normalIndexes, const VtVec2fArray& uv, const VtIntArray& uvIndexes, const VtIntArray& vpf, TfToken const& polygonWinding, bool allowSharing) {
+    m_impl->StopRenderForEdit();
     m_impl->InitIfNeeded();
-    return m_impl->CreateMesh(points, pointIndexes, normals, normalIndexes, uv, uvIndexes, vpf, polygonWinding);
+    return m_impl->CreateMesh(points, pointIndexes, normals, normalIndexes, uv, uvIndexes, vpf, polygonWinding, allowSharing);
 }
 
 rpr::Curve* HdRprApi::CreateCurve(VtVec3fArray const& points, VtIntArray const& indices, VtFloatArray const& radiuses, VtVec2fArray const& uvs, VtIntArray const& segmentPerCurve) {
+    m_impl->StopRenderForEdit();
     m_impl->InitIfNeeded();
     return m_impl->CreateCurve(points, indices, radiuses, uvs, segmentPerCurve);
 }
 
+rpr::Shape* HdRprApi::UpdateMeshPoints(rpr::Shape* mesh, VtVec3fArray const& points, VtVec3fArray const& normals, std::vector<rpr::Shape*>* instances) {
+    m_impl->StopRenderForEdit();
+    return m_impl->UpdateMeshPoints(mesh, points, normals, instances);
+}
+
 rpr::Shape* HdRprApi::CreateMeshInstance(rpr::Shape* prototypeMesh) {
+    m_impl->StopRenderForEdit();
     return m_impl->CreateMeshInstance(prototypeMesh);
 }
 
 HdRprApiEnvironmentLight* HdRprApi::CreateEnvironmentLight(GfVec3f color, float intensity) {
+    m_impl->StopRenderForEdit();
     m_impl->InitIfNeeded();
     return m_impl->CreateEnvironmentLight(color, intensity);
 }
 
 HdRprApiEnvironmentLight* HdRprApi::CreateEnvironmentLight(const std::string& prthTotexture, float intensity) {
+    m_impl->StopRenderForEdit();
     m_impl->InitIfNeeded();
     return m_impl->CreateEnvironmentLight(prthTotexture, intensity);
 }
 
 void HdRprApi::SetTransform(HdRprApiEnvironmentLight* envLight, GfMatrix4f const& transform) {
+    m_impl->StopRenderForEdit();
     m_impl->SetTransform(envLight->light.get(), transform);
 }
 
 void HdRprApi::SetTransform(rpr::SceneObject* object, GfMatrix4f const& transform) {
+    m_impl->StopRenderForEdit();
     m_impl->SetTransform(object, transform);
 }
 
+void HdRprApi::SetTransform(rpr::Shape* shape, GfMatrix4f const& transform) {
+    m_impl->SetTransform(shape, transform);
+}
+
 void HdRprApi::SetTransform(rpr::Shape* shape, size_t numSamples, float* timeSamples, GfMatrix4d* transformSamples) {
     m_impl->SetTransform(shape, numSamples, timeSamples, transformSamples);
 }
 
 void HdRprApi::SetTransform(HdRprApiVolume* volume, GfMatrix4f const& transform) {
+    m_impl->StopRenderForEdit();
     m_impl->SetTransform(volume, transform);
 }
 
 rpr::DirectionalLight* HdRprApi::CreateDirectionalLight() {
+    m_impl->StopRenderForEdit();
     m_impl->InitIfNeeded();
     return m_impl->CreateDirectionalLight();
 }
 
 rpr::SpotLight* HdRprApi::CreateSpotLight(float angle, float softness) {
+    m_impl->StopRenderForEdit();
     m_impl->InitIfNeeded();
     return m_impl->CreateSpotLight(angle, softness);
 }
 
 rpr::PointLight* HdRprApi::CreatePointLight() {
+    m_impl->StopRenderForEdit();
     m_impl->InitIfNeeded();
     return m_impl->CreatePointLight();
 }
 
 rpr::IESLight* HdRprApi::CreateIESLight(std::string const& iesFilepath) {
+    m_impl->StopRenderForEdit();
     m_impl->InitIfNeeded();
     return m_impl->CreateIESLight(iesFilepath);
 }
 
 void HdRprApi::SetDirectionalLightAttributes(rpr::DirectionalLight* directionalLight, GfVec3f const& color, float shadowSoftnessAngle) {
+    m_impl->StopRenderForEdit();
     m_impl->SetDirectionalLightAttributes(directionalLight, color, shadowSoftnessAngle);
 }
 
 void HdRprApi::SetLightColor(rpr::SpotLight* light, GfVec3f const& color) {
+    m_impl->StopRenderForEdit();
     m_impl->SetLightColor(light, color);
 }
 
 void HdRprApi::SetLightColor(rpr::PointLight* light, GfVec3f const& color) {
+    m_impl->StopRenderForEdit();
     m_impl->SetLightColor(light, color);
 }
 
 void HdRprApi::SetLightColor(rpr::IESLight* light, GfVec3f const& color) {
+    m_impl->StopRenderForEdit();
     m_impl->SetLightColor(light, color);
 }
 
@@ -2242,6 +3274,7 @@ HdRprApiVolume* HdRprApi::CreateVolume(
     VtUIntArray const& albedoCoords, VtFloatArray const& albedoValues, VtVec3fArray const& albedoLUT, float albedoScale,
     VtUIntArray const& emissionCoords, VtFloatArray const& emissionValues, VtVec3fArray const& emissionLUT, float emissionScale,
     const GfVec3i& gridSize, const GfVec3f& voxelSize, const GfVec3f& gridBBLow, VolumeMaterialParameters const& materialParams) {
+    m_impl->StopRenderForEdit();
     m_impl->InitIfNeeded();
     return m_impl->CreateVolume(
         densityCoords, densityValues, densityLUT, densityScale,
@@ -2251,20 +3284,44 @@ HdRprApiVolume* HdRprApi::CreateVolume(
 }
 
 HdRprApiMaterial* HdRprApi::CreateMaterial(MaterialAdapter& MaterialAdapter) {
+    m_impl->StopRenderForEdit();
     m_impl->InitIfNeeded();
     return m_impl->CreateMaterial(MaterialAdapter);
 }
 
-HdRprApiMaterial* HdRprApi::CreatePointsMaterial(VtVec3fArray const& colors) {
+HdRprApiMaterial* HdRprApi::UpdateMaterial(HdRprApiMaterial* material, MaterialAdapter& materialAdapter) {
+    m_impl->StopRenderForEdit();
     m_impl->InitIfNeeded();
-    return m_impl->CreatePointsMaterial(colors);
+    return m_impl->UpdateMaterial(material, materialAdapter);
+}
+
+HdRprApiMaterial* HdRprApi::CreatePointsMaterial(VtVec3fArray const& colors, bool indexByUV) {
+    m_impl->StopRenderForEdit();
+    m_impl->InitIfNeeded();
+    return m_impl->CreatePointsMaterial(colors, indexByUV);
+}
+
+void HdRprApi::SetMeshInstances(rpr::Shape* prototypeMesh, std::vector<rpr::Shape*>* instances, size_t numSamples, float* timeSamples, VtMatrix4dArray const* transformSamples) {
+    if (numSamples > 0 && instances->size() != transformSamples[0].size()) {
+        m_impl->StopRenderForEdit();
+    }
+    m_impl->SetMeshInstances(prototypeMesh, instances, numSamples, timeSamples, transformSamples);
+}
+
+void HdRprApi::SetMeshInstances(rpr::Shape* prototypeMesh, std::vector<rpr::Shape*>* instances, VtMatrix4fArray const& transforms) {
+    if (instances->size() != transforms.size()) {
+        m_impl->StopRenderForEdit();
+    }
+    m_impl->SetMeshInstances(prototypeMesh, instances, transforms);
 }
 
 void HdRprApi::SetMeshRefineLevel(rpr::Shape* mesh, int level) {
+    m_impl->StopRenderForEdit();
     m_impl->SetMeshRefineLevel(mesh, level);
 }
 
 void HdRprApi::SetMeshVertexInterpolationRule(rpr::Shape* mesh, TfToken boundaryInterpolation) {
+    m_impl->StopRenderForEdit();
     m_impl->SetMeshVertexInterpolationRule(mesh, boundaryInterpolation);
 }
 
@@ -2272,6 +3329,17 @@ void HdRprApi::SetMeshMaterial(rpr::Shape* mesh, HdRprApiMaterial const* materia
     m_impl->SetMeshMaterial(mesh, material, doublesided, displacementEnabled);
 }
 
+void HdRprApi::RequireUdimTiles(HdRprApiMaterial const* material, std::vector<uint32_t> const& tiles) {
+    // Meshes request their tiles on each material sync, don't interrupt rendering if everything is loaded already
+    if (!material || material->udimImages.empty() ||
+        !m_impl->HasMissingUdimTiles(material, tiles)) {
+        return;
+    }
+
+    m_impl->StopRenderForEdit();
+    m_impl->RequireUdimTiles(material, tiles);
+}
+
 void HdRprApi::SetMeshVisibility(rpr::Shape* mesh, uint32_t visibilityMask) {
     m_impl->SetMeshVisibility(mesh, visibilityMask);
 }
@@ -2281,38 +3349,52 @@ void HdRprApi::SetMeshId(rpr::Shape* mesh, uint32_t id) {
 }
 
 void HdRprApi::SetCurveMaterial(rpr::Curve* curve, HdRprApiMaterial const* material) {
+    m_impl->StopRenderForEdit();
     m_impl->SetCurveMaterial(curve, material);
 }
 
 void HdRprApi::SetCurveVisibility(rpr::Curve* curve, uint32_t visibilityMask) {
+    m_impl->StopRenderForEdit();
     m_impl->SetCurveVisibility(curve, visibilityMask);
 }
 
 void HdRprApi::Release(HdRprApiEnvironmentLight* envLight) {
+    m_impl->StopRenderForEdit();
     m_impl->Release(envLight);
 }
 
 void HdRprApi::Release(HdRprApiMaterial* material) {
+    m_impl->StopRenderForEdit();
     m_impl->Release(material);
 }
 
+void HdRprApi::SetVolumeGrid(HdRprApiVolume* volume, VolumeGridType type, VtUIntArray const& coords, VtFloatArray const& values, VtVec3fArray const& LUT, float scale) {
+    m_impl->StopRenderForEdit();
+    m_impl->SetVolumeGrid(volume, type, coords, values, LUT, scale);
+}
+
 void HdRprApi::Release(HdRprApiVolume* volume) {
+    m_impl->StopRenderForEdit();
     m_impl->Release(volume);
 }
 
 void HdRprApi::Release(rpr::Light* light) {
+    m_impl->StopRenderForEdit();
     m_impl->Release(light);
 }
 
 void HdRprApi::Release(rpr::Shape* shape) {
+    m_impl->StopRenderForEdit();
     m_impl->Release(shape);
 }
 
 void HdRprApi::Release(rpr::Curve* curve) {
+    m_impl->StopRenderForEdit();
     m_impl->Release(curve);
 }
 
 void HdRprApi::SetCamera(HdCamera const* camera) {
+    m_impl->StopRenderForEdit();
     m_impl->SetCamera(camera);
 }
 
@@ -2333,10 +3415,12 @@ GfVec2i HdRprApi::GetViewportSize() const {
 }
 
 void HdRprApi::SetViewportSize(GfVec2i const& size) {
+    m_impl->StopRenderForEdit();
     m_impl->SetViewportSize(size);
 }
 
 void HdRprApi::SetAovBindings(HdRenderPassAovBindingVector const& aovBindings) {
+    m_impl->StopRenderForEdit();
     m_impl->InitIfNeeded();
     m_impl->SetAovBindings(aovBindings);
 }
@@ -2365,6 +3449,26 @@ int HdRprApi::GetNumActivePixels() const {
     return m_impl->GetNumActivePixels();
 }
 
+size_t HdRprApi::GetNumAppliedCommands() const {
+    return m_impl->GetNumAppliedCommands();
+}
+
+size_t HdRprApi::GetNumCoalescedCommands() const {
+    return m_impl->GetNumCoalescedCommands();
+}
+
+size_t HdRprApi::GetNumMaterialNodes() const {
+    return m_impl->GetNumMaterialNodes();
+}
+
+size_t HdRprApi::GetNumSharedMaterialNodes() const {
+    return m_impl->GetNumSharedMaterialNodes();
+}
+
+size_t HdRprApi::GetNumPendingImageLoads() const {
+    return m_impl->GetNumPendingImageLoads();
+}
+
 bool HdRprApi::IsGlInteropEnabled() const {
     return m_impl->IsGlInteropEnabled();
 }
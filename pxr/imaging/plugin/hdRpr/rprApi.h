@@ -98,18 +98,43 @@ public:
                                  VtUIntArray const& albedoCoords, VtFloatArray const& albedoValues, VtVec3fArray const& albedoLUT, float albedoScale,
                                  VtUIntArray const& emissionCoords, VtFloatArray const& emissionValues, VtVec3fArray const& emissionLUT, float emissionScale,
                                  const GfVec3i& gridSize, const GfVec3f& voxelSize, const GfVec3f& gridBBLow, VolumeMaterialParameters const& materialParams);
+    enum VolumeGridType {
+        kVolumeGridDensity,
+        kVolumeGridAlbedo,
+        kVolumeGridEmission
+    };
+    // Replaces one grid of the volume keeping the other grids, the bounding mesh and the material.
+    // The grid should have the same size as the one the volume was created with.
+    void SetVolumeGrid(HdRprApiVolume* volume, VolumeGridType type, VtUIntArray const& coords, VtFloatArray const& values, VtVec3fArray const& LUT, float scale);
     void SetTransform(HdRprApiVolume* volume, GfMatrix4f const& transform);
     void Release(HdRprApiVolume* volume);
 
+    // Materials created from equal adapters are shared, each CreateMaterial call should be paired with Release
     HdRprApiMaterial* CreateMaterial(MaterialAdapter& materialAdapter);
-    HdRprApiMaterial* CreatePointsMaterial(VtVec3fArray const& colors);
+    // Updates the material to match the adapter. When the node graph does not change, only the changed parameters are set
+    // on the existing nodes and the same material is returned. Otherwise the material is released and a new one is returned
+    HdRprApiMaterial* UpdateMaterial(HdRprApiMaterial* material, MaterialAdapter& materialAdapter);
+    // When indexByUV is set, the color of the point is looked up by the first uv coordinate instead of the object id
+    HdRprApiMaterial* CreatePointsMaterial(VtVec3fArray const& colors, bool indexByUV = false);
     void Release(HdRprApiMaterial* material);
 
-    rpr::Shape* CreateMesh(const VtVec3fArray& points, const VtIntArray& pointIndexes, const VtVec3fArray& normals, const VtIntArray& normalIndexes, const VtVec2fArray& uv, const VtIntArray& uvIndexes, const VtIntArray& vpf, TfToken const& polygonWinding);
+    // When sharing is allowed, meshes with identical geometry are created as instances of the first such mesh.
+    // Subdivision settings can't be changed on such meshes.
+    rpr::Shape* CreateMesh(const VtVec3fArray& points, const VtIntArray& pointIndexes, const VtVec3fArray& normals, const VtIntArray& normalIndexes, const VtVec2fArray& uv, const VtIntArray& uvIndexes, const VtIntArray& vpf, TfToken const& polygonWinding, bool allowSharing = false);
     rpr::Shape* CreateMeshInstance(rpr::Shape* prototypeMesh);
+    // Makes the number of instances of the prototype mesh equal to the number of transforms and sets their transforms in one go.
+    // Existing instances are reused, excessive ones are released. transformSamples holds numSamples arrays of instance transforms.
+    void SetMeshInstances(rpr::Shape* prototypeMesh, std::vector<rpr::Shape*>* instances, size_t numSamples, float* timeSamples, VtMatrix4dArray const* transformSamples);
+    void SetMeshInstances(rpr::Shape* prototypeMesh, std::vector<rpr::Shape*>* instances, VtMatrix4fArray const& transforms);
+    // Replaces vertex data of the mesh preserving its topology, subdivision settings, material, visibility, transform and instances.
+    // Empty normals mean that current normals are kept. The mesh and its instances are replaced with new objects.
+    // Returns nullptr if the update is not possible (e.g. number of points changed), the mesh is left untouched in that case.
+    rpr::Shape* UpdateMeshPoints(rpr::Shape* mesh, VtVec3fArray const& points, VtVec3fArray const& normals, std::vector<rpr::Shape*>* instances);
     void SetMeshRefineLevel(rpr::Shape* mesh, int level);
     void SetMeshVertexInterpolationRule(rpr::Shape* mesh, TfToken boundaryInterpolation);
     void SetMeshMaterial(rpr::Shape* mesh, HdRprApiMaterial const* material, bool doublesided, bool displacementEnabled);
+    // Loads the tiles of the material's UDIM textures that are not loaded yet, only the tiles a mesh covers with its uvs should be requested
+    void RequireUdimTiles(HdRprApiMaterial const* material, std::vector<uint32_t> const& tiles);
     void SetMeshVisibility(rpr::Shape* mesh, uint32_t visibilityMask);
     void SetMeshId(rpr::Shape* mesh, uint32_t id);
     void Release(rpr::Shape* shape);
@@ -120,6 +145,7 @@ public:
     void Release(rpr::Curve* curve);
 
     void SetTransform(rpr::SceneObject* object, GfMatrix4f const& transform);
+    void SetTransform(rpr::Shape* shape, GfMatrix4f const& transform);
     void SetTransform(rpr::Shape* shape, size_t numSamples, float* timeSamples, GfMatrix4d* transformSamples);
 
     GfMatrix4d GetCameraViewMatrix() const;
@@ -138,6 +164,19 @@ public:
     // returns -1 if adaptive sampling is not used
     int GetNumActivePixels() const;
 
+    // Shape edits (transform, visibility, material, id) are recorded during Sync and applied once per frame.
+    // Coalesced commands are the ones that were dropped because of redundancy or overwritten by a later command.
+    size_t GetNumAppliedCommands() const;
+    size_t GetNumCoalescedCommands() const;
+
+    // Materials with identical node graphs are shared between their users.
+    // Shared nodes are the nodes that would have been created additionally if materials were not shared
+    size_t GetNumMaterialNodes() const;
+    size_t GetNumSharedMaterialNodes() const;
+
+    // In interactive mode textures are decoded in the background, materials use placeholder images until then
+    size_t GetNumPendingImageLoads() const;
+
     void Render(HdRprRenderThread* renderThread);
     void AbortRender();
 
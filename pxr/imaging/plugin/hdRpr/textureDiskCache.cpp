@@ -0,0 +1,281 @@
+/************************************************************************
+Copyright 2020 Advanced Micro Devices, Inc
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+************************************************************************/
+
+#include "textureDiskCache.h"
+
+#include "pxr/base/arch/fileSystem.h"
+#include "pxr/base/arch/hash.h"
+#include "pxr/base/arch/systemInfo.h"
+#include "pxr/base/tf/diagnostic.h"
+#include "pxr/base/tf/envSetting.h"
+#include "pxr/base/tf/fileUtils.h"
+#include "pxr/base/tf/stringUtils.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <thread>
+#include <vector>
+
+#ifdef WIN32
+#include <sys/utime.h>
+#else
+#include <utime.h>
+#endif
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+TF_DEFINE_ENV_SETTING(HDRPR_TEXTURE_DISK_CACHE_SIZE_MB, 16384,
+    "Maximum size in megabytes of the on-disk cache of decoded textures, 0 disables the cache");
+
+namespace {
+
+const char* kCacheFileExtension = ".rprtex";
+const uint32_t kCacheFileMagic = 0x58545248; // "HRTX"
+const uint32_t kCacheFileVersion = 2;
+
+struct CacheFileHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t componentType;
+    uint32_t numComponents;
+    uint32_t width;
+    uint32_t height;
+    float gamma;
+    uint32_t keyLength;
+    uint64_t fullResolutionSize;
+    uint64_t pixelsOffset;
+};
+
+void TouchFile(std::string const& path) {
+#ifdef WIN32
+    _utime(path.c_str(), nullptr);
+#else
+    utime(path.c_str(), nullptr);
+#endif
+}
+
+} // namespace anonymous
+
+HdRprTextureDiskCache::HdRprTextureDiskCache(std::string const& cacheDir)
+    : m_cacheDir(cacheDir) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stats.maxSize = size_t(std::max(TfGetEnvSetting(HDRPR_TEXTURE_DISK_CACHE_SIZE_MB), 0)) * 1024 * 1024;
+    if (m_stats.maxSize == 0) {
+        // Disabled cache must not touch the cache directory, it might be shared with other sessions
+        m_cacheDir.clear();
+    }
+    if (!m_cacheDir.empty()) {
+        PruneLocked();
+    }
+}
+
+std::string HdRprTextureDiskCache::GetFilepath(std::string const& key) const {
+    return TfStringPrintf("%s%c%016llx%s", m_cacheDir.c_str(), ARCH_PATH_SEP[0], (unsigned long long)ArchHash64(key.c_str(), key.size()), kCacheFileExtension);
+}
+
+bool HdRprTextureDiskCache::Read(std::string const& key, rpr::ImageData* data) {
+    if (m_cacheDir.empty()) {
+        return false;
+    }
+
+    auto onMiss = [this]() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stats.numMisses++;
+        return false;
+    };
+
+    auto filepath = GetFilepath(key);
+    if (!TfIsFile(filepath)) {
+        return onMiss();
+    }
+
+    auto fileMapping = ArchMapFileReadOnly(filepath);
+    if (!fileMapping) {
+        return onMiss();
+    }
+    auto mappingLength = ArchGetFileMappingLength(fileMapping);
+    auto mapping = std::shared_ptr<char const>(std::move(fileMapping));
+
+    CacheFileHeader header;
+    if (mappingLength < sizeof(header)) {
+        return onMiss();
+    }
+    std::memcpy(&header, mapping.get(), sizeof(header));
+    if (header.magic != kCacheFileMagic ||
+        header.version != kCacheFileVersion ||
+        header.keyLength != key.size() ||
+        sizeof(header) + header.keyLength > mappingLength ||
+        std::memcmp(mapping.get() + sizeof(header), key.data(), key.size()) != 0) {
+        // Either a stale file or a hash collision
+        return onMiss();
+    }
+
+    rpr::ImageFormat format = {};
+    format.type = header.componentType;
+    format.num_components = header.numComponents;
+    auto desc = rpr::GetImageDesc(format, header.width, header.height);
+    if (header.pixelsOffset + desc.image_slice_pitch > mappingLength) {
+        return onMiss();
+    }
+
+    data->format = format;
+    data->desc = desc;
+    data->gamma = header.gamma;
+    data->fullResolutionSize = header.fullResolutionSize;
+    // Pixels keep the file mapped
+    data->pixels = std::shared_ptr<void const>(mapping, mapping.get() + header.pixelsOffset);
+
+    // Modification time is used to find least recently used files when pruning
+    TouchFile(filepath);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stats.numHits++;
+    return true;
+}
+
+void HdRprTextureDiskCache::Write(std::string const& key, rpr::ImageData const& data) {
+    if (m_cacheDir.empty() || !data.pixels) {
+        return;
+    }
+
+    size_t pixelsSize = data.desc.image_slice_pitch;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (pixelsSize > m_stats.maxSize) {
+            return;
+        }
+    }
+
+    CacheFileHeader header = {};
+    header.magic = kCacheFileMagic;
+    header.version = kCacheFileVersion;
+    header.componentType = data.format.type;
+    header.numComponents = data.format.num_components;
+    header.width = data.desc.image_width;
+    header.height = data.desc.image_height;
+    header.gamma = data.gamma;
+    header.keyLength = uint32_t(key.size());
+    header.fullResolutionSize = data.fullResolutionSize;
+    // Keep pixels 16 bytes aligned in the mapped file
+    header.pixelsOffset = (sizeof(header) + key.size() + 15) & ~uint64_t(15);
+
+    auto filepath = GetFilepath(key);
+
+    // Write to a temporary file first so that concurrent readers never see a partially written file.
+    // The cache directory is shared between sessions, so the name has to be unique across processes too
+    auto tmpFilepath = filepath + TfStringPrintf(".%d.%zu.tmp", ArchGetProcessId(), std::hash<std::thread::id>()(std::this_thread::get_id()));
+    {
+        std::ofstream file(tmpFilepath, std::ios::binary);
+        if (!file.is_open()) {
+            return;
+        }
+
+        const char padding[16] = {};
+        file.write(reinterpret_cast<char const*>(&header), sizeof(header));
+        file.write(key.data(), key.size());
+        file.write(padding, header.pixelsOffset - sizeof(header) - key.size());
+        file.write(static_cast<char const*>(data.pixels.get()), pixelsSize);
+        if (!file) {
+            file.close();
+            TfDeleteFile(tmpFilepath);
+            return;
+        }
+    }
+    // rename overwrites existing files on POSIX, such files are already accounted in the cache size
+    bool isNewFile = !TfIsFile(filepath);
+    if (std::rename(tmpFilepath.c_str(), filepath.c_str()) != 0) {
+        // Most likely another thread has written the same file
+        TfDeleteFile(tmpFilepath);
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stats.numWrites++;
+    if (isNewFile) {
+        m_stats.size += header.pixelsOffset + pixelsSize;
+    }
+    if (m_stats.size > m_stats.maxSize) {
+        PruneLocked();
+    }
+}
+
+void HdRprTextureDiskCache::SetMaxSize(size_t bytes) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stats.maxSize = bytes;
+    if (!m_cacheDir.empty() && m_stats.size > m_stats.maxSize) {
+        PruneLocked();
+    }
+}
+
+HdRprTextureDiskCache::Statistics HdRprTextureDiskCache::GetStatistics() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+}
+
+void HdRprTextureDiskCache::PruneLocked() {
+    struct CacheFile {
+        std::string path;
+        int64_t size;
+        double lastUseTime;
+    };
+    std::vector<CacheFile> files;
+
+    std::vector<std::string> dirnames, filenames, symlinknames;
+    TfReadDir(m_cacheDir, &dirnames, &filenames, &symlinknames);
+
+    size_t totalSize = 0;
+    for (auto& filename : filenames) {
+        if (!TfStringEndsWith(filename, kCacheFileExtension)) {
+            continue;
+        }
+
+        CacheFile file;
+        file.path = TfStringCatPaths(m_cacheDir, filename);
+        file.size = ArchGetFileLength(file.path.c_str());
+        if (file.size < 0) {
+            continue;
+        }
+
+        file.lastUseTime = 0.0;
+        ArchGetModificationTime(file.path.c_str(), &file.lastUseTime);
+
+        totalSize += size_t(file.size);
+        files.push_back(std::move(file));
+    }
+
+    // Prune a bit more than needed so that we do not rescan the directory on each write
+    size_t targetSize = m_stats.maxSize - m_stats.maxSize / 10;
+    if (totalSize > m_stats.maxSize) {
+        std::sort(files.begin(), files.end(), [](CacheFile const& lhs, CacheFile const& rhs) {
+            return lhs.lastUseTime < rhs.lastUseTime;
+        });
+
+        for (auto& file : files) {
+            if (totalSize <= targetSize) {
+                break;
+            }
+
+            // Files mapped by running sessions stay accessible until they are unmapped
+            if (TfDeleteFile(file.path)) {
+                totalSize -= size_t(file.size);
+                m_stats.numPrunedFiles++;
+            }
+        }
+    }
+
+    m_stats.size = totalSize;
+}
+
+PXR_NAMESPACE_CLOSE_SCOPE
@@ -0,0 +1,64 @@
+/************************************************************************
+Copyright 2020 Advanced Micro Devices, Inc
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+************************************************************************/
+
+#ifndef HDRPR_TEXTURE_DISK_CACHE_H
+#define HDRPR_TEXTURE_DISK_CACHE_H
+
+#include "pxr/pxr.h"
+
+#include "rpr/imageHelpers.h"
+
+#include <mutex>
+#include <string>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+/// Persistent cache of decoded images.
+/// Each image is stored in its own file named by the hash of the key, the key itself is stored in the file too.
+/// Cached pixels are memory-mapped so that reading an image does not involve any decoding or copying.
+/// When the total size of the cache exceeds the limit, least recently used files are removed.
+class HdRprTextureDiskCache {
+public:
+    /// The cache is disabled when cacheDir is empty
+    HdRprTextureDiskCache(std::string const& cacheDir);
+
+    /// Key should uniquely identify decoded pixels, e.g. contain the source path, its modification time and size and load parameters
+    bool Read(std::string const& key, rpr::ImageData* data);
+    void Write(std::string const& key, rpr::ImageData const& data);
+
+    void SetMaxSize(size_t bytes);
+
+    struct Statistics {
+        size_t numHits = 0;
+        size_t numMisses = 0;
+        size_t numWrites = 0;
+        size_t numPrunedFiles = 0;
+        size_t size = 0;
+        size_t maxSize = 0;
+    };
+    Statistics GetStatistics() const;
+
+private:
+    std::string GetFilepath(std::string const& key) const;
+    void PruneLocked();
+
+private:
+    std::string m_cacheDir;
+
+    mutable std::mutex m_mutex;
+    Statistics m_stats;
+};
+
+PXR_NAMESPACE_CLOSE_SCOPE
+
+#endif // HDRPR_TEXTURE_DISK_CACHE_H
@@ -0,0 +1,211 @@
+/************************************************************************
+Copyright 2020 Advanced Micro Devices, Inc
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+************************************************************************/
+
+#include "vdbGridCache.h"
+#include "debugCodes.h"
+
+#include "pxr/base/arch/fileSystem.h"
+#include "pxr/base/tf/envSetting.h"
+#include "pxr/base/tf/diagnostic.h"
+
+#include <algorithm>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+TF_DEFINE_ENV_SETTING(HDRPR_VDB_CACHE_SIZE_MB, 2048,
+    "Maximum amount of memory in megabytes used to keep .vdb grids that are not used by any volume");
+
+namespace {
+
+std::string GetGridKey(std::string const& filepath, std::string const& gridName) {
+    return filepath + '?' + gridName;
+}
+
+} // namespace anonymous
+
+HdRprVdbGridCache& HdRprVdbGridCache::Get() {
+    static HdRprVdbGridCache instance;
+    return instance;
+}
+
+HdRprVdbGridCache::HdRprVdbGridCache() {
+    openvdb::initialize();
+    m_stats.memoryBudget = size_t(std::max(TfGetEnvSetting(HDRPR_VDB_CACHE_SIZE_MB), 0)) * 1024 * 1024;
+}
+
+openvdb::GridBase::ConstPtr HdRprVdbGridCache::GetGrid(std::string const& filepath, std::string const& gridName) {
+    FileInfo fileInfo;
+    ArchGetModificationTime(filepath.c_str(), &fileInfo.modificationTime);
+    fileInfo.size = ArchGetFileLength(filepath.c_str());
+
+    auto key = GetGridKey(filepath, gridName);
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        UpdateFileEntryLocked(filepath, fileInfo);
+        auto it = m_grids.find(key);
+        if (it != m_grids.end()) {
+            m_lru.splice(m_lru.begin(), m_lru, it->second.lruIt);
+            m_stats.numHits++;
+            return it->second.grid;
+        }
+        m_stats.numMisses++;
+    }
+
+    // Read the file without holding the lock so that different files can be read in parallel
+    openvdb::GridBase::ConstPtr grid;
+    openvdb::MetaMap::ConstPtr metadata;
+    try {
+        openvdb::io::File file(filepath);
+        file.open();
+        metadata = file.getMetadata();
+        grid = file.readGrid(gridName);
+    } catch (openvdb::Exception const& e) {
+        TF_RUNTIME_ERROR("Failed to read vdb grid \"%s\" from file \"%s\": %s", gridName.c_str(), filepath.c_str(), e.what());
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto fileEntry = UpdateFileEntryLocked(filepath, fileInfo);
+    if (!fileEntry->metadata) {
+        fileEntry->metadata = metadata;
+    }
+
+    if (!grid) {
+        return nullptr;
+    }
+
+    auto status = m_grids.emplace(key, GridEntry{});
+    auto& entry = status.first->second;
+    if (!status.second) {
+        // Another thread has read the same grid in the meantime
+        return entry.grid;
+    }
+
+    entry.grid = grid;
+    entry.memoryUsage = size_t(grid->memUsage());
+    entry.lruIt = m_lru.insert(m_lru.begin(), key);
+    m_stats.memoryUsage += entry.memoryUsage;
+    m_stats.numGrids++;
+
+    EvictLocked(key);
+
+    TF_DEBUG(HD_RPR_DEBUG_VDB_CACHE).Msg("Cached vdb grid \"%s\" from \"%s\" (%zu bytes). Grids: %zu, memory usage: %zu/%zu bytes, hits: %zu, misses: %zu, evictions: %zu\n",
+        gridName.c_str(), filepath.c_str(), entry.memoryUsage,
+        m_stats.numGrids, m_stats.memoryUsage, m_stats.memoryBudget, m_stats.numHits, m_stats.numMisses, m_stats.numEvictions);
+
+    return grid;
+}
+
+openvdb::MetaMap::ConstPtr HdRprVdbGridCache::GetFileMetadata(std::string const& filepath) {
+    FileInfo fileInfo;
+    ArchGetModificationTime(filepath.c_str(), &fileInfo.modificationTime);
+    fileInfo.size = ArchGetFileLength(filepath.c_str());
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        auto fileEntry = UpdateFileEntryLocked(filepath, fileInfo);
+        if (fileEntry->metadata) {
+            m_stats.numHits++;
+            return fileEntry->metadata;
+        }
+        m_stats.numMisses++;
+    }
+
+    openvdb::MetaMap::ConstPtr metadata;
+    try {
+        openvdb::io::File file(filepath);
+        file.open();
+        metadata = file.getMetadata();
+    } catch (openvdb::Exception const& e) {
+        TF_RUNTIME_ERROR("Failed to read metadata of vdb file \"%s\": %s", filepath.c_str(), e.what());
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto fileEntry = UpdateFileEntryLocked(filepath, fileInfo);
+    if (!fileEntry->metadata) {
+        fileEntry->metadata = metadata;
+    }
+    return fileEntry->metadata;
+}
+
+void HdRprVdbGridCache::SetMemoryBudget(size_t bytes) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stats.memoryBudget = bytes;
+    EvictLocked(std::string());
+}
+
+HdRprVdbGridCache::Statistics HdRprVdbGridCache::GetStatistics() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+}
+
+HdRprVdbGridCache::FileEntry* HdRprVdbGridCache::UpdateFileEntryLocked(std::string const& filepath, FileInfo const& fileInfo) {
+    auto status = m_files.emplace(filepath, FileEntry{});
+    auto& fileEntry = status.first->second;
+    if (status.second) {
+        fileEntry.info = fileInfo;
+    } else if (!(fileEntry.info == fileInfo)) {
+        // The file was modified since we read it, all its grids are stale
+        EraseFileGridsLocked(filepath);
+        fileEntry.info = fileInfo;
+        fileEntry.metadata = nullptr;
+    }
+    return &fileEntry;
+}
+
+void HdRprVdbGridCache::EraseFileGridsLocked(std::string const& filepath) {
+    auto prefix = GetGridKey(filepath, std::string());
+    for (auto it = m_grids.begin(); it != m_grids.end();) {
+        if (it->first.compare(0, prefix.size(), prefix) == 0) {
+            m_stats.memoryUsage -= it->second.memoryUsage;
+            m_stats.numGrids--;
+            m_lru.erase(it->second.lruIt);
+            it = m_grids.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void HdRprVdbGridCache::EvictLocked(std::string const& keepKey) {
+    // Grids referenced by volumes would stay alive anyway, only the grids nobody uses count against the budget
+    size_t unusedMemory = 0;
+    for (auto& entry : m_grids) {
+        if (entry.second.grid.use_count() == 1) {
+            unusedMemory += entry.second.memoryUsage;
+        }
+    }
+
+    auto it = m_lru.end();
+    while (unusedMemory > m_stats.memoryBudget && it != m_lru.begin()) {
+        --it;
+
+        auto gridIt = m_grids.find(*it);
+        if (*it == keepKey || gridIt->second.grid.use_count() > 1) {
+            continue;
+        }
+
+        unusedMemory -= gridIt->second.memoryUsage;
+        m_stats.memoryUsage -= gridIt->second.memoryUsage;
+        m_stats.numGrids--;
+        m_stats.numEvictions++;
+        m_grids.erase(gridIt);
+        it = m_lru.erase(it);
+    }
+}
+
+PXR_NAMESPACE_CLOSE_SCOPE
@@ -0,0 +1,94 @@
+/************************************************************************
+Copyright 2020 Advanced Micro Devices, Inc
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+************************************************************************/
+
+#ifndef HDRPR_VDB_GRID_CACHE_H
+#define HDRPR_VDB_GRID_CACHE_H
+
+#include "pxr/pxr.h"
+
+#include <openvdb/openvdb.h>
+
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+/// Process-wide cache of grids read from .vdb files.
+/// Grids are keyed by file path and grid name and validated against the file modification time and size,
+/// so that re-syncing a volume or syncing many volumes that reference the same file does not read the file again.
+/// Least recently used grids are evicted when the memory used by the grids that are not referenced outside of the cache exceeds the budget.
+/// Grids that are in use are never evicted and do not count against the budget.
+class HdRprVdbGridCache {
+public:
+    static HdRprVdbGridCache& Get();
+
+    /// Returns nullptr if the file can't be read or there is no grid with such name in it
+    openvdb::GridBase::ConstPtr GetGrid(std::string const& filepath, std::string const& gridName);
+
+    /// Returns file-level metadata of the .vdb file or nullptr if the file can't be read
+    openvdb::MetaMap::ConstPtr GetFileMetadata(std::string const& filepath);
+
+    void SetMemoryBudget(size_t bytes);
+
+    struct Statistics {
+        size_t numHits = 0;
+        size_t numMisses = 0;
+        size_t numEvictions = 0;
+        size_t numGrids = 0;
+        size_t memoryUsage = 0;
+        size_t memoryBudget = 0;
+    };
+    Statistics GetStatistics() const;
+
+private:
+    HdRprVdbGridCache();
+
+    struct FileInfo {
+        double modificationTime = 0.0;
+        int64_t size = -1;
+
+        bool operator==(FileInfo const& rhs) const {
+            return modificationTime == rhs.modificationTime && size == rhs.size;
+        }
+    };
+
+    struct FileEntry {
+        FileInfo info;
+        openvdb::MetaMap::ConstPtr metadata;
+    };
+
+    struct GridEntry {
+        openvdb::GridBase::ConstPtr grid;
+        size_t memoryUsage;
+        std::list<std::string>::iterator lruIt;
+    };
+
+    FileEntry* UpdateFileEntryLocked(std::string const& filepath, FileInfo const& fileInfo);
+    void EraseFileGridsLocked(std::string const& filepath);
+    void EvictLocked(std::string const& keepKey);
+
+private:
+    mutable std::mutex m_mutex;
+    std::unordered_map<std::string, FileEntry> m_files;
+    std::unordered_map<std::string, GridEntry> m_grids;
+    // Front is the most recently used grid
+    std::list<std::string> m_lru;
+
+    Statistics m_stats;
+};
+
+PXR_NAMESPACE_CLOSE_SCOPE
+
+#endif // HDRPR_VDB_GRID_CACHE_H
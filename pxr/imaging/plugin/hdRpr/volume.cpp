@@ -18,8 +18,12 @@ using json = nlohmann::json;
 #include "field.h"
 #include "rprApi.h"
 #include "renderParam.h"
+#include "vdbGridCache.h"
+#include "renderDelegate.h"
+#include "debugCodes.h"
+#include "config.h"
 
-#include "RPRLibs/pluginUtils.hpp"
+#include "RPRLibs/pluginUtils.h"
 
 #include "houdini/openvdb.h"
 
@@ -27,8 +31,12 @@ using json = nlohmann::json;
 #include "pxr/usd/sdf/assetPath.h"
 #include "pxr/usd/usdLux/blackbody.h"
 #include "pxr/usd/usdVol/tokens.h"
+#include "pxr/base/work/loops.h"
 
 #include <openvdb/openvdb.h>
+#include <openvdb/tree/LeafManager.h>
+
+#include <limits>
 
 PXR_NAMESPACE_OPEN_SCOPE
 
@@ -111,6 +119,15 @@ struct GridParameters {
         kRampAuthored = 1 << 4,
     };
     uint32_t authoredParamsMask = 0;
+
+    bool operator==(GridParameters const& rhs) const {
+        return normalize == rhs.normalize &&
+            bias == rhs.bias &&
+            gain == rhs.gain &&
+            scale == rhs.scale &&
+            ramp == rhs.ramp &&
+            authoredParamsMask == rhs.authoredParamsMask;
+    }
 };
 
 template <typename T>
@@ -156,10 +173,16 @@ BlackbodyMode ParseGridBlackbodyMode(HdSceneDelegate* sceneDelegate, SdfPath con
 struct GridInfo {
     std::string filepath;
     openvdb::FloatGrid const* vdbGrid = nullptr;
-    HdVolumeFieldDescriptor const* desc;
+    HdVolumeFieldDescriptor desc;
     GridParameters params;
+    BlackbodyMode blackbodyMode = BlackbodyMode::kAuto;
 };
 
+bool IsInMemoryVdb(std::string const& filepath) {
+    static std::string opPrefix("op:");
+    return filepath.compare(0, opPrefix.size(), opPrefix) == 0;
+}
+
 void ParseOpenvdbMetadata(GridInfo* grid) {
     auto isAllParametersParsed = [](GridInfo* grid) {
         // We parse only these parameters from .vdb file metadata
@@ -171,101 +194,103 @@ void ParseOpenvdbMetadata(GridInfo* grid) {
     }
 
     std::string metadataNamePrefix;
-    if (grid->desc->fieldName == HdRprVolumeTokens->temperature) {
+    if (grid->desc.fieldName == HdRprVolumeTokens->temperature) {
         metadataNamePrefix = "volvis_emit";
-    } else if (grid->desc->fieldName == HdRprVolumeTokens->density) {
+    } else if (grid->desc.fieldName == HdRprVolumeTokens->density) {
         metadataNamePrefix = "volvis_density";
     }
 
     auto cdrampMd = metadataNamePrefix + "cdramp";
     auto scaleMd = metadataNamePrefix + "scale";
 
-    try {
-        openvdb::io::File file(grid->filepath);
-        file.open();
+    // In-memory grids do not have file metadata
+    if (IsInMemoryVdb(grid->filepath)) {
+        return;
+    }
 
-        auto metadata = file.getMetadata();
-        for (auto it = metadata->beginMeta(); it != metadata->endMeta() && !isAllParametersParsed(grid); ++it) {
-            if (it->first == cdrampMd) {
-                if (grid->params.authoredParamsMask & GridParameters::kRampAuthored) {
-                    continue;
-                }
+    auto metadata = HdRprVdbGridCache::Get().GetFileMetadata(grid->filepath);
+    if (!metadata) {
+        return;
+    }
 
-                try {
-                    auto root = json::parse(it->second->str());
-                    if (root["colortype"] == "RGB") {
-                        auto points = root["points"];
-                        auto pointsIt = points.begin();
-
-                        // First element is always number of points
-                        int numPoints = pointsIt->get<int>();
-                        if (numPoints <= 0) {
-                            TF_RUNTIME_ERROR("Failed to parse openvdb metadata \"%s\": invalid %s - incorrect number of points %d", grid->filepath.c_str(), cdrampMd.c_str(), numPoints);
-                            continue;
-                        }
-                        ++pointsIt;
+    for (auto it = metadata->beginMeta(); it != metadata->endMeta() && !isAllParametersParsed(grid); ++it) {
+        if (it->first == cdrampMd) {
+            if (grid->params.authoredParamsMask & GridParameters::kRampAuthored) {
+                continue;
+            }
 
-                        std::vector<float> parameters;
-                        std::vector<GfVec3f> colors;
+            try {
+                auto root = json::parse(it->second->str());
+                if (root["colortype"] == "RGB") {
+                    auto points = root["points"];
+                    auto pointsIt = points.begin();
+
+                    // First element is always number of points
+                    int numPoints = pointsIt->get<int>();
+                    if (numPoints <= 0) {
+                        TF_RUNTIME_ERROR("Failed to parse openvdb metadata \"%s\": invalid %s - incorrect number of points %d", grid->filepath.c_str(), cdrampMd.c_str(), numPoints);
+                        continue;
+                    }
+                    ++pointsIt;
 
-                        parameters.reserve(std::min(64, numPoints));
-                        colors.reserve(std::min(64, numPoints));
+                    std::vector<float> parameters;
+                    std::vector<GfVec3f> colors;
 
-                        for (; pointsIt != points.end(); ++pointsIt) {
-                            if (numPoints == 0) {
-                                TF_RUNTIME_ERROR("Failed to parse openvdb metadata \"%s\": invalid %s - excessive number of points", grid->filepath.c_str(), cdrampMd.c_str());
-                                continue;
-                            }
+                    parameters.reserve(std::min(64, numPoints));
+                    colors.reserve(std::min(64, numPoints));
 
-                            auto& point = (*pointsIt);
-                            parameters.push_back(point["t"].get<float>());
+                    for (; pointsIt != points.end(); ++pointsIt) {
+                        if (numPoints == 0) {
+                            TF_RUNTIME_ERROR("Failed to parse openvdb metadata \"%s\": invalid %s - excessive number of points", grid->filepath.c_str(), cdrampMd.c_str());
+                            continue;
+                        }
 
-                            GfVec3f color;
-                            auto rgba = point["rgba"];
-                            for (int i = 0; i < 3; ++i) {
-                                color[i] = rgba[i].get<float>();
-                            }
-                            colors.push_back(color);
+                        auto& point = (*pointsIt);
+                        parameters.push_back(point["t"].get<float>());
 
-                            numPoints--;
+                        GfVec3f color;
+                        auto rgba = point["rgba"];
+                        for (int i = 0; i < 3; ++i) {
+                            color[i] = rgba[i].get<float>();
                         }
+                        colors.push_back(color);
 
-                        if (numPoints != 0) {
-                            TF_RUNTIME_ERROR("Failed to parse openvdb metadata \"%s\": invalid %s - insufficient number of points", grid->filepath.c_str(), cdrampMd.c_str());
-                            continue;
-                        }
+                        numPoints--;
+                    }
 
-                        // RPR expects linearly interpolated ramp
-                        // Houdini's ramp is defined as parameter-color pair (the parameter is in [0; 1] range)
-                        // Here we convert arbitrarily distributed color ramp to a linear ramp
-                        auto& ramp = grid->params.ramp;
-                        ramp.reserve(kLookupTableGranularityLevel);
-                        for (int i = 0; i < kLookupTableGranularityLevel; ++i) {
-                            float t = static_cast<float>(i) / (kLookupTableGranularityLevel - 1);
-                            ramp.push_back(HdResampleRawTimeSamples(t, parameters.size(), parameters.data(), colors.data()));
-                        }
-                        grid->params.authoredParamsMask |= GridParameters::kRampAuthored;
+                    if (numPoints != 0) {
+                        TF_RUNTIME_ERROR("Failed to parse openvdb metadata \"%s\": invalid %s - insufficient number of points", grid->filepath.c_str(), cdrampMd.c_str());
+                        continue;
                     }
-                } catch (json::exception& e) {
-                    TF_RUNTIME_ERROR("Failed to parse openvdb metadata \"%s\": invalid %s - %s", grid->filepath.c_str(), cdrampMd.c_str(), e.what());
-                }
-            } else if (it->first == scaleMd) {
-                if (grid->params.authoredParamsMask & GridParameters::kScaleAuthored) {
-                    continue;
-                }
 
-                if (it->second->typeName() == "float") {
-                    try {
-                        grid->params.scale *= std::stof(it->second->str()) * 0.01f;
-                        grid->params.authoredParamsMask |= GridParameters::kScaleAuthored;
-                    } catch (std::exception& e) {
-                        TF_RUNTIME_ERROR("Failed to parse openvdb metadata \"%s\": invalid %s - %s", grid->filepath.c_str(), scaleMd.c_str(), e.what());
+                    // RPR expects linearly interpolated ramp
+                    // Houdini's ramp is defined as parameter-color pair (the parameter is in [0; 1] range)
+                    // Here we convert arbitrarily distributed color ramp to a linear ramp
+                    auto& ramp = grid->params.ramp;
+                    ramp.reserve(kLookupTableGranularityLevel);
+                    for (int i = 0; i < kLookupTableGranularityLevel; ++i) {
+                        float t = static_cast<float>(i) / (kLookupTableGranularityLevel - 1);
+                        ramp.push_back(HdResampleRawTimeSamples(t, parameters.size(), parameters.data(), colors.data()));
                     }
+                    grid->params.authoredParamsMask |= GridParameters::kRampAuthored;
+                }
+            } catch (json::exception& e) {
+                TF_RUNTIME_ERROR("Failed to parse openvdb metadata \"%s\": invalid %s - %s", grid->filepath.c_str(), cdrampMd.c_str(), e.what());
+            }
+        } else if (it->first == scaleMd) {
+            if (grid->params.authoredParamsMask & GridParameters::kScaleAuthored) {
+                continue;
+            }
+
+            if (it->second->typeName() == "float") {
+                try {
+                    grid->params.scale *= std::stof(it->second->str()) * 0.01f;
+                    grid->params.authoredParamsMask |= GridParameters::kScaleAuthored;
+                } catch (std::exception& e) {
+                    TF_RUNTIME_ERROR("Failed to parse openvdb metadata \"%s\": invalid %s - %s", grid->filepath.c_str(), scaleMd.c_str(), e.what());
                 }
             }
         }
-    } catch (openvdb::IoError const& e) {
-        TF_RUNTIME_ERROR("Failed to parse openvdb metadata \"%s\": %s", grid->filepath.c_str(), e.what());
     }
 }
 
@@ -285,34 +310,227 @@ VDBGrid<float> CopyGridTopology(VDBGrid<float> const& from) {
     return newGrid;
 }
 
-void NormalizeGrid(VDBGrid<float>* grid) {
-    if ((GfIsClose(grid->minValue, 0.0f, 1e-3f) && GfIsClose(grid->maxValue, 1.0f, 1e-3f)) ||
-        GfIsClose(grid->minValue, grid->maxValue, 1e-6f)) {
+using VdbLeafType = openvdb::FloatGrid::TreeType::LeafNodeType;
+
+// Level of detail N halves grid resolution N times
+const int kNumVolumeLods = 3;
+
+/// Calls fn(coord, value) for each active cell of the leaf at the given level of detail.
+/// The cell of lod level N spans 2^N voxels per axis and its coord is the voxel coord shifted right by N.
+/// Values of active voxels are offset by the background value (vdb does not add it automatically).
+/// Cell value is the average of all its voxels, inactive voxels contribute zero as they do at full resolution, where they are not emitted at all.
+/// Leaf nodes are aligned to their size so every cell lies entirely in a single leaf.
+template <typename Fn>
+void ForEachActiveCell(VdbLeafType const& leaf, int lod, float backgroundValue, Fn&& fn) {
+    if (lod == 0) {
+        for (auto iter = leaf.cbeginValueOn(); iter; ++iter) {
+            fn(iter.getCoord(), *iter + backgroundValue);
+        }
         return;
     }
 
-    float offset = -grid->minValue;
-    float scale = 1.0f / (grid->maxValue - grid->minValue);
-    for (auto& value : grid->values) {
-        value = value * scale + offset;
+    const int cellsPerAxis = VdbLeafType::DIM >> lod;
+    float cellValues[VdbLeafType::SIZE];
+    bool cellIsActive[VdbLeafType::SIZE];
+    std::fill(cellValues, cellValues + VdbLeafType::SIZE, 0.0f);
+    std::fill(cellIsActive, cellIsActive + VdbLeafType::SIZE, false);
+
+    for (auto iter = leaf.cbeginValueOn(); iter; ++iter) {
+        auto xyz = VdbLeafType::offsetToLocalCoord(iter.pos());
+        int cell = ((xyz.x() >> lod) * cellsPerAxis + (xyz.y() >> lod)) * cellsPerAxis + (xyz.z() >> lod);
+        cellValues[cell] += *iter + backgroundValue;
+        cellIsActive[cell] = true;
+    }
+
+    const float cellWeight = 1.0f / float(1 << (3 * lod));
+    const openvdb::Coord cellOrigin = leaf.origin() >> lod;
+    for (int x = 0; x < cellsPerAxis; ++x) {
+        for (int y = 0; y < cellsPerAxis; ++y) {
+            for (int z = 0; z < cellsPerAxis; ++z) {
+                int cell = (x * cellsPerAxis + y) * cellsPerAxis + z;
+                if (cellIsActive[cell]) {
+                    fn(cellOrigin.offsetBy(x, y, z), cellValues[cell] * cellWeight);
+                }
+            }
+        }
+    }
+}
+
+size_t CountActiveCells(VdbLeafType const& leaf, int lod) {
+    if (lod == 0) {
+        return leaf.onVoxelCount();
     }
 
-    grid->minValue = 0.0f;
-    grid->maxValue = 1.0f;
+    const int cellsPerAxis = VdbLeafType::DIM >> lod;
+    bool cellIsActive[VdbLeafType::SIZE] = {};
+    for (auto iter = leaf.cbeginValueOn(); iter; ++iter) {
+        auto xyz = VdbLeafType::offsetToLocalCoord(iter.pos());
+        cellIsActive[((xyz.x() >> lod) * cellsPerAxis + (xyz.y() >> lod)) * cellsPerAxis + (xyz.z() >> lod)] = true;
+    }
+    return std::count(cellIsActive, cellIsActive + cellsPerAxis * cellsPerAxis * cellsPerAxis, true);
 }
 
-bool IsInMemoryVdb(std::string const& filepath) {
-    static std::string opPrefix("op:");
-    return filepath.compare(0, opPrefix.size(), opPrefix) == 0;
+/// Converts active values of the grid at the given level of detail into flat arrays of cell coordinates (relative to bbox.min() >> lod) and values.
+/// Leaf nodes are processed in parallel: the first pass counts active cells and finds the value range of each leaf,
+/// the second pass writes each leaf into its own precomputed range of the output arrays.
+/// When normalize is set, values are remapped into [0; 1] range during the second pass.
+/// minValue and maxValue of the output grid hold the value range before normalization.
+/// When numCellsPerLod is set, the number of active cells of each level of detail is added to it.
+void ConvertVdbGrid(openvdb::FloatGrid const* grid, openvdb::CoordBBox const& bbox, int lod, bool normalize, VDBGrid<float>* outGrid,
+                    size_t* numCellsPerLod = nullptr) {
+    using TreeType = openvdb::FloatGrid::TreeType;
+
+    auto& tree = grid->tree();
+    openvdb::tree::LeafManager<const TreeType> leafManager(tree);
+    const size_t numLeaves = leafManager.leafCount();
+
+    // background value is not added by vdb automatically
+    const float backgroundValue = grid->background();
+
+    // Active tiles are rare in volumes and RPR takes them as single voxels (cells), gather them serially
+    std::vector<openvdb::Coord> tileCoords;
+    std::vector<float> tileValues;
+    auto tileIter = tree.cbeginValueOn();
+    tileIter.setMaxDepth(TreeType::ValueOnCIter::LEAF_DEPTH - 1);
+    for (; tileIter; ++tileIter) {
+        tileCoords.push_back(tileIter.getCoord() >> lod);
+        tileValues.push_back(*tileIter + backgroundValue);
+    }
+
+    std::vector<size_t> leafOffsets(numLeaves + 1);
+    std::vector<float> leafMinValues(numLeaves);
+    std::vector<float> leafMaxValues(numLeaves);
+    std::vector<size_t> leafNumCellsPerLod(numCellsPerLod ? numLeaves * kNumVolumeLods : 0);
+    WorkParallelForN(numLeaves, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            auto& leaf = leafManager.leaf(i);
+
+            size_t numCells = 0;
+            float minValue = std::numeric_limits<float>::max();
+            float maxValue = std::numeric_limits<float>::lowest();
+            ForEachActiveCell(leaf, lod, backgroundValue, [&](openvdb::Coord const&, float value) {
+                minValue = std::min(minValue, value);
+                maxValue = std::max(maxValue, value);
+                ++numCells;
+            });
+
+            leafOffsets[i + 1] = numCells;
+            leafMinValues[i] = minValue;
+            leafMaxValues[i] = maxValue;
+
+            if (numCellsPerLod) {
+                for (int j = 0; j < kNumVolumeLods; ++j) {
+                    leafNumCellsPerLod[i * kNumVolumeLods + j] = j == lod ? numCells : CountActiveCells(leaf, j);
+                }
+            }
+        }
+    });
+
+    float minValue = std::numeric_limits<float>::max();
+    float maxValue = std::numeric_limits<float>::lowest();
+    leafOffsets[0] = tileValues.size();
+    for (size_t i = 0; i < numLeaves; ++i) {
+        leafOffsets[i + 1] += leafOffsets[i];
+        minValue = std::min(minValue, leafMinValues[i]);
+        maxValue = std::max(maxValue, leafMaxValues[i]);
+    }
+    for (auto value : tileValues) {
+        minValue = std::min(minValue, value);
+        maxValue = std::max(maxValue, value);
+    }
+
+    if (numCellsPerLod) {
+        for (int j = 0; j < kNumVolumeLods; ++j) {
+            numCellsPerLod[j] += tileValues.size();
+            for (size_t i = 0; i < numLeaves; ++i) {
+                numCellsPerLod[j] += leafNumCellsPerLod[i * kNumVolumeLods + j];
+            }
+        }
+    }
+
+    const size_t numCells = leafOffsets[numLeaves];
+    if (numCells == 0) {
+        minValue = maxValue = 0.0f;
+    }
+
+    float valueOffset = 0.0f;
+    float valueScale = 1.0f;
+    if (normalize &&
+        !(GfIsClose(minValue, 0.0f, 1e-3f) && GfIsClose(maxValue, 1.0f, 1e-3f)) &&
+        !GfIsClose(minValue, maxValue, 1e-6f)) {
+        valueScale = 1.0f / (maxValue - minValue);
+        valueOffset = -minValue * valueScale;
+    }
+
+    VtUIntArray coords(numCells * 3);
+    VtFloatArray values(numCells);
+    auto coordsData = coords.data();
+    auto valuesData = values.data();
+    const openvdb::Coord lowerBound = bbox.min() >> lod;
+
+    auto writeCell = [&](size_t index, openvdb::Coord const& coord, float value) {
+        coordsData[3 * index + 0] = coord.x() - lowerBound.x();
+        coordsData[3 * index + 1] = coord.y() - lowerBound.y();
+        coordsData[3 * index + 2] = coord.z() - lowerBound.z();
+        valuesData[index] = value * valueScale + valueOffset;
+    };
+
+    for (size_t i = 0; i < tileValues.size(); ++i) {
+        writeCell(i, tileCoords[i], tileValues[i]);
+    }
+
+    WorkParallelForN(numLeaves, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            size_t index = leafOffsets[i];
+            ForEachActiveCell(leafManager.leaf(i), lod, backgroundValue, [&](openvdb::Coord const& coord, float value) {
+                writeCell(index++, coord, value);
+            });
+        }
+    });
+
+    outGrid->coords = std::move(coords);
+    outGrid->values = std::move(values);
+    outGrid->minValue = minValue;
+    outGrid->maxValue = maxValue;
+}
+
+int GetVolumeLod(bool isBatch) {
+    HdRprConfig* config;
+    auto configInstanceLock = HdRprConfig::GetInstance(&config);
+
+    switch (config->GetVolumeResolution()) {
+        case kVolumeResolutionFull:
+            return 0;
+        case kVolumeResolutionHalf:
+            return 1;
+        case kVolumeResolutionQuarter:
+            return 2;
+        default:
+            break;
+    }
+
+    // Auto: full resolution is used only for final frames
+    if (isBatch) {
+        return 0;
+    }
+    return config->GetRenderQuality() <= kRenderQualityMedium ? 2 : 1;
 }
 
 } // namespace anonymous
 
+struct HdRprVolume::Field {
+    GridInfo info;
+    // Grids read from files are owned by the grid cache, keep them alive while the volume uses them
+    openvdb::GridBase::ConstPtr retainedGrid;
+};
+
 HdRprVolume::HdRprVolume(SdfPath const& id)
     : HdVolume(id) {
 
 }
 
+HdRprVolume::~HdRprVolume() = default;
+
 void HdRprVolume::Sync(
     HdSceneDelegate* sceneDelegate,
     HdRenderParam* renderParam,
@@ -328,101 +546,149 @@ void HdRprVolume::Sync(
         m_transform = GfMatrix4f(sceneDelegate->GetTransform(id));
     }
 
-    bool newVolume = false;
+    const bool isBatch = static_cast<HdRprDelegate*>(sceneDelegate->GetRenderIndex().GetRenderDelegate())->IsBatch();
+    if ((*dirtyBits & DirtyLod) && GetVolumeLod(isBatch) != m_lod) {
+        *dirtyBits |= HdChangeTracker::DirtyTopology;
+    }
 
-    if (*dirtyBits & HdChangeTracker::DirtyTopology) {
-        if (m_rprVolume) {
-            rprApi->Release(m_rprVolume);
+    auto getVdbGrid = [&](SdfPath const& fieldId, std::string const& openvdbPath, openvdb::GridBase::ConstPtr* retainedGrid) -> openvdb::FloatGrid const* {
+        auto fieldName = sceneDelegate->Get(fieldId, UsdVolTokens->fieldName).GetWithDefault(TfToken());
+        if (IsInMemoryVdb(openvdbPath)) {
+            auto houdiniGrid = HoudiniOpenvdbLoader::Instance().GetGrid(openvdbPath.c_str(), fieldName.GetText());
+            if (houdiniGrid->type() != openvdb::FloatGrid::gridType()) {
+                TF_RUNTIME_ERROR("[%s] Failed to read vdb grid \"%s\": RPR supports scalar fields only", id.GetName().c_str(), openvdbPath.c_str());
+                return nullptr;
+            }
+            return static_cast<openvdb::FloatGrid const*>(houdiniGrid);
+        } else {
+            auto grid = HdRprVdbGridCache::Get().GetGrid(openvdbPath, fieldName.GetString());
+            if (!grid) {
+                return nullptr;
+            }
+            if (grid->type() != openvdb::FloatGrid::gridType()) {
+                TF_RUNTIME_ERROR("[%s] Failed to read vdb grid from file \"%s\": RPR supports scalar fields only", id.GetName().c_str(), openvdbPath.c_str());
+                return nullptr;
+            }
+            auto ret = static_cast<openvdb::FloatGrid const*>(grid.get());
+            *retainedGrid = std::move(grid);
+            return ret;
         }
-        m_rprVolume = nullptr;
+    };
 
-        openvdb::initialize();
-        std::map<std::string, openvdb::GridBase::Ptr> retainedVDBGrids;
-
-        auto getVdbGrid = [&](SdfPath const& fieldId, std::string const& openvdbPath) -> openvdb::FloatGrid const* {
-            auto fieldName = sceneDelegate->Get(fieldId, UsdVolTokens->fieldName).GetWithDefault(TfToken());
-            if (IsInMemoryVdb(openvdbPath)) {
-                auto houdiniGrid = HoudiniOpenvdbLoader::Instance().GetGrid(openvdbPath.c_str(), fieldName.GetText());
-                if (houdiniGrid->type() != openvdb::FloatGrid::gridType()) {
-                    TF_RUNTIME_ERROR("[%s] Failed to read vdb grid \"%s\": RPR supports scalar fields only", id.GetName().c_str(), openvdbPath.c_str());
-                    return nullptr;
-                }
-                return static_cast<openvdb::FloatGrid const*>(houdiniGrid);
-            } else {
-                auto gridId = openvdbPath + fieldName.GetString();
-                auto gridIter = retainedVDBGrids.find(gridId);
-                if (gridIter != retainedVDBGrids.end()) {
-                    return static_cast<openvdb::FloatGrid const*>(gridIter->second.get());
-                }
+    auto loadField = [&](HdVolumeFieldDescriptor const& desc, Field* field) {
+        field->info.desc = desc;
 
-                try {
-                    openvdb::io::File file(openvdbPath);
-                    file.open();
-                    auto grid = file.readGrid(fieldName.GetString());
-                    if (grid->type() != openvdb::FloatGrid::gridType()) {
-                        TF_RUNTIME_ERROR("[%s] Failed to read vdb grid from file \"%s\": RPR supports scalar fields only", id.GetName().c_str(), openvdbPath.c_str());
-                        return nullptr;
-                    }
-                    auto ret = static_cast<openvdb::FloatGrid const*>(grid.get());
-                    retainedVDBGrids[gridId] = std::move(grid);
-                    return ret;
-                } catch (openvdb::Exception const& e) {
-                    TF_RUNTIME_ERROR("[%s] Failed to read vdb grid from file \"%s\": %s", id.GetName().c_str(), openvdbPath.c_str(), e.what());
-                }
-            }
+        auto param = sceneDelegate->Get(desc.fieldId, UsdVolTokens->filePath);
+        if (!param.IsHolding<SdfAssetPath>()) {
+            return;
+        }
 
-            return nullptr;
-        };
+        auto& assetPath = param.UncheckedGet<SdfAssetPath>();
+        if (!assetPath.GetResolvedPath().empty()) {
+            field->info.filepath = assetPath.GetResolvedPath();
+        } else {
+            field->info.filepath = assetPath.GetAssetPath();
+        }
 
-        GridInfo densityGridInfo;
-        GridInfo emissionGridInfo;
-        GridInfo albedoGridInfo;
+        field->info.vdbGrid = getVdbGrid(desc.fieldId, field->info.filepath, &field->retainedGrid);
+        if (field->info.vdbGrid) {
+            field->info.params = ParseGridParameters(sceneDelegate, desc.fieldId);
+            field->info.blackbodyMode = ParseGridBlackbodyMode(sceneDelegate, desc.fieldId);
+            ParseOpenvdbMetadata(&field->info);
+        }
+    };
+
+    // Bit per field type
+    uint32_t dirtyFields = 0;
+    const uint32_t kAllFieldsDirty = (1 << kNumFieldTypes) - 1;
+
+    if (*dirtyBits & HdChangeTracker::DirtyTopology) {
+        openvdb::initialize();
 
+        std::unique_ptr<Field> fields[kNumFieldTypes];
         decltype(m_fieldSubscriptions) activeFieldSubscriptions;
 
-        auto volumeFieldDescriptorVector = sceneDelegate->GetVolumeFieldDescriptors(GetId());
-        for (auto const& desc : sceneDelegate->GetVolumeFieldDescriptors(GetId())) {
-            GridInfo* targetInfo;
+        for (auto const& desc : sceneDelegate->GetVolumeFieldDescriptors(id)) {
+            FieldType fieldType;
             if (desc.fieldName == HdRprVolumeTokens->density) {
-                targetInfo = &densityGridInfo;
+                fieldType = kDensityField;
             } else if (desc.fieldName == HdRprVolumeTokens->temperature) {
-                targetInfo = &emissionGridInfo;
+                fieldType = kEmissionField;
             } else if (desc.fieldName == HdRprVolumeTokens->color) {
-                targetInfo = &albedoGridInfo;
+                fieldType = kAlbedoField;
             } else {
                 continue;
             }
 
-            auto param = sceneDelegate->Get(desc.fieldId, UsdVolTokens->filePath);
-            if (param.IsHolding<SdfAssetPath>()) {
-                targetInfo->desc = &desc;
-
-                auto& assetPath = param.UncheckedGet<SdfAssetPath>();
-                if (!assetPath.GetResolvedPath().empty()) {
-                    targetInfo->filepath = assetPath.GetResolvedPath();
-                } else {
-                    targetInfo->filepath = assetPath.GetAssetPath();
-                }
+            auto field = make_unique<Field>();
+            loadField(desc, field.get());
+            if (!field->info.vdbGrid) {
+                continue;
+            }
+            fields[fieldType] = std::move(field);
 
-                targetInfo->vdbGrid = getVdbGrid(desc.fieldId, targetInfo->filepath);
-                if (targetInfo->vdbGrid) {
-                    targetInfo->params = ParseGridParameters(sceneDelegate, desc.fieldId);
-                    ParseOpenvdbMetadata(targetInfo);
-
-                    // Subscribe for field updates, more info in renderParam.h
-                    auto fieldSubscription = m_fieldSubscriptions.find(desc.fieldId);
-                    if (fieldSubscription == m_fieldSubscriptions.end()) {
-                        activeFieldSubscriptions.emplace(desc.fieldId, rprRenderParam->SubscribeVolumeForFieldUpdates(this, desc.fieldId));
-                    } else {
-                        // Reuse the old one
-                        activeFieldSubscriptions.emplace(desc.fieldId, std::move(fieldSubscription->second));
-                    }
-                }
+            // Subscribe for field updates, more info in renderParam.h
+            auto fieldSubscription = m_fieldSubscriptions.find(desc.fieldId);
+            if (fieldSubscription == m_fieldSubscriptions.end()) {
+                activeFieldSubscriptions.emplace(desc.fieldId, rprRenderParam->SubscribeVolumeForFieldUpdates(this, desc.fieldId));
+            } else {
+                // Reuse the old one
+                activeFieldSubscriptions.emplace(desc.fieldId, std::move(fieldSubscription->second));
             }
         }
 
         m_fieldSubscriptions.clear();
         std::swap(m_fieldSubscriptions, activeFieldSubscriptions);
+        std::swap(m_fields, fields);
+
+        {
+            std::lock_guard<std::mutex> lock(m_dirtyFieldIdsMutex);
+            m_dirtyFieldIds.clear();
+        }
+
+        m_lod = GetVolumeLod(isBatch);
+        dirtyFields = kAllFieldsDirty;
+    } else if (*dirtyBits & DirtyFields) {
+        std::set<SdfPath> dirtyFieldIds;
+        {
+            std::lock_guard<std::mutex> lock(m_dirtyFieldIdsMutex);
+            std::swap(dirtyFieldIds, m_dirtyFieldIds);
+        }
+
+        for (int i = 0; i < kNumFieldTypes; ++i) {
+            auto& field = m_fields[i];
+            if (!field || !dirtyFieldIds.count(field->info.desc.fieldId)) {
+                continue;
+            }
+
+            auto newField = make_unique<Field>();
+            loadField(field->info.desc, newField.get());
+
+            // Hydra recreates all fields of the volume when any of them is changed,
+            // thanks to the grid cache unchanged fields resolve to the same grids and we can skip them.
+            // In-memory grids can be edited in place so they are always reloaded
+            if (newField->info.vdbGrid != field->info.vdbGrid ||
+                IsInMemoryVdb(newField->info.filepath) ||
+                !(newField->info.params == field->info.params) ||
+                newField->info.blackbodyMode != field->info.blackbodyMode) {
+                dirtyFields |= 1 << i;
+            }
+            field = std::move(newField);
+        }
+    }
+
+    bool newVolume = false;
+
+    if (dirtyFields) {
+        GridInfo gridInfos[kNumFieldTypes];
+        for (int i = 0; i < kNumFieldTypes; ++i) {
+            if (m_fields[i]) {
+                gridInfos[i] = m_fields[i]->info;
+            }
+        }
+        auto& densityGridInfo = gridInfos[kDensityField];
+        auto& emissionGridInfo = gridInfos[kEmissionField];
+        auto& albedoGridInfo = gridInfos[kAlbedoField];
 
         auto densityGrid = densityGridInfo.vdbGrid;
         auto emissionGrid = emissionGridInfo.vdbGrid;
@@ -430,6 +696,10 @@ void HdRprVolume::Sync(
 
         if (!densityGrid && !emissionGrid) {
             TF_RUNTIME_ERROR("[Node: %s]: does not have the needed grids.", GetId().GetName().c_str());
+            if (m_rprVolume) {
+                rprApi->Release(m_rprVolume);
+                m_rprVolume = nullptr;
+            }
             *dirtyBits = HdChangeTracker::Clean;
             return;
         }
@@ -448,106 +718,157 @@ void HdRprVolume::Sync(
         if (densityGrid) activeVoxelsBB.expand(densityGrid->evalActiveVoxelBoundingBox());
         if (emissionGrid) activeVoxelsBB.expand(emissionGrid->evalActiveVoxelBoundingBox());
         if (albedoGrid) activeVoxelsBB.expand(albedoGrid->evalActiveVoxelBoundingBox());
-        openvdb::Coord activeVoxelsBBSize = activeVoxelsBB.extents();
 
-        VDBGrid<float> densityGridData;
-        VDBGrid<float> emissionGridData;
-        VDBGrid<float> albedoGridData;
+        // Cells of lod level N span 2^N voxels per axis
+        const int lod = m_lod;
+        openvdb::CoordBBox lodBB(activeVoxelsBB.min() >> lod, activeVoxelsBB.max() >> lod);
+        GfVec3i gridSize(lodBB.extents().asPointer());
 
-        if (densityGrid) {
-            ProcessVDBGrid(densityGridData, densityGridInfo.vdbGrid, activeVoxelsBB);
+        openvdb::Vec3d gridMin = gridTransform.indexToWorld(lodBB.min() << lod);
+        GfVec3f gridBBLow((float)(gridMin.x() - voxelSize[0] / 2), (float)(gridMin.y() - voxelSize[1] / 2), (float)(gridMin.z() - voxelSize[2] / 2));
+        GfVec3f voxelSizeGf(voxelSize.x(), voxelSize.y(), voxelSize.z());
+        voxelSizeGf *= float(1 << lod);
+
+        // Changed grids can be replaced in the existing volume only if its bounds are unchanged, otherwise everything is recreated
+        const bool updateGrids = m_rprVolume &&
+            gridSize == m_gridSize &&
+            voxelSizeGf == m_voxelSize &&
+            gridBBLow == m_gridBBLow;
+        if (!updateGrids) {
+            dirtyFields = kAllFieldsDirty;
+        }
 
-            if (densityGridInfo.params.ramp.empty()) {
-                if ((densityGridInfo.params.authoredParamsMask & GridParameters::kNormalizeAuthored) == 0) {
-                    densityGridInfo.params.normalize = true;
-                }
+        // Missing grids take topology of the present ones
+        if (!densityGrid && (dirtyFields & (1 << kEmissionField))) dirtyFields |= 1 << kDensityField;
+        if (!emissionGrid && (dirtyFields & (1 << kDensityField))) dirtyFields |= 1 << kEmissionField;
+        if (!albedoGrid && (dirtyFields & (1 << (densityGrid ? kDensityField : kEmissionField)))) dirtyFields |= 1 << kAlbedoField;
+
+        // Memory accounting of all levels of detail is done only on demand as it takes an additional pass over the grids
+        const bool countCellsPerLod = TfDebug::IsEnabled(HD_RPR_DEBUG_VOLUME_LOD);
+        size_t numCellsPerLod[kNumVolumeLods] = {};
+
+        const bool useDensityValueRangeAsRamp = densityGridInfo.params.ramp.empty();
+        if (useDensityValueRangeAsRamp && (densityGridInfo.params.authoredParamsMask & GridParameters::kNormalizeAuthored) == 0) {
+            densityGridInfo.params.normalize = true;
+        }
+
+        VDBGrid<float> gridData[kNumFieldTypes];
+        bool isGridConverted[kNumFieldTypes] = {};
+        auto convertGrid = [&](FieldType fieldType) -> VDBGrid<float>& {
+            auto& gridInfo = gridInfos[fieldType];
+            if (!isGridConverted[fieldType] && gridInfo.vdbGrid) {
+                ConvertVdbGrid(gridInfo.vdbGrid, activeVoxelsBB, lod, gridInfo.params.normalize, &gridData[fieldType], countCellsPerLod ? numCellsPerLod : nullptr);
+            }
+            isGridConverted[fieldType] = true;
+            return gridData[fieldType];
+        };
 
+        if (dirtyFields & (1 << kDensityField)) {
+            auto& densityGridData = convertGrid(kDensityField);
+            if (densityGrid && useDensityValueRangeAsRamp) {
                 densityGridInfo.params.ramp.push_back(GfVec3f(densityGridData.minValue));
                 densityGridInfo.params.ramp.push_back(GfVec3f(densityGridData.maxValue));
             }
 
-            if (densityGridInfo.params.normalize) {
-                NormalizeGrid(&densityGridData);
+            if (densityGridData.coords.empty()) {
+                densityGridData = CopyGridTopology(convertGrid(kEmissionField));
+                densityGridInfo.params.ramp.push_back(GfVec3f(defaultDensity));
             }
         }
 
-        if (emissionGrid) {
-            auto blackbodyMode = ParseGridBlackbodyMode(sceneDelegate, emissionGridInfo.desc->fieldId);
-            if (blackbodyMode == BlackbodyMode::kPhysical ||
-                (blackbodyMode == BlackbodyMode::kAuto && (emissionGridInfo.params.authoredParamsMask & GridParameters::kRampAuthored) == 0)) {
-                emissionGridInfo.params.ramp.clear();
-                emissionGridInfo.params.ramp.reserve(kLookupTableGranularityLevel);
-                for (int i = 0; i < kLookupTableGranularityLevel; ++i) {
-                    float parameter = static_cast<float>(i) / (kLookupTableGranularityLevel - 1);
-
-                    static constexpr int kMaxTemperature = 10000;
-                    float temperature = parameter * kMaxTemperature;
-
-                    GfVec3f color = UsdLuxBlackbodyTemperatureAsRgb(temperature);
-                    if (temperature <= 1000) {
-                        color *= temperature / 1000.0f;
-                        color *= temperature / 1000.0f;
+        if (dirtyFields & (1 << kEmissionField)) {
+            if (emissionGrid) {
+                auto blackbodyMode = emissionGridInfo.blackbodyMode;
+                if (blackbodyMode == BlackbodyMode::kPhysical ||
+                    (blackbodyMode == BlackbodyMode::kAuto && (emissionGridInfo.params.authoredParamsMask & GridParameters::kRampAuthored) == 0)) {
+                    emissionGridInfo.params.ramp.clear();
+                    emissionGridInfo.params.ramp.reserve(kLookupTableGranularityLevel);
+                    for (int i = 0; i < kLookupTableGranularityLevel; ++i) {
+                        float parameter = static_cast<float>(i) / (kLookupTableGranularityLevel - 1);
+
+                        static constexpr int kMaxTemperature = 10000;
+                        float temperature = parameter * kMaxTemperature;
+
+                        GfVec3f color = UsdLuxBlackbodyTemperatureAsRgb(temperature);
+                        if (temperature <= 1000) {
+                            color *= temperature / 1000.0f;
+                            color *= temperature / 1000.0f;
+                        }
+                        emissionGridInfo.params.ramp.push_back(color);
                     }
-                    emissionGridInfo.params.ramp.push_back(color);
+                } else if (emissionGridInfo.params.ramp.empty()) {
+                    emissionGridInfo.params.ramp.push_back(GfVec3f(0.0f));
+                    emissionGridInfo.params.ramp.push_back(GfVec3f(1.0f));
                 }
-            } else if (emissionGridInfo.params.ramp.empty()) {
-                emissionGridInfo.params.ramp.push_back(GfVec3f(0.0f));
-                emissionGridInfo.params.ramp.push_back(GfVec3f(1.0f));
             }
 
-            ProcessVDBGrid(emissionGridData, emissionGridInfo.vdbGrid, activeVoxelsBB);
-
-            if (emissionGridInfo.params.normalize) {
-                NormalizeGrid(&emissionGridData);
+            auto& emissionGridData = convertGrid(kEmissionField);
+            if (emissionGridData.coords.empty()) {
+                emissionGridData = CopyGridTopology(convertGrid(kDensityField));
+                emissionGridInfo.params.ramp.push_back(defaultEmission);
             }
         }
 
-        if (albedoGrid) {
-            ProcessVDBGrid(albedoGridData, albedoGridInfo.vdbGrid, activeVoxelsBB);
-            if (albedoGridInfo.params.normalize) {
-                NormalizeGrid(&albedoGridData);
+        if (dirtyFields & (1 << kAlbedoField)) {
+            auto& albedoGridData = convertGrid(kAlbedoField);
+            if (albedoGrid && albedoGridInfo.params.ramp.empty()) {
+                albedoGridInfo.params.ramp.push_back(defaultColor);
             }
-            if (albedoGridInfo.params.ramp.empty()) {
+
+            if (albedoGridData.coords.empty()) {
+                albedoGridData = CopyGridTopology(convertGrid(densityGrid ? kDensityField : kEmissionField));
                 albedoGridInfo.params.ramp.push_back(defaultColor);
             }
         }
 
-        if (densityGridData.coords.empty()) {
-            densityGridData = CopyGridTopology(emissionGridData);
-            densityGridInfo.params.ramp.push_back(GfVec3f(defaultDensity));
+        for (auto& gridInfo : gridInfos) {
+            for (auto& value : gridInfo.params.ramp) {
+                value = value * gridInfo.params.gain + GfVec3f(gridInfo.params.bias);
+            }
         }
 
-        if (emissionGridData.coords.empty()) {
-            emissionGridData = CopyGridTopology(densityGridData);
-            emissionGridInfo.params.ramp.push_back(defaultEmission);
+        if (countCellsPerLod) {
+            // Each cell is passed to RPR as three uint32 coordinates and a float value
+            static const size_t kCellSize = 3 * sizeof(uint32_t) + sizeof(float);
+            for (int i = 0; i < kNumVolumeLods; ++i) {
+                TF_DEBUG(HD_RPR_DEBUG_VOLUME_LOD).Msg("[%s] lod %d%s: %zu cells, %.2f MB\n", id.GetText(), i, i == lod ? " (used)" : "",
+                    numCellsPerLod[i], numCellsPerLod[i] * kCellSize / (1024.0 * 1024.0));
+            }
         }
 
-        if (albedoGridData.coords.empty()) {
-            albedoGridData = CopyGridTopology(densityGrid ? densityGridData : emissionGridData);
-            albedoGridInfo.params.ramp.push_back(defaultColor);
-        }
+        if (updateGrids) {
+            static const HdRprApi::VolumeGridType kRprGridTypes[kNumFieldTypes] = {
+                HdRprApi::kVolumeGridDensity,
+                HdRprApi::kVolumeGridAlbedo,
+                HdRprApi::kVolumeGridEmission
+            };
 
-        for (auto& value : densityGridInfo.params.ramp) {
-            value = value * densityGridInfo.params.gain + GfVec3f(densityGridInfo.params.bias);
-        }
-        for (auto& value : emissionGridInfo.params.ramp) {
-            value = value * emissionGridInfo.params.gain + GfVec3f(emissionGridInfo.params.bias);
-        }
-        for (auto& value : albedoGridInfo.params.ramp) {
-            value = value * albedoGridInfo.params.gain + GfVec3f(albedoGridInfo.params.bias);
-        }
-
-        openvdb::Vec3d gridMin = gridTransform.indexToWorld(activeVoxelsBB.min());
-        GfVec3f gridBBLow((float)(gridMin.x() - voxelSize[0] / 2), (float)(gridMin.y() - voxelSize[1] / 2), (float)(gridMin.z() - voxelSize[2] / 2));
-        GfVec3f voxelSizeGf(voxelSize.x(), voxelSize.y(), voxelSize.z());
+            for (int i = 0; i < kNumFieldTypes; ++i) {
+                if (dirtyFields & (1 << i)) {
+                    rprApi->SetVolumeGrid(m_rprVolume, kRprGridTypes[i], gridData[i].coords, gridData[i].values, gridInfos[i].params.ramp, gridInfos[i].params.scale);
+                }
+            }
+        } else {
+            if (m_rprVolume) {
+                rprApi->Release(m_rprVolume);
+            }
 
-        auto volumeMaterialParams = ParseVolumeMaterialParameters(sceneDelegate, id);
-        m_rprVolume = rprApi->CreateVolume(
-            densityGridData.coords, densityGridData.values, densityGridInfo.params.ramp, densityGridInfo.params.scale,
-            albedoGridData.coords, albedoGridData.values, albedoGridInfo.params.ramp, albedoGridInfo.params.scale, 
-            emissionGridData.coords, emissionGridData.values, emissionGridInfo.params.ramp, emissionGridInfo.params.scale,
-            GfVec3i(activeVoxelsBBSize.asPointer()), voxelSizeGf, gridBBLow, volumeMaterialParams);
-        newVolume = m_rprVolume != nullptr;
+            auto& densityGridData = gridData[kDensityField];
+            auto& emissionGridData = gridData[kEmissionField];
+            auto& albedoGridData = gridData[kAlbedoField];
+
+            auto volumeMaterialParams = ParseVolumeMaterialParameters(sceneDelegate, id);
+            m_rprVolume = rprApi->CreateVolume(
+                densityGridData.coords, densityGridData.values, densityGridInfo.params.ramp, densityGridInfo.params.scale,
+                albedoGridData.coords, albedoGridData.values, albedoGridInfo.params.ramp, albedoGridInfo.params.scale, 
+                emissionGridData.coords, emissionGridData.values, emissionGridInfo.params.ramp, emissionGridInfo.params.scale,
+                gridSize, voxelSizeGf, gridBBLow, volumeMaterialParams);
+            newVolume = m_rprVolume != nullptr;
+
+            m_gridSize = gridSize;
+            m_voxelSize = voxelSizeGf;
+            m_gridBBLow = gridBBLow;
+        }
     }
 
     if (m_rprVolume) {
@@ -566,7 +887,9 @@ HdDirtyBits HdRprVolume::GetInitialDirtyBitsMask() const {
         | HdChangeTracker::DirtyVisibility
         | HdChangeTracker::DirtyPrimvar
         | HdChangeTracker::DirtyMaterialId
-        | HdChangeTracker::AllDirty;
+        | HdChangeTracker::AllDirty
+        | DirtyLod
+        | DirtyFields;
 
     return (HdDirtyBits)mask;
 }
@@ -16,6 +16,12 @@ limitations under the License.
 
 #include "pxr/imaging/hd/volume.h"
 #include "pxr/base/gf/matrix4f.h"
+#include "pxr/base/gf/vec3f.h"
+#include "pxr/base/gf/vec3i.h"
+
+#include <memory>
+#include <mutex>
+#include <set>
 
 PXR_NAMESPACE_OPEN_SCOPE
 
@@ -23,8 +29,19 @@ struct HdRprApiVolume;
 
 class HdRprVolume : public HdVolume {
 public:
+    // Render settings the level of detail depends on are changed
+    static const HdDirtyBits DirtyLod = HdChangeTracker::CustomBitsBegin;
+    // Some of the fields used by the volume are changed, see MarkFieldDirty
+    static const HdDirtyBits DirtyFields = HdChangeTracker::CustomBitsBegin << 1;
+
     HdRprVolume(SdfPath const& id);
-    ~HdRprVolume() override = default;
+    ~HdRprVolume() override;
+
+    // Remembers which field should be reloaded on the next Sync, the volume itself should be marked with DirtyFields
+    void MarkFieldDirty(SdfPath const& fieldId) {
+        std::lock_guard<std::mutex> lock(m_dirtyFieldIdsMutex);
+        m_dirtyFieldIds.insert(fieldId);
+    }
 
     void Sync(
         HdSceneDelegate* sceneDelegate,
@@ -43,9 +60,29 @@ protected:
     void _InitRepr(TfToken const& reprName,
                    HdDirtyBits* dirtyBits) override;
 
+private:
+    enum FieldType {
+        kDensityField,
+        kAlbedoField,
+        kEmissionField,
+        kNumFieldTypes
+    };
+    struct Field;
+
 private:
     HdRprApiVolume* m_rprVolume = nullptr;
     GfMatrix4f m_transform;
+    int m_lod = -1;
+
+    // Layout of the RPR volume, grids can be replaced one by one only while it's unchanged
+    GfVec3i m_gridSize;
+    GfVec3f m_voxelSize;
+    GfVec3f m_gridBBLow;
+
+    std::unique_ptr<Field> m_fields[kNumFieldTypes];
+
+    std::mutex m_dirtyFieldIdsMutex;
+    std::set<SdfPath> m_dirtyFieldIds;
 
     std::map<SdfPath, std::shared_ptr<HdRprVolume>> m_fieldSubscriptions;
 };